@@ -29,9 +29,12 @@ void render_scene()
 
 void game_frame()
 {
-    RUNSCOPE_PROFILE_SCOPE("game_frame");
-    physics_calculation();
-    render_scene();
+    {
+        RUNSCOPE_PROFILE_SCOPE("game_frame");
+        physics_calculation();
+        render_scene();
+    }
+    RUNSCOPE_FRAME_MARK("game_frame");
 }
 
 static void glfw_error_callback(int error, const char* description)
@@ -118,6 +121,10 @@ int main()
 
     runscope::ui::ProfilerUI ui;
 
+    // Entries accumulate across frames; each frame only fetches what is new.
+    std::vector<runscope::core::ProfileEntry> recorded_entries;
+    runscope::core::EntryCursor cursor;
+
     bool run_simulation = true;
     int frame_count = 0;
     std::string error_message;
@@ -136,7 +143,8 @@ int main()
             show_error_dialog(error_message, show_error);
         }
 
-        std::vector<runscope::core::ProfileEntry> entries;
+        std::vector<runscope::core::ProfileEntry> sampled_entries;
+        const std::vector<runscope::core::ProfileEntry>* entries = &recorded_entries;
 
         try
         {
@@ -144,27 +152,44 @@ int main()
             {
                 game_frame();
                 ++frame_count;
-                entries = profiler.get_entries();
 
-                for (const auto& entry : entries)
+                // Parents index the concatenation of every batch read through
+                // the cursor, so a reset cursor starts a new list.
+                auto batch = profiler.get_entries_since(cursor);
+                if (cursor.entries_read == batch.size())
+                {
+                    recorded_entries.clear();
+                }
+                for (auto& entry : batch)
                 {
                     process_mgr.update_statistics(entry.name, entry.duration_ms());
+                    recorded_entries.push_back(std::move(entry));
                 }
+                RUNSCOPE_COUNTER("recorded_entries", recorded_entries.size());
             }
             else
             {
                 auto& attacher = ui.get_process_attacher();
                 if (attacher.is_attached() && attacher.is_sampling())
                 {
-                    entries = attacher.get_sampled_entries();
+                    sampled_entries = attacher.get_sampled_entries();
+                    entries = &sampled_entries;
                 }
                 else
                 {
-                    entries = profiler.get_entries();
+                    auto batch = profiler.get_entries_since(cursor);
+                    if (cursor.entries_read == batch.size())
+                    {
+                        recorded_entries.clear();
+                    }
+                    for (auto& entry : batch)
+                    {
+                        recorded_entries.push_back(std::move(entry));
+                    }
                 }
             }
 
-            ui.render(entries);
+            ui.render(*entries);
 
             ImGui::Begin("Status", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
             {
@@ -192,6 +217,7 @@ int main()
                 {
                     profiler.clear();
                     process_mgr.clear_statistics();
+                    recorded_entries.clear();
                     frame_count = 0;
                 }
             }
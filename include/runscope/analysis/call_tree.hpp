@@ -0,0 +1,36 @@
+#pragma once
+
+#include "runscope/core/profile_entry.hpp"
+#include <cstdint>
+#include <vector>
+
+
+namespace runscope::analysis
+{
+    // Child lists built from ProfileEntry::parent in one pass over the
+    // entries, without sorting. Nodes are entry indices; siblings keep the
+    // order of the entries, which for a session's entries is the order they
+    // ended in. Entries without a known parent are roots.
+    class CallTree
+    {
+    public:
+        CallTree() = default;
+
+        void build(const std::vector<core::ProfileEntry>& entries);
+
+        [[nodiscard]] const std::vector<size_t>& roots() const noexcept { return roots_; }
+        [[nodiscard]] const std::vector<size_t>& children(size_t index) const { return children_[index]; }
+
+        // Duration minus the durations of the entry's children.
+        [[nodiscard]] int64_t self_time_ns(size_t index) const { return self_ns_[index]; }
+
+        [[nodiscard]] size_t size() const noexcept { return children_.size(); }
+
+        void clear();
+
+    private:
+        std::vector<size_t> roots_;
+        std::vector<std::vector<size_t>> children_;
+        std::vector<int64_t> self_ns_;
+    };
+}
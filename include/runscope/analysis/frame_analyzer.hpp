@@ -0,0 +1,96 @@
+#pragma once
+
+#include "runscope/core/profile_entry.hpp"
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+
+namespace runscope::analysis
+{
+    struct FrameInfo
+    {
+        size_t index{0};
+        int64_t start_ns{0};
+        int64_t end_ns{0};
+
+        [[nodiscard]] int64_t duration_ns() const noexcept
+        {
+            return end_ns - start_ns;
+        }
+    };
+
+    struct FrameStats
+    {
+        size_t frame_count;
+        int64_t total_time_ns;
+        int64_t min_time_ns;
+        int64_t max_time_ns;
+        double avg_time_ns;
+        int64_t p50_time_ns;
+        int64_t p90_time_ns;
+        int64_t p99_time_ns;
+        int64_t p999_time_ns;
+
+        FrameStats()
+            : frame_count(0), total_time_ns(0)
+            , min_time_ns(std::numeric_limits<int64_t>::max())
+            , max_time_ns(0), avg_time_ns(0.0)
+            , p50_time_ns(0), p90_time_ns(0)
+            , p99_time_ns(0), p999_time_ns(0)
+        {
+
+        }
+
+        [[nodiscard]] double frames_per_second() const noexcept
+        {
+            return avg_time_ns > 0.0 ? 1000000000.0 / avg_time_ns : 0.0;
+        }
+    };
+
+    // Equal-width frame-time buckets between the fastest and slowest frame.
+    struct FrameHistogram
+    {
+        int64_t min_ns{0};
+        int64_t bucket_width_ns{0};
+        std::vector<size_t> counts;
+    };
+
+    // Splits a session into frames at the marks of one series and indexes the
+    // entries by start time, so per-frame lookups are a binary search.
+    class FrameAnalyzer
+    {
+    public:
+        FrameAnalyzer() = default;
+
+        // With an empty frame_name, the series of the first mark is used.
+        void analyze(const std::vector<core::FrameMark>& marks,
+                     const std::vector<core::ProfileEntry>& entries,
+                     const std::string& frame_name = "");
+
+        [[nodiscard]] const std::string& frame_name() const noexcept { return frame_name_; }
+        [[nodiscard]] size_t frame_count() const noexcept { return frames_.size(); }
+        [[nodiscard]] const std::vector<FrameInfo>& frames() const noexcept { return frames_; }
+        [[nodiscard]] FrameInfo get_frame(size_t index) const;
+
+        [[nodiscard]] FrameStats get_stats() const;
+        [[nodiscard]] int64_t percentile_ns(double percentile) const;
+        [[nodiscard]] FrameHistogram get_histogram(size_t bucket_count) const;
+        [[nodiscard]] std::vector<FrameInfo> get_slowest_frames(size_t count) const;
+
+        // Entries that start inside the frame, in start order.
+        [[nodiscard]] std::vector<core::ProfileEntry> get_entries_in_frame(size_t index) const;
+
+        // Frame containing the given time, or frame_count() if there is none.
+        [[nodiscard]] size_t frame_at(int64_t time_ns) const;
+
+        void clear();
+
+    private:
+        std::string frame_name_;
+        std::vector<FrameInfo> frames_;
+        std::vector<int64_t> sorted_durations_;
+        std::vector<core::ProfileEntry> entries_;
+    };
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "runscope/core/profile_entry.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+namespace runscope::analysis
+{
+    // A scope that was open while its thread waited on a lock.
+    struct BlockedScope
+    {
+        std::string name;
+        size_t wait_count{0};
+        int64_t total_wait_ns{0};
+    };
+
+    struct LockStats
+    {
+        std::string name;
+        std::string file;
+        int line{0};
+        size_t wait_count{0};
+        int64_t total_wait_ns{0};
+        int64_t max_wait_ns{0};
+        size_t hold_count{0};
+        int64_t total_hold_ns{0};
+        int64_t max_hold_ns{0};
+
+        // Innermost scopes the waits happened in, by total wait.
+        std::vector<BlockedScope> blocked_scopes;
+
+        [[nodiscard]] double avg_wait_ns() const noexcept
+        {
+            return wait_count > 0 ? static_cast<double>(total_wait_ns) / static_cast<double>(wait_count) : 0.0;
+        }
+    };
+
+    // Ranks lock sites, by name, file and line, by the time threads spent
+    // waiting on them and attributes each wait to the innermost scope open on
+    // the waiting thread.
+    class LockAnalyzer
+    {
+    public:
+        LockAnalyzer() = default;
+
+        void analyze(const std::vector<core::LockEvent>& events,
+                     const std::vector<core::ProfileEntry>& entries);
+
+        // Every lock site, highest total wait first.
+        [[nodiscard]] const std::vector<LockStats>& get_lock_stats() const noexcept { return locks_; }
+        [[nodiscard]] std::vector<LockStats> get_top_locks(size_t count) const;
+        // The site with this name and the highest total wait.
+        [[nodiscard]] LockStats get_stats_for_lock(const std::string& name) const;
+
+        [[nodiscard]] int64_t total_wait_ns() const noexcept { return total_wait_ns_; }
+
+        void clear();
+
+    private:
+        std::vector<LockStats> locks_;
+        int64_t total_wait_ns_{0};
+    };
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "runscope/core/profile_entry.hpp"
+#include <map>
+#include <utility>
+#include <vector>
+
+
+namespace runscope::analysis
+{
+    // How far compensate_overhead moved each thread's timestamps: a time on a
+    // thread moves earlier by the full cost of the scopes that thread closed
+    // before it. Applying it to the counters, spans and marks of the same
+    // threads keeps them aligned with the compensated scopes.
+    struct OverheadShift
+    {
+        // Per thread, in closing order: the original end of each scope and
+        // the cost closed up to and including it.
+        std::map<core::ThreadId, std::vector<std::pair<int64_t, int64_t>>> closes;
+
+        [[nodiscard]] int64_t shifted(const core::ThreadId& thread, int64_t time_ns) const;
+    };
+
+    // Takes the profiler's own cost out of instrumented entries: each scope
+    // loses its self cost, and every enclosing scope on the same thread also
+    // loses the full cost of the scopes it contains. Later timestamps on a
+    // thread move earlier by the cost accumulated before them, so nesting is
+    // kept. Only EntrySource::Scope entries carry that cost; other entries are
+    // moved with their thread but keep their durations. Entries are returned
+    // in the order given; the shift applied is stored in shift if given.
+    [[nodiscard]] std::vector<core::ProfileEntry> compensate_overhead(std::vector<core::ProfileEntry> entries,
+                                                                      const core::ProfilerOverhead& overhead,
+                                                                      OverheadShift* shift = nullptr);
+}
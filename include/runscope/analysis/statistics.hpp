@@ -1,6 +1,7 @@
 #pragma once
 
 #include "runscope/core/profile_entry.hpp"
+#include <limits>
 #include <string>
 #include <map>
 #include <vector>
@@ -19,13 +20,41 @@ namespace runscope::analysis
         double self_time_ns;
         double inclusive_time_ns;
 
+        // perf_event totals over the calls that had each counter group read.
+        size_t software_call_count;
+        size_t hardware_call_count;
+        uint64_t page_faults;
+        uint64_t context_switches;
+        uint64_t cycles;
+        uint64_t instructions;
+        uint64_t cache_misses;
+
         FunctionStats()
             : call_count(0), total_time_ns(0)
             , min_time_ns(std::numeric_limits<int64_t>::max())
             , max_time_ns(0), avg_time_ns(0.0)
             , self_time_ns(0.0), inclusive_time_ns(0.0)
+            , software_call_count(0), hardware_call_count(0)
+            , page_faults(0), context_switches(0)
+            , cycles(0), instructions(0), cache_misses(0)
+        {
+
+        }
+
+        // Instructions per cycle; 0 without hardware counters.
+        [[nodiscard]] double ipc() const noexcept
         {
+            return cycles > 0 ? static_cast<double>(instructions) / static_cast<double>(cycles) : 0.0;
+        }
 
+        [[nodiscard]] double faults_per_call() const noexcept
+        {
+            return software_call_count > 0 ? static_cast<double>(page_faults) / static_cast<double>(software_call_count) : 0.0;
+        }
+
+        [[nodiscard]] double cache_misses_per_call() const noexcept
+        {
+            return hardware_call_count > 0 ? static_cast<double>(cache_misses) / static_cast<double>(hardware_call_count) : 0.0;
         }
     };
 
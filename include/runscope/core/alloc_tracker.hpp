@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+
+namespace runscope::core
+{
+    // Running allocation totals of one thread. Frees are counted on the thread
+    // that frees, which need not be the one that allocated.
+    struct AllocCounters
+    {
+        uint64_t allocated_bytes{0};
+        uint64_t freed_bytes{0};
+        uint64_t allocations{0};
+        uint64_t frees{0};
+    };
+
+    // Per-thread allocation counters fed by the optional runscope_alloc_hook
+    // library, which replaces global operator new/delete (or, when built with
+    // RUNSCOPE_ALLOC_HOOK_MALLOC, interposes malloc). Scopes record the change
+    // in the counters while installed() is true; without the hook linked in
+    // nothing is counted and scopes report no memory.
+    class AllocTracker
+    {
+    public:
+        // Stops counting on this thread while alive, so the profiler's own
+        // allocations (event chunks, stream registration, budget records) are
+        // never charged to the scopes around them. Nests.
+        class Pause
+        {
+        public:
+            Pause() noexcept { ++paused_; }
+            ~Pause() { --paused_; }
+
+            Pause(const Pause&) = delete;
+            Pause& operator=(const Pause&) = delete;
+        };
+
+        [[nodiscard]] static bool installed() noexcept
+        {
+            return installed_.load(std::memory_order_relaxed);
+        }
+
+        static void set_installed(const bool installed) noexcept
+        {
+            installed_.store(installed, std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] static const AllocCounters& local() noexcept
+        {
+            return counters_;
+        }
+
+        // Called from inside the allocator, so neither may allocate.
+        static void on_allocate(const size_t bytes) noexcept
+        {
+            if (paused_ != 0)
+            {
+                return;
+            }
+            AllocCounters& counters = counters_;
+            counters.allocated_bytes += bytes;
+            ++counters.allocations;
+        }
+
+        static void on_free(const size_t bytes) noexcept
+        {
+            if (paused_ != 0)
+            {
+                return;
+            }
+            AllocCounters& counters = counters_;
+            counters.freed_bytes += bytes;
+            ++counters.frees;
+        }
+
+    private:
+        // Initial-exec TLS is reached without a call into the dynamic loader,
+        // which may itself allocate.
+#if defined(__GNUC__)
+        [[gnu::tls_model("initial-exec")]]
+#endif
+        static inline constinit thread_local AllocCounters counters_{};
+#if defined(__GNUC__)
+        [[gnu::tls_model("initial-exec")]]
+#endif
+        static inline constinit thread_local uint32_t paused_{0};
+        static inline constinit std::atomic<bool> installed_{false};
+    };
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "category.hpp"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace runscope::core
+{
+    // Static description of one profiling site. The macros create one per call
+    // site with constant initialization, so entering a scope never copies the
+    // name or file; the id is assigned on first use and cached in the site.
+    struct CallSite
+    {
+        const char* name;
+        const char* file;
+        int line;
+        uint32_t categories;
+        int64_t budget_ns;      // longest a scope of this site should take; 0 = no budget
+
+        constexpr CallSite(const char* site_name, const char* site_file, const int site_line,
+                           const uint32_t site_categories = category::General,
+                           const int64_t site_budget_ns = 0) noexcept
+            : name(site_name)
+            , file(site_file)
+            , line(site_line)
+            , categories(site_categories)
+            , budget_ns(site_budget_ns)
+        {
+
+        }
+
+        CallSite(const CallSite&) = delete;
+        CallSite& operator=(const CallSite&) = delete;
+
+        [[nodiscard]] uint32_t id() const noexcept;
+
+        // Scopes of a throttled site time one call in 2^sample_shift(); the
+        // shift is adjusted at runtime to keep a session's overhead budget.
+        [[nodiscard]] uint32_t sample_shift() const noexcept
+        {
+            return sample_shift_.load(std::memory_order_relaxed);
+        }
+
+        void set_sample_shift(const uint32_t shift) const noexcept
+        {
+            sample_shift_.store(static_cast<uint8_t>(shift), std::memory_order_relaxed);
+        }
+
+        // Scopes of the site that ran over budget_ns since the session began.
+        [[nodiscard]] uint64_t budget_violations() const noexcept
+        {
+            return budget_violations_.load(std::memory_order_relaxed);
+        }
+
+        void count_budget_violation() const noexcept
+        {
+            budget_violations_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+    private:
+        friend class CallSiteRegistry;
+        mutable std::atomic<uint32_t> id_{0};
+        mutable std::atomic<uint8_t> sample_shift_{0};
+        mutable std::atomic<uint64_t> budget_violations_{0};
+    };
+
+    // Maps call-site ids back to their descriptors. Ids are dense and start at 1
+    // so they can index lookup tables directly.
+    class CallSiteRegistry
+    {
+    public:
+        static CallSiteRegistry& getInstance();
+
+        uint32_t register_site(const CallSite& site);
+
+        // Registers a site for a name only known at runtime. Repeated calls with
+        // the same name, file and line return the same id.
+        uint32_t intern(std::string_view name, std::string_view file, int line);
+
+        [[nodiscard]] const CallSite* find(uint32_t id) const;
+
+        // Times every site's scopes again, e.g. when a new session begins.
+        void reset_sample_shifts();
+
+        // Zeroes every site's budget violation count for a new session.
+        void reset_budget_violations();
+
+        // Id-indexed copy of the table for bulk lookups off the hot path.
+        [[nodiscard]] std::vector<const CallSite*> snapshot() const;
+
+        [[nodiscard]] size_t size() const;
+
+    private:
+        CallSiteRegistry() = default;
+        ~CallSiteRegistry() = default;
+        CallSiteRegistry(const CallSiteRegistry&) = delete;
+        CallSiteRegistry& operator=(const CallSiteRegistry&) = delete;
+
+        struct DynamicSite
+        {
+            std::string name;
+            std::string file;
+            CallSite site;
+
+            DynamicSite(std::string site_name, std::string site_file, int line);
+        };
+
+        std::vector<const CallSite*> sites_;
+        std::deque<DynamicSite> dynamic_sites_;
+        std::map<std::string, uint32_t, std::less<>> interned_;
+        mutable std::mutex mutex_;
+    };
+
+    inline uint32_t CallSite::id() const noexcept
+    {
+        const uint32_t cached = id_.load(std::memory_order_acquire);
+        if (cached != 0)
+        {
+            return cached;
+        }
+        return CallSiteRegistry::getInstance().register_site(*this);
+    }
+}
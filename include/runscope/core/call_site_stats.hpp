@@ -0,0 +1,148 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+
+
+namespace runscope::core
+{
+    // Log2 latency buckets: bucket i counts durations in [2^(i-1), 2^i) ticks.
+    inline constexpr size_t latency_bucket_count = 48;
+
+    inline size_t latency_bucket(const int64_t ticks) noexcept
+    {
+        const auto magnitude = static_cast<uint64_t>(ticks > 0 ? ticks : 0);
+        return std::min<size_t>(std::bit_width(magnitude), latency_bucket_count - 1);
+    }
+
+    // Merged per-call-site statistics, in nanoseconds.
+    struct CallSiteStats
+    {
+        uint32_t site_id{0};
+        std::string name;
+        std::string file;
+        int line{0};
+
+        uint64_t count{0};
+        int64_t total_ns{0};
+        int64_t min_ns{std::numeric_limits<int64_t>::max()};
+        int64_t max_ns{0};
+        std::array<uint64_t, latency_bucket_count> histogram{};
+        double ns_per_tick{1.0};
+
+        // Calls under the session's entry threshold, which have no entry of
+        // their own; included in the totals above. Always 0 in Aggregate mode.
+        uint64_t folded_count{0};
+        int64_t folded_total_ns{0};
+
+        [[nodiscard]] double mean_ns() const noexcept
+        {
+            return count > 0 ? static_cast<double>(total_ns) / static_cast<double>(count) : 0.0;
+        }
+
+        [[nodiscard]] int64_t bucket_upper_bound_ns(size_t bucket) const noexcept;
+
+        // Upper bound of the bucket holding the given percentile (0-100),
+        // clamped to the observed maximum.
+        [[nodiscard]] int64_t percentile_ns(double percentile) const noexcept;
+    };
+
+    // A call site throttled to stay within a session's overhead budget. Its
+    // recorded scopes stand for 2^shift calls each, as reflected in the counts
+    // and totals of its CallSiteStats.
+    struct ThrottledSite
+    {
+        uint32_t site_id{0};
+        std::string name;
+        std::string file;
+        int line{0};
+        uint32_t max_sample_every{1};   // fewest calls per timed one reached
+    };
+
+    // Running totals for one call site, written by a single thread and read
+    // concurrently by the merger. Single-writer updates need no RMW operations.
+    struct SiteAccumulator
+    {
+        std::atomic<uint64_t> count{0};
+        std::atomic<int64_t> total{0};
+        std::atomic<int64_t> min{std::numeric_limits<int64_t>::max()};
+        std::atomic<int64_t> max{0};
+        std::array<std::atomic<uint64_t>, latency_bucket_count> histogram{};
+
+        // weight: calls the duration stands for, above 1 for throttled sites.
+        void add(const int64_t duration, const uint64_t weight = 1) noexcept
+        {
+            constexpr auto relaxed = std::memory_order_relaxed;
+            count.store(count.load(relaxed) + weight, relaxed);
+            total.store(total.load(relaxed) + duration * static_cast<int64_t>(weight), relaxed);
+            if (duration < min.load(relaxed))
+            {
+                min.store(duration, relaxed);
+            }
+            if (duration > max.load(relaxed))
+            {
+                max.store(duration, relaxed);
+            }
+
+            const size_t bucket = latency_bucket(duration);
+            histogram[bucket].store(histogram[bucket].load(relaxed) + weight, relaxed);
+        }
+    };
+
+    // Per-thread accumulators indexed by call-site id. Storage grows in blocks
+    // that are never moved, so readers can walk it while the owner updates it.
+    class SiteAccumulatorTable
+    {
+    public:
+        static constexpr size_t block_size = 256;
+        static constexpr size_t max_blocks = 256;
+
+        SiteAccumulatorTable() = default;
+        ~SiteAccumulatorTable();
+
+        SiteAccumulatorTable(const SiteAccumulatorTable&) = delete;
+        SiteAccumulatorTable& operator=(const SiteAccumulatorTable&) = delete;
+
+        // Owner thread only. Sites beyond capacity are counted as dropped.
+        void add(uint32_t site_id, int64_t duration, uint64_t weight = 1) noexcept;
+
+        // Reader side: calls fn(site_id, accumulator) for every site seen so far.
+        template<typename Fn>
+        void for_each(Fn&& fn) const
+        {
+            for (size_t b = 0; b < max_blocks; ++b)
+            {
+                const Block* block = blocks_[b].load(std::memory_order_acquire);
+                if (!block)
+                {
+                    continue;
+                }
+                for (size_t i = 0; i < block_size; ++i)
+                {
+                    const auto& accumulator = block->sites[i];
+                    if (accumulator.count.load(std::memory_order_relaxed) > 0)
+                    {
+                        fn(static_cast<uint32_t>(b * block_size + i), accumulator);
+                    }
+                }
+            }
+        }
+
+        [[nodiscard]] uint64_t dropped() const noexcept { return dropped_.load(std::memory_order_relaxed); }
+
+    private:
+        struct Block
+        {
+            std::array<SiteAccumulator, block_size> sites;
+        };
+
+        std::array<std::atomic<Block*>, max_blocks> blocks_{};
+        std::atomic<uint64_t> dropped_{0};
+    };
+}
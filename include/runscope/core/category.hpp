@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+
+// Categories compiled into this translation unit. Scopes whose category is not
+// in the mask compile to nothing; define it (or set the RUNSCOPE_ENABLED_CATEGORIES
+// CMake cache variable) to strip instrumentation from production builds.
+#ifndef RUNSCOPE_ENABLED_CATEGORIES
+#define RUNSCOPE_ENABLED_CATEGORIES 0xFFFFFFFFu
+#endif
+
+
+namespace runscope::core
+{
+    // Bit flags grouping call sites for compile-time and runtime filtering.
+    namespace category
+    {
+        inline constexpr uint32_t General   = 1u << 0;
+        inline constexpr uint32_t IO        = 1u << 1;
+        inline constexpr uint32_t Network   = 1u << 2;
+        inline constexpr uint32_t Render    = 1u << 3;
+        inline constexpr uint32_t Physics   = 1u << 4;
+        inline constexpr uint32_t Memory    = 1u << 5;
+        inline constexpr uint32_t Locks     = 1u << 6;
+        inline constexpr uint32_t Tasks     = 1u << 7;
+        inline constexpr uint32_t Functions = 1u << 8;  // -finstrument-functions hooks
+
+        // Bits from User upwards are free for application-defined categories.
+        inline constexpr uint32_t User      = 1u << 16;
+        inline constexpr uint32_t All       = 0xFFFFFFFFu;
+    }
+}
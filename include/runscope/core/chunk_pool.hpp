@@ -0,0 +1,176 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <vector>
+
+
+namespace runscope::core
+{
+    // Recycles fixed-size storage blocks for the per-thread event buffers.
+    // Blocks released by a cleared or finished session are handed to the next
+    // buffer that grows, so steady-state recording does not go back to the
+    // allocator. Up to max_retained_bytes are kept; the rest is freed.
+    // Each thread keeps a few blocks of its own in front of the shared list,
+    // so the lock is only taken to refill or spill that cache.
+    template<size_t BlockSize, size_t BlockAlign>
+    class ChunkPool
+    {
+    public:
+        static constexpr size_t max_retained_bytes = 64u << 20;
+        static constexpr size_t local_capacity = 4;
+
+        // Never destroyed: buffers owned by other statics and thread-locals may
+        // release blocks during shutdown.
+        static ChunkPool& getInstance()
+        {
+            static auto* pool = new ChunkPool();
+            return *pool;
+        }
+
+        void* acquire()
+        {
+            LocalCache exiting{};
+            LocalCache* cache = local();
+            if (!cache)
+            {
+                cache = &exiting;
+            }
+            if (cache->count == 0)
+            {
+                // Half the cache at once, so a growing buffer takes the lock
+                // every few blocks rather than for each one.
+                refill(*cache, cache == &exiting ? 1 : local_capacity / 2);
+            }
+            if (cache->count != 0)
+            {
+                return cache->blocks[--cache->count];
+            }
+            return ::operator new(BlockSize, std::align_val_t{BlockAlign});
+        }
+
+        void release(void* block) noexcept
+        {
+            LocalCache exiting{};
+            LocalCache* cache = local();
+            if (!cache)
+            {
+                cache = &exiting;
+            }
+            else if (cache->count == local_capacity)
+            {
+                spill(*cache, local_capacity / 2);
+            }
+            cache->blocks[cache->count++] = block;
+            if (cache == &exiting)
+            {
+                spill(exiting, 1);
+            }
+        }
+
+        // Blocks in the shared list plus the calling thread's cache.
+        [[nodiscard]] size_t retained() const
+        {
+            const LocalCache* cache = local();
+            std::lock_guard<std::mutex> lock(mutex_);
+            return free_.size() + (cache ? cache->count : 0);
+        }
+
+    private:
+        struct LocalCache
+        {
+            std::array<void*, local_capacity> blocks;
+            size_t count;
+            bool registered;
+            bool exited;
+        };
+
+        // Hands a thread's blocks back to the shared list when it exits.
+        struct LocalFlush
+        {
+            ~LocalFlush()
+            {
+                getInstance().spill(local_, local_.count);
+                local_.exited = true;
+            }
+        };
+
+        ChunkPool() = default;
+        ChunkPool(const ChunkPool&) = delete;
+        ChunkPool& operator=(const ChunkPool&) = delete;
+
+        // nullptr once the calling thread is exiting; blocks then go straight
+        // to the shared list.
+        static LocalCache* local() noexcept
+        {
+            if (local_.exited)
+            {
+                return nullptr;
+            }
+            if (!local_.registered)
+            {
+                local_.registered = true;
+                [[maybe_unused]] thread_local LocalFlush flush;
+            }
+            return &local_;
+        }
+
+        void refill(LocalCache& cache, const size_t count)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            while (cache.count < count && !free_.empty())
+            {
+                cache.blocks[cache.count++] = free_.back();
+                free_.pop_back();
+            }
+        }
+
+        // Moves the cache's top blocks to the shared list, freeing those past
+        // max_retained_bytes.
+        void spill(LocalCache& cache, const size_t count) noexcept
+        {
+            std::array<void*, local_capacity> excess;
+            size_t excess_count = 0;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                for (size_t i = 0; i < count; ++i)
+                {
+                    void* block = cache.blocks[--cache.count];
+                    if (!retain(block))
+                    {
+                        excess[excess_count++] = block;
+                    }
+                }
+            }
+            for (size_t i = 0; i < excess_count; ++i)
+            {
+                ::operator delete(excess[i], std::align_val_t{BlockAlign});
+            }
+        }
+
+        // Called with mutex_ held.
+        bool retain(void* block) noexcept
+        {
+            if ((free_.size() + 1) * BlockSize > max_retained_bytes)
+            {
+                return false;
+            }
+            try
+            {
+                free_.push_back(block);
+                return true;
+            }
+            catch (...)
+            {
+                return false;
+            }
+        }
+
+        static inline constinit thread_local LocalCache local_{};
+
+        std::vector<void*> free_;
+        mutable std::mutex mutex_;
+    };
+}
@@ -1,10 +1,31 @@
 #pragma once
 
 #include "types.hpp"
+#include <atomic>
 #include <cstdint>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
 namespace runscope::core
 {
+    enum class ClockSource
+    {
+        System,     // std::chrono::high_resolution_clock, ticks are nanoseconds
+        Tsc         // rdtsc on x86, cntvct_el0 on aarch64
+    };
+
+    // Maps raw ticks of one session onto nanoseconds. Taken when the session
+    // starts; conversion only happens at analysis or export time.
+    struct ClockCalibration
+    {
+        ClockSource source{ClockSource::System};
+        int64_t tick_origin{0};
+        int64_t ns_origin{0};
+        double ns_per_tick{1.0};
+    };
+
     class Clock
     {
     public:
@@ -21,6 +42,48 @@ namespace runscope::core
 
         static int64_t duration_nanoseconds(const TimePoint& start, const TimePoint& end) noexcept;
         static double duration_milliseconds(const TimePoint& start, const TimePoint& end) noexcept;
+
+        // CPU time consumed by the calling thread, or 0 where the platform has
+        // no per-thread CPU clock. A system call on Linux, so opt-in only.
+        static int64_t thread_cpu_nanoseconds() noexcept;
+
+        // Raw timestamp from the active source, used on the capture path.
+        static int64_t ticks() noexcept
+        {
+            if (tsc_active_.load(std::memory_order_relaxed))
+            {
+                return read_tsc();
+            }
+            return now_nanoseconds();
+        }
+
+        // Preferred source for sessions started from now on. Requesting Tsc on
+        // a CPU without an invariant counter keeps the system clock and returns false.
+        static bool set_source(ClockSource source) noexcept;
+        static ClockSource source() noexcept;
+        static bool tsc_available() noexcept;
+
+        // Activates the preferred source and measures it against CLOCK_MONOTONIC.
+        static ClockCalibration calibrate();
+
+        static int64_t to_nanoseconds(int64_t ticks, const ClockCalibration& calibration) noexcept;
+        static int64_t ticks_to_duration_ns(int64_t ticks, const ClockCalibration& calibration) noexcept;
+        static int64_t duration_ns_to_ticks(int64_t nanoseconds, const ClockCalibration& calibration) noexcept;
+
+    private:
+        static int64_t read_tsc() noexcept
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            return static_cast<int64_t>(__rdtsc());
+#elif defined(__aarch64__)
+            uint64_t value;
+            asm volatile("mrs %0, cntvct_el0" : "=r"(value));
+            return static_cast<int64_t>(value);
+#else
+            return now_nanoseconds();
+#endif
+        }
+
+        static inline std::atomic<bool> tsc_active_{false};
     };
 }
-
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <type_traits>
+
+
+namespace runscope::core
+{
+    enum class EventKind : uint8_t
+    {
+        Scope,
+        Sample,     // one frame of a sampled stack; depth 0 is the outermost frame
+        Frame,      // frame boundary; start == end
+        Counter,    // counter value; start is the timestamp, end holds the value's bits
+        AsyncBegin, // async span events; start is the timestamp, end holds the span id
+        AsyncStep,
+        AsyncEnd,
+        Metric,     // measurement for the Scope record that follows it in the same stream
+        LockWait,   // start/end bound the wait; site_id is the lock, aux 1 for shared waits
+        LockHold,
+        Function    // like Scope, but site_id is a FunctionTracer id rather than a call site
+    };
+
+    enum class MetricKind : uint16_t
+    {
+        None,
+        Allocations,    // start: bytes allocated, end: of which by the scope itself, aux: allocation count
+        CpuTime,        // start: thread CPU nanoseconds spent in the scope
+        PerfSoftware,   // start: task-clock ns, end: page faults, aux: context switches
+        PerfHardware    // start: cycles, end: instructions, aux: cache misses
+    };
+
+    // Fixed-size record written on the capture path. It holds ids instead of
+    // strings: names and files stay in the CallSiteRegistry and thread ids and
+    // names in the ThreadRegistry, and a ProfileEntry is only materialized when
+    // the UI or an exporter asks for one.
+    //
+    // A scope's record is written when it ends, after those of the scopes it
+    // encloses. Instrumented scopes set flag_nested and store in aux how many
+    // scope records of their thread they enclose, so a reader links each
+    // scope to its parent in one pass over the stream.
+    struct EventRecord
+    {
+        // Set when start/end are already nanoseconds rather than Clock ticks.
+        static constexpr uint8_t flag_nanoseconds = 0x01;
+        // Scope and Function records only: aux is the number of nested records.
+        static constexpr uint8_t flag_nested = 0x02;
+        // Scope records under the session's entry threshold: added to the
+        // call site's accumulator instead of being stored.
+        static constexpr uint8_t flag_folded = 0x04;
+        // Scope records of throttled sites keep the site's sample shift in the
+        // high bits: the record stands for 2^shift calls.
+        static constexpr uint8_t sample_shift_offset = 4;
+        static constexpr uint32_t max_sample_shift = 15;
+
+        int64_t start;  // Clock::ticks() unless flag_nanoseconds is set
+        int64_t end;
+        uint32_t site_id;
+        uint16_t thread_index;
+        uint16_t depth;
+        EventKind kind;
+        uint8_t flags;
+        MetricKind metric;  // Metric records only
+        uint32_t aux;   // kind-specific payload; nested scope count for scopes
+
+        [[nodiscard]] int64_t duration() const noexcept
+        {
+            return end - start;
+        }
+
+        [[nodiscard]] uint32_t sample_shift() const noexcept
+        {
+            return flags >> sample_shift_offset;
+        }
+
+        void set_sample_shift(const uint32_t shift) noexcept
+        {
+            flags = static_cast<uint8_t>((flags & ((1u << sample_shift_offset) - 1)) | (shift << sample_shift_offset));
+        }
+
+        // Calls this record stands for.
+        [[nodiscard]] uint64_t weight() const noexcept
+        {
+            return uint64_t{1} << sample_shift();
+        }
+
+        [[nodiscard]] double counter_value() const noexcept
+        {
+            return std::bit_cast<double>(end);
+        }
+
+        void set_counter_value(const double value) noexcept
+        {
+            end = std::bit_cast<int64_t>(value);
+        }
+
+        [[nodiscard]] uint64_t async_id() const noexcept
+        {
+            return std::bit_cast<uint64_t>(end);
+        }
+
+        void set_async_id(const uint64_t id) noexcept
+        {
+            end = std::bit_cast<int64_t>(id);
+        }
+    };
+
+    static_assert(std::is_trivially_copyable_v<EventRecord>);
+    static_assert(sizeof(EventRecord) == 32);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "runscope/platform/signal_sampler.hpp"
+#include <cstdint>
+
+
+namespace runscope::core
+{
+    // Records functions entered through the -finstrument-functions hooks of
+    // the optional runscope_autoinstrument library. Calls are kept as raw
+    // addresses mapped to dense ids by a lock-free table on the capture path,
+    // and hits are counted per thread; names are resolved with dladdr only
+    // when entries are read. Functions record while the Functions category is
+    // recording, nest with ordinary scopes, and are not kept by Aggregate
+    // sessions.
+    class FunctionTracer
+    {
+    public:
+        // Called from the hooks; neither may be instrumented.
+        static void enter(void* function) noexcept;
+        static void exit(void* function) noexcept;
+
+        // Called once by runscope_autoinstrument when it is loaded; without
+        // it prepare() allocates nothing.
+        static void register_hooks() noexcept;
+
+        // Allocates the function table and, for threads that have called
+        // hooks before, hit counters for every function seen so far, so the
+        // hooks of the session about to begin allocate only for new threads
+        // and functions. Called by ProfilerEngine::begin_session.
+        static void prepare();
+
+        // Per-address exclusion list, e.g. for hot helpers that are not worth
+        // their enter/exit cost.
+        static void exclude(const void* function);
+        static void include(const void* function);
+
+        // Once a function has been entered this many times it is no longer
+        // recorded, so tiny hot functions drop out after a short while. The
+        // cutoff applies to each thread's own calls; 0 disables it.
+        static void set_hit_limit(uint64_t calls) noexcept;
+        [[nodiscard]] static uint64_t hit_limit() noexcept;
+
+        // Times a function was entered while the Functions category was
+        // recording, including calls past the cutoff or excluded, summed over
+        // all threads.
+        [[nodiscard]] static uint64_t hits(const void* function);
+
+        // Symbol of a function id taken from a Function record, resolved on
+        // first use and cached.
+        [[nodiscard]] static const platform::SymbolInfo& symbol(uint32_t id);
+    };
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+
+namespace runscope::core
+{
+    // Raw view of one scope that has begun but not ended yet.
+    struct OpenScopeRecord
+    {
+        uint16_t thread_index{0};
+        uint16_t depth{0};
+        uint32_t site_id{0};
+        int64_t start_ticks{0};
+    };
+
+    // Per-thread stacks of the scopes currently open, so a scope that runs
+    // for a long time, or never returns, can be seen before it ends. Each
+    // thread writes only its own stack; other threads read it concurrently
+    // without stopping the owner. Stacks are never freed: a thread's stack is
+    // handed to the next new thread once it exits.
+    class OpenScopeTable
+    {
+    public:
+        // Scopes nested deeper than this are counted but not shown.
+        static constexpr size_t max_depth = 64;
+
+        static OpenScopeTable& getInstance();
+
+        // Owner thread only; every push must be matched by a pop.
+        static void push(uint32_t site_id, int64_t start_ticks) noexcept;
+        static void pop() noexcept;
+
+        // Open scopes of every thread, outermost first within a thread.
+        [[nodiscard]] std::vector<OpenScopeRecord> snapshot() const;
+
+    private:
+        OpenScopeTable() = default;
+        ~OpenScopeTable() = default;
+        OpenScopeTable(const OpenScopeTable&) = delete;
+        OpenScopeTable& operator=(const OpenScopeTable&) = delete;
+
+        // Slots are seqlocks: the sequence is odd while the owner rewrites
+        // them, and a reader retries until it reads the same even value on
+        // both sides of the fields.
+        struct Slot
+        {
+            std::atomic<uint32_t> sequence{0};
+            std::atomic<uint32_t> site_id{0};
+            std::atomic<int64_t> start_ticks{0};
+        };
+
+        struct Stack
+        {
+            std::array<Slot, max_depth> slots;
+            std::atomic<uint32_t> depth{0};
+            std::atomic<uint16_t> thread_index{0};
+            std::atomic<bool> in_use{false};
+        };
+
+        struct LocalStack;
+        static Stack& local();
+
+        Stack& acquire(uint16_t thread_index);
+        void release(Stack& stack);
+
+        std::deque<Stack> stacks_;
+        std::vector<Stack*> free_;
+        mutable std::mutex mutex_;
+    };
+}
@@ -8,6 +8,53 @@
 
 namespace runscope::core
 {
+    // perf_event counter deltas of one scope. software/hardware tell which
+    // group was read; both stay false unless the session enabled counters for
+    // the scope's category.
+    struct PerfCounts
+    {
+        bool software{false};
+        bool hardware{false};
+        uint64_t task_clock_ns{0};
+        uint64_t page_faults{0};
+        uint64_t context_switches{0};
+        uint64_t cycles{0};
+        uint64_t instructions{0};
+        uint64_t cache_misses{0};
+    };
+
+    // Calibrated cost of instrumenting one scope. self_ns is how much an empty
+    // scope adds to its own measured duration; total_ns is the full enter and
+    // exit cost it adds to every enclosing scope. Scopes that read perf_event
+    // counters cost more and use the perf_ values instead.
+    struct ProfilerOverhead
+    {
+        int64_t self_ns{0};
+        int64_t total_ns{0};
+        int64_t perf_self_ns{0};
+        int64_t perf_total_ns{0};
+
+        [[nodiscard]] int64_t self_cost(const PerfCounts& perf) const noexcept
+        {
+            return perf.software || perf.hardware ? perf_self_ns : self_ns;
+        }
+
+        [[nodiscard]] int64_t total_cost(const PerfCounts& perf) const noexcept
+        {
+            return perf.software || perf.hardware ? perf_total_ns : total_ns;
+        }
+    };
+
+    // Where an entry came from. Only Scope entries carry the calibrated
+    // instrumentation cost of ProfilerOverhead.
+    enum class EntrySource : uint8_t
+    {
+        Scope,      // ScopeProfiler
+        Function,   // FunctionTracer (-finstrument-functions)
+        Sample,     // frame of a sampled stack
+        Recorded    // passed in with record_entry() or imported
+    };
+
     struct ProfileEntry
     {
         std::string name;
@@ -17,8 +64,15 @@ namespace runscope::core
         int64_t end_ns;
         ThreadId thread_id;
         int depth;
-        uint64_t memory_used;
-        double cpu_usage;
+        int64_t parent;             // index of the enclosing entry in the same vector, -1 if unknown
+        uint64_t memory_used;       // bytes allocated while the scope was open, children included
+        uint64_t self_memory_used;  // memory_used minus what child scopes allocated
+        uint64_t allocation_count;
+        int64_t cpu_time_ns;        // thread CPU time while the scope was open
+        double cpu_usage;           // cpu_time_ns as a percentage of the scope's wall time
+        PerfCounts perf;
+        uint32_t sample_weight;     // calls the entry stands for; above 1 for throttled call sites
+        EntrySource source;
         std::vector<std::shared_ptr<ProfileEntry>> children;
 
         ProfileEntry()
@@ -26,8 +80,14 @@ namespace runscope::core
             , start_ns(0)
             , end_ns(0)
             , depth(0)
+            , parent(-1)
             , memory_used(0)
+            , self_memory_used(0)
+            , allocation_count(0)
+            , cpu_time_ns(0)
             , cpu_usage(0.0)
+            , sample_weight(1)
+            , source(EntrySource::Scope)
         {
 
         }
@@ -63,16 +123,164 @@ namespace runscope::core
         }
     };
 
+    // Boundary between two frames of the series named by name.
+    struct FrameMark
+    {
+        std::string name;
+        ThreadId thread_id;
+        int64_t time_ns{0};
+    };
+
+    // One value of the counter series named by name.
+    struct CounterSample
+    {
+        std::string name;
+        ThreadId thread_id;
+        int64_t time_ns{0};
+        double value{0.0};
+    };
+
+    struct AsyncStep
+    {
+        std::string name;
+        ThreadId thread_id;
+        int64_t time_ns{0};
+    };
+
+    // Work identified by an id rather than a thread: begun on one thread,
+    // optionally stepped and ended on others.
+    struct AsyncSpan
+    {
+        uint64_t id{0};
+        std::string name;
+        ThreadId begin_thread;
+        ThreadId end_thread;
+        int64_t begin_ns{0};
+        int64_t end_ns{0};
+        bool complete{false};
+        std::vector<AsyncStep> steps;
+
+        [[nodiscard]] int64_t duration_ns() const noexcept
+        {
+            return complete ? end_ns - begin_ns : 0;
+        }
+
+        // Time from begin to the first step, e.g. waiting in a queue.
+        [[nodiscard]] int64_t queued_ns() const noexcept
+        {
+            return steps.empty() ? 0 : steps.front().time_ns - begin_ns;
+        }
+
+        // Time from the first step (or begin, without steps) to end.
+        [[nodiscard]] int64_t active_ns() const noexcept
+        {
+            if (!complete)
+            {
+                return 0;
+            }
+            return end_ns - (steps.empty() ? begin_ns : steps.front().time_ns);
+        }
+    };
+
+    // A wait for, or hold of, a profiled mutex named by name.
+    struct LockEvent
+    {
+        enum class Kind : uint8_t
+        {
+            Wait,
+            Hold
+        };
+
+        Kind kind{Kind::Wait};
+        bool shared{false};     // a reader waiting on a ProfiledSharedMutex
+        std::string name;
+        std::string file;
+        int line{0};
+        ThreadId thread_id;
+        int64_t start_ns{0};
+        int64_t end_ns{0};
+
+        [[nodiscard]] int64_t duration_ns() const noexcept
+        {
+            return end_ns - start_ns;
+        }
+    };
+
+    // A scope that had begun but not yet ended when it was looked at.
+    struct OpenScope
+    {
+        std::string name;
+        std::string file;
+        int line{0};
+        ThreadId thread_id;
+        std::string thread_name;
+        int depth{0};
+        int64_t start_ns{0};
+        int64_t elapsed_ns{0};  // time open so far
+
+        [[nodiscard]] int64_t now_ns() const noexcept
+        {
+            return start_ns + elapsed_ns;
+        }
+    };
+
+    // Scopes of one call site directly inside a budget violation.
+    struct BudgetChild
+    {
+        std::string name;
+        uint64_t count{0};
+        int64_t total_ns{0};
+    };
+
+    // A scope that took longer than its call site's budget, with where the
+    // time went: its direct children by call site, slowest first.
+    struct BudgetViolation
+    {
+        std::string name;
+        std::string file;
+        int line{0};
+        ThreadId thread_id;
+        std::string thread_name;
+        int64_t start_ns{0};
+        int64_t duration_ns{0};
+        int64_t budget_ns{0};
+        std::vector<BudgetChild> children;
+
+        // Time not spent in any child scope.
+        [[nodiscard]] int64_t self_ns() const noexcept
+        {
+            int64_t children_ns = 0;
+            for (const auto& child : children)
+            {
+                children_ns += child.total_ns;
+            }
+            return duration_ns - children_ns;
+        }
+    };
+
+    // Budget violations of one call site: all of them counted, the slowest kept.
+    struct BudgetSiteStats
+    {
+        std::string name;
+        std::string file;
+        int line{0};
+        int64_t budget_ns{0};
+        uint64_t violations{0};
+        std::vector<BudgetViolation> worst;     // slowest first
+    };
+
     struct ThreadInfo
     {
         ThreadId id;
         std::string name;
         uint64_t total_time_ns;
         size_t entry_count;
+        uint64_t overhead_ns;       // estimated time spent in the profiler's own scope code
 
         ThreadInfo()
             : total_time_ns(0)
             , entry_count(0)
+            , overhead_ns(0)
         {
 
         }
@@ -0,0 +1,154 @@
+#pragma once
+
+#include "category.hpp"
+#include "call_site.hpp"
+#include "clock.hpp"
+#include "event_record.hpp"
+#include "profiler_engine.hpp"
+#include <mutex>
+#include <shared_mutex>
+#include <string_view>
+
+
+namespace runscope::core
+{
+    // Records one lock wait or hold that exceeded the session's lock threshold.
+    void record_lock_event(uint32_t site_id, EventKind kind, int64_t start_ticks, int64_t end_ticks, bool shared) noexcept;
+
+    // Exclusive locking shared by the profiled mutexes. Reporting is active
+    // while the Locks category is recording: an uncontended lock() is then a
+    // try_lock() plus one timestamp, and a wait or hold is only recorded when
+    // it lasts longer than SessionOptions::lock_threshold_ns.
+    template<typename Mutex>
+    class BasicProfiledMutex
+    {
+    public:
+        explicit BasicProfiledMutex(const CallSite& site) noexcept
+            : site_id_(site.id())
+        {
+
+        }
+
+        // For names only known at runtime; interns the name once.
+        explicit BasicProfiledMutex(const std::string_view name, const char* file = "", const int line = 0)
+            : site_id_(CallSiteRegistry::getInstance().intern(name, file, line))
+        {
+
+        }
+
+        BasicProfiledMutex(const BasicProfiledMutex&) = delete;
+        BasicProfiledMutex& operator=(const BasicProfiledMutex&) = delete;
+
+        void lock()
+        {
+            if (!ProfilerEngine::category_enabled(category::Locks))
+            {
+                mutex_.lock();
+                hold_start_ = 0;
+                return;
+            }
+            if (mutex_.try_lock())
+            {
+                hold_start_ = Clock::ticks();
+                return;
+            }
+
+            const int64_t wait_start = Clock::ticks();
+            mutex_.lock();
+            hold_start_ = Clock::ticks();
+            if (hold_start_ - wait_start >= ProfilerEngine::lock_threshold_ticks())
+            {
+                record_lock_event(site_id_, EventKind::LockWait, wait_start, hold_start_, false);
+            }
+        }
+
+        bool try_lock()
+        {
+            if (!mutex_.try_lock())
+            {
+                return false;
+            }
+            hold_start_ = ProfilerEngine::category_enabled(category::Locks) ? Clock::ticks() : 0;
+            return true;
+        }
+
+        void unlock()
+        {
+            // Read before unlocking: the next owner overwrites it.
+            const int64_t hold_start = hold_start_;
+            if (hold_start == 0)
+            {
+                mutex_.unlock();
+                return;
+            }
+
+            const int64_t hold_end = Clock::ticks();
+            mutex_.unlock();
+            if (hold_end - hold_start >= ProfilerEngine::lock_threshold_ticks())
+            {
+                record_lock_event(site_id_, EventKind::LockHold, hold_start, hold_end, false);
+            }
+        }
+
+        [[nodiscard]] uint32_t site_id() const noexcept { return site_id_; }
+
+    protected:
+        Mutex mutex_;
+        uint32_t site_id_;
+        int64_t hold_start_{0};
+    };
+
+    class ProfiledMutex : public BasicProfiledMutex<std::mutex>
+    {
+    public:
+        using BasicProfiledMutex::BasicProfiledMutex;
+    };
+
+    // Shared owners report waits only, since several may hold the lock at once.
+    class ProfiledSharedMutex : public BasicProfiledMutex<std::shared_mutex>
+    {
+    public:
+        using BasicProfiledMutex::BasicProfiledMutex;
+
+        void lock_shared()
+        {
+            if (!ProfilerEngine::category_enabled(category::Locks))
+            {
+                mutex_.lock_shared();
+                return;
+            }
+            if (mutex_.try_lock_shared())
+            {
+                return;
+            }
+
+            const int64_t wait_start = Clock::ticks();
+            mutex_.lock_shared();
+            const int64_t acquired = Clock::ticks();
+            if (acquired - wait_start >= ProfilerEngine::lock_threshold_ticks())
+            {
+                record_lock_event(site_id_, EventKind::LockWait, wait_start, acquired, true);
+            }
+        }
+
+        bool try_lock_shared()
+        {
+            return mutex_.try_lock_shared();
+        }
+
+        void unlock_shared()
+        {
+            mutex_.unlock_shared();
+        }
+    };
+}
+
+
+// Static call site for a profiled mutex, e.g.
+//     runscope::core::ProfiledMutex queue_mutex_{RUNSCOPE_LOCK_SITE("queue")};
+#define RUNSCOPE_LOCK_SITE(name) \
+    ([]() -> const ::runscope::core::CallSite& \
+    { \
+        static constinit ::runscope::core::CallSite site{name, __FILE__, __LINE__, ::runscope::core::category::Locks}; \
+        return site; \
+    }())
@@ -1,47 +1,194 @@
 #pragma once
 
 #include "types.hpp"
+#include "category.hpp"
 #include "profile_entry.hpp"
+#include "event_record.hpp"
 #include "profiler_session.hpp"
+#include "scope_budget.hpp"
 #include <memory>
 #include <string>
 #include <vector>
 #include <mutex>
 #include <atomic>
+#include <condition_variable>
+#include <thread>
+#include <unordered_map>
 
 namespace runscope::core
 {
+    // Everything a scope consults on the hot path. Threads share the
+    // engine's set; overhead calibration points its own thread at a private
+    // set and session, so other threads keep recording unchanged.
+    struct ScopeSettings
+    {
+        std::atomic<uint32_t> active_categories{0};
+        std::atomic<bool> cpu_time_active{false};
+        std::atomic<uint32_t> perf_categories_active{0};
+        std::atomic<int64_t> lock_threshold_ticks{0};
+        std::atomic<int64_t> scope_budget_ticks{0};
+        std::atomic<int64_t> entry_threshold_ticks{0};
+        std::atomic<bool> open_scopes_active{false};
+        std::atomic<double> ns_per_tick{1.0};
+        ProfilerSession* private_session{nullptr};
+    };
+
     class ProfilerEngine
     {
     public:
         static ProfilerEngine& getInstance();
 
         void begin_session(const std::string& name, ProfilerMode mode = ProfilerMode::Instrumentation);
+        void begin_session(const std::string& name, const SessionOptions& options);
         void end_session() const;
 
         void record_entry(ProfileEntry entry) const;
+        void record_event(const EventRecord& record) const;
+
+        // Notes in the current session that a call site's scopes are now
+        // timed one in 2^sample_shift calls.
+        void record_throttle(uint32_t site_id, uint32_t sample_shift) const;
+
+        // Queues a scope that overran its call site's budget in the calling
+        // thread's stream of the current session, without blocking.
+        void record_budget_violation(BudgetViolationRecord violation) const;
 
         bool is_active() const noexcept;
         ProfilerMode mode() const noexcept;
 
         std::shared_ptr<ProfilerSession> current_session();
         std::vector<ProfileEntry> get_entries() const;
+        std::vector<ProfileEntry> get_entries_since(EntryCursor& cursor) const;
+        std::vector<FrameMark> get_frame_marks() const;
+        std::vector<FrameMark> get_frame_marks(EntryCursor& cursor) const;
+        std::vector<CounterSample> get_counter_samples() const;
+        std::vector<CounterSample> get_counter_samples(EntryCursor& cursor) const;
+        std::vector<AsyncSpan> get_async_spans() const;
+        std::vector<LockEvent> get_lock_events() const;
+        std::vector<CallSiteStats> get_site_stats() const;
+        std::vector<CallSiteStats> get_accumulated_stats() const;
+        std::vector<ThrottledSite> get_throttled_sites() const;
+        std::vector<OpenScope> get_open_scopes() const;
+        std::vector<OpenScope> get_scope_overruns() const;
+        std::vector<BudgetSiteStats> get_budget_stats() const;
+        uint64_t dropped_events() const;
 
         void clear() const;
 
         void set_enabled(bool enabled) noexcept;
         bool is_enabled() const noexcept;
 
+        // Runtime category filter; scopes outside the mask are skipped before
+        // any timestamp is taken.
+        void set_categories(uint32_t mask) noexcept;
+        uint32_t categories() const noexcept;
+
+        // Hot-path check: a single relaxed load of the effective mask, which is
+        // zero whenever profiling is disabled or no session is active.
+        static bool category_enabled(const uint32_t categories) noexcept
+        {
+            return (settings().active_categories.load(std::memory_order_relaxed) & categories) != 0;
+        }
+
+        // Whether the active session asked scopes to measure thread CPU time.
+        static bool cpu_time_enabled() noexcept
+        {
+            return settings().cpu_time_active.load(std::memory_order_relaxed);
+        }
+
+        // Whether scopes of these categories read perf_event counters.
+        static bool perf_counters_enabled(const uint32_t categories) noexcept
+        {
+            return (settings().perf_categories_active.load(std::memory_order_relaxed) & categories) != 0;
+        }
+
+        // SessionOptions::lock_threshold_ns of the active session, in Clock ticks.
+        static int64_t lock_threshold_ticks() noexcept
+        {
+            return settings().lock_threshold_ticks.load(std::memory_order_relaxed);
+        }
+
+        // Shortest average time between timed scopes on one thread that keeps
+        // them within SessionOptions::overhead_budget, in Clock ticks; 0 when
+        // the active session does not throttle.
+        static int64_t scope_budget_ticks() noexcept
+        {
+            return settings().scope_budget_ticks.load(std::memory_order_relaxed);
+        }
+
+        // SessionOptions::entry_threshold_ns of the active session, in Clock ticks.
+        static int64_t entry_threshold_ticks() noexcept
+        {
+            return settings().entry_threshold_ticks.load(std::memory_order_relaxed);
+        }
+
+        // Duration in nanoseconds of Clock ticks of the active session.
+        static int64_t ticks_to_ns(const int64_t ticks) noexcept
+        {
+            return static_cast<int64_t>(static_cast<double>(ticks) * settings().ns_per_tick.load(std::memory_order_relaxed));
+        }
+
+        // Whether scopes enter themselves in the OpenScopeTable while they run.
+        static bool open_scopes_enabled() noexcept
+        {
+            return settings().open_scopes_active.load(std::memory_order_relaxed);
+        }
+
     private:
         ProfilerEngine() = default;
-        ~ProfilerEngine() = default;
+        ~ProfilerEngine();
         ProfilerEngine(const ProfilerEngine&) = delete;
         ProfilerEngine& operator=(const ProfilerEngine&) = delete;
 
+        void update_active_categories() const noexcept;
+
+        // Times empty scopes through the real recording path, in a scratch
+        // session configured like the one about to begin that only the
+        // calling thread records into.
+        ProfilerOverhead calibrate_overhead(const SessionOptions& options);
+
+        // Sampling and Both sessions: the collector thread moves stacks from
+        // the signal sampler into the session and symbolizes them.
+        void start_sampling(uint32_t frequency_hz) const;
+        void stop_sampling() const;
+        void collect_samples() const;
+
+        // Sessions with an open scope budget or a budget violation callback:
+        // until the session ends, the watchdog thread checks the session's
+        // open scopes against the budget and passes violations to the callback.
+        void start_watchdog(std::shared_ptr<ProfilerSession> session) const;
+        void stop_watchdog() const;
+        void run_watchdog(ProfilerSession& session) const;
+
         std::shared_ptr<ProfilerSession> current_session_;
+        mutable std::atomic<uint64_t> active_session_id_{0};
         mutable std::mutex mutex_;
         std::atomic<bool> enabled_{true};
-        ProfilerMode mode_{ProfilerMode::Instrumentation};
+        std::atomic<uint32_t> category_mask_{category::All};
+        std::atomic<ProfilerMode> mode_{ProfilerMode::Instrumentation};
+
+        mutable std::thread sample_collector_;
+        mutable std::atomic<bool> collecting_{false};
+        mutable std::unordered_map<uintptr_t, uint32_t> sample_sites_;
+        mutable std::mutex sampling_mutex_;
+
+        mutable std::thread watchdog_;
+        mutable std::mutex watchdog_mutex_;
+        mutable bool watching_{false};
+        mutable std::mutex watching_mutex_;
+        mutable std::condition_variable watching_changed_;
+
+        static const ScopeSettings& settings() noexcept
+        {
+            return *settings_;
+        }
+
+        static inline constinit ScopeSettings shared_settings_{};
+        // Initial-exec TLS is a single load, even from a shared library.
+#if defined(__GNUC__)
+        [[gnu::tls_model("initial-exec")]]
+#endif
+        static inline constinit thread_local const ScopeSettings* settings_{&shared_settings_};
     };
 }
 
@@ -1,52 +1,355 @@
 #pragma once
 
 #include "types.hpp"
+#include "clock.hpp"
 #include "profile_entry.hpp"
+#include "event_record.hpp"
+#include "thread_buffer.hpp"
+#include "ring_buffer.hpp"
+#include "call_site_stats.hpp"
+#include "thread_registry.hpp"
+#include "scope_budget.hpp"
 #include <string>
 #include <vector>
 #include <map>
 #include <mutex>
 #include <memory>
+#include <atomic>
+#include <functional>
+#include <utility>
 
 
 namespace runscope::core
 {
+    struct CallSite;
+
+    struct SessionOptions
+    {
+        ProfilerMode mode{ProfilerMode::Instrumentation};
+        RecordingMode recording{RecordingMode::Full};
+
+        // FlightRecorder only: memory budget of each thread's ring.
+        size_t ring_bytes_per_thread{1 << 20};
+
+        // Sampling and Both only: SIGPROF rate per thread, in CPU-time hertz.
+        uint32_t sampling_hz{1000};
+
+        // Scopes also read the thread's CPU clock, giving each entry its
+        // on-CPU share of wall time. Costs two clock_gettime calls per scope.
+        bool cpu_time{false};
+
+        // Scopes in these categories also read the thread's perf_event
+        // counters (Linux). Hardware counters are skipped where no PMU is
+        // exposed, as in most VMs and containers.
+        uint32_t perf_categories{0};
+
+        // Profiled mutexes record waits and holds at least this long.
+        int64_t lock_threshold_ns{1000};
+
+        // Measure the cost of an empty scope when the session begins, so
+        // analysis and export can subtract it (see ProfilerSession::overhead()).
+        bool calibrate_overhead{true};
+
+        // Largest share of a thread's time its scopes may cost, e.g. 0.02.
+        // Sites hot enough to exceed it are timed one in N calls instead,
+        // with N a power of two adjusted at runtime (see
+        // ProfilerSession::get_throttled_sites()). 0 times every scope.
+        // Needs calibrate_overhead.
+        double overhead_budget{0.0};
+
+        // Scopes shorter than this are only counted in their call site's
+        // statistics (see CallSiteStats::folded_count) rather than kept as
+        // entries, so the timeline holds just the slow ones. 0 keeps all.
+        int64_t entry_threshold_ns{0};
+
+        // Keep a live table of the scopes each thread has open, so
+        // get_open_scopes() shows them while they run. A few extra stores
+        // per scope.
+        bool track_open_scopes{false};
+
+        // Watchdog for scopes that run too long: open scopes are checked
+        // against this budget several times per budget, and each one found
+        // over it is reported once, in get_scope_overruns() and to
+        // on_scope_overrun, which runs on the watchdog thread and also gets
+        // every scope open at the time. Implies track_open_scopes; 0 = off.
+        int64_t open_scope_budget_ns{0};
+        std::function<void(const OpenScope& overrun, const std::vector<OpenScope>& open)> on_scope_overrun;
+
+        // Scopes of RUNSCOPE_PROFILE_SCOPE_BUDGET sites that take longer than
+        // the budget are counted per site, and the budget_worst_count slowest
+        // of each are kept with their child scopes. This works in any mode,
+        // including Aggregate. on_budget_violation is called for each one, on
+        // the watchdog thread rather than the thread that ran the scope.
+        size_t budget_worst_count{8};
+        std::function<void(const BudgetViolation&)> on_budget_violation;
+    };
+
+    // Read position into a session for incremental retrieval. A default
+    // constructed cursor starts at the beginning; the session resets it when
+    // it belongs to another session or predates a clear().
+    struct EntryCursor
+    {
+        uint64_t session_id{0};
+        uint64_t generation{0};
+        std::vector<uint64_t> positions;
+        uint64_t entries_read{0};   // entries returned since the last reset
+    };
+
     class ProfilerSession
     {
     public:
-        explicit ProfilerSession(std::string name);
+        // Events written by one thread. Only the owning thread appends; readers
+        // walk the buffer concurrently.
+        struct ThreadStream
+        {
+            ThreadId owner;
+            uint16_t thread_index;
+            RecordingMode recording;
+            ThreadBuffer<EventRecord, 1024> events;
+            SiteAccumulatorTable accumulators;
+            std::unique_ptr<RingBuffer<EventRecord>> ring;
+            BudgetViolationQueue budget_violations;
+            std::atomic<bool> retired{false};
+
+            ThreadStream(ThreadId owner_id, uint16_t index, const SessionOptions& options);
+
+            void record(EventRecord record)
+            {
+                record.thread_index = thread_index;
+                store(record);
+            }
+
+            void store(const EventRecord& record)
+            {
+                // Aggregate streams keep nothing but the accumulators, so their
+                // memory never grows with the number of events.
+                if (recording == RecordingMode::Aggregate)
+                {
+                    if (record.kind == EventKind::Scope)
+                    {
+                        accumulators.add(record.site_id, record.duration(), record.weight());
+                    }
+                    return;
+                }
+                if (record.kind == EventKind::Scope && (record.flags & EventRecord::flag_folded))
+                {
+                    accumulators.add(record.site_id, record.duration(), record.weight());
+                    return;
+                }
+                if (ring)
+                {
+                    ring->push(record);
+                    return;
+                }
+                events.push(record);
+            }
+
+            template<typename Fn>
+            void for_each(Fn&& fn) const
+            {
+                for_each_since(0, fn);
+            }
+
+            // Position counts every event ever stored in the stream, so it
+            // stays valid across ring wrap-around.
+            template<typename Fn>
+            uint64_t for_each_since(const uint64_t position, Fn&& fn) const
+            {
+                if (ring)
+                {
+                    return ring->for_each_since(position, fn);
+                }
+                return events.for_each_since(static_cast<size_t>(position), fn);
+            }
+
+            [[nodiscard]] size_t size() const noexcept
+            {
+                return events.size() + (ring ? ring->size() : 0);
+            }
+
+            [[nodiscard]] uint64_t dropped() const noexcept
+            {
+                return accumulators.dropped() + (ring ? ring->overwritten() : 0);
+            }
+        };
+
+        explicit ProfilerSession(std::string name, SessionOptions options = {});
         ~ProfilerSession();
 
+        uint64_t id() const noexcept { return id_; }
         const std::string& name() const noexcept { return name_; }
         TimePoint start_time() const noexcept { return start_time_; }
         TimePoint end_time() const noexcept { return end_time_; }
+        const ClockCalibration& calibration() const noexcept { return calibration_; }
+        const SessionOptions& options() const noexcept { return options_; }
+
+        // Per-scope instrumentation cost measured when the session began; all
+        // zero if calibration was skipped.
+        const ProfilerOverhead& overhead() const noexcept { return overhead_; }
+        void set_overhead(const ProfilerOverhead& overhead) noexcept { overhead_ = overhead; }
 
-        bool is_active() const noexcept { return active_; }
-        void set_active(bool active) noexcept { active_ = active; }
+        bool is_active() const noexcept { return active_.load(std::memory_order_acquire); }
+        void set_active(bool active) noexcept { active_.store(active, std::memory_order_release); }
 
         void add_entry(ProfileEntry entry);
         void add_entry_mt(ProfileEntry entry);
+        void add_record(const EventRecord& record);
+
+        // Stores one sampled stack as Sample records. frame_sites is leaf
+        // first; timestamp and period are in Clock ticks.
+        void add_sample(ThreadId thread, int64_t timestamp, int64_t period, const std::vector<uint32_t>& frame_sites);
 
         std::vector<ProfileEntry> get_entries() const;
         std::vector<ProfileEntry> get_entries_mt() const;
 
+        // Entries recorded since the cursor was last advanced. Only new events
+        // are materialized; the cursor is updated in place. Parent indices
+        // count from the cursor's first read, so appending every batch to one
+        // vector keeps them valid; a reset restarts entries_read at 0.
+        std::vector<ProfileEntry> get_entries_since(EntryCursor& cursor) const;
+
+        // Frame boundaries of every series, in time order. The cursor form
+        // returns only the marks recorded since its last read, each batch in
+        // time order; entries_read counts marks.
+        std::vector<FrameMark> get_frame_marks() const;
+        std::vector<FrameMark> get_frame_marks(EntryCursor& cursor) const;
+
+        // Counter values of every series, in time order, optionally since a
+        // cursor as for frame marks.
+        std::vector<CounterSample> get_counter_samples() const;
+        std::vector<CounterSample> get_counter_samples(EntryCursor& cursor) const;
+
+        // Async spans in begin order. Spans without an end are returned with
+        // complete == false; an id may be reused once its span has ended.
+        std::vector<AsyncSpan> get_async_spans() const;
+
+        // Lock waits and holds over the lock threshold, in start order.
+        std::vector<LockEvent> get_lock_events() const;
+
+        // Scopes open right now on any thread, by thread and depth; empty
+        // unless the session tracks open scopes. Times are on the same base
+        // as entries, so a timeline can draw them as bars ending now.
+        std::vector<OpenScope> get_open_scopes() const;
+
+        // Open scopes the watchdog found over SessionOptions::open_scope_budget_ns,
+        // as first seen.
+        std::vector<OpenScope> get_scope_overruns() const;
+        void add_scope_overrun(OpenScope overrun);
+
+        // Call sites whose scopes went over their budget, most violations first.
+        // Violations are queued by the threads that ran the scopes and
+        // collected here or by take_budget_violations().
+        std::vector<BudgetSiteStats> get_budget_stats() const;
+
+        // Violations not yet passed to SessionOptions::on_budget_violation. At
+        // most max_pending_violations wait at a time; further ones are only
+        // counted.
+        static constexpr size_t max_pending_violations = 4096;
+        std::vector<BudgetViolation> take_budget_violations();
+
         std::map<ThreadId, ThreadInfo> get_thread_info() const;
         std::map<std::string, uint64_t> get_memory_usage() const;
+        // Per scope name, the share of wall time spent on CPU in percent.
+        // Only filled for sessions started with SessionOptions::cpu_time.
         std::map<std::string, double> get_cpu_usage() const;
 
+        // Per-call-site statistics merged across threads. In Aggregate mode
+        // this is the only scope data kept; in Full mode it is built from the
+        // recorded events.
+        std::vector<CallSiteStats> get_site_stats() const;
+
+        // The part of get_site_stats() kept in accumulators: every scope in
+        // Aggregate mode, only the folded ones otherwise. Reads no events, so
+        // it costs the same however long the session has been recording.
+        std::vector<CallSiteStats> get_accumulated_stats() const;
+
+        // Call sites whose scopes were timed one in N calls to stay within
+        // SessionOptions::overhead_budget, by site id.
+        std::vector<ThrottledSite> get_throttled_sites() const;
+        void add_throttle(uint32_t site_id, uint32_t sample_shift);
+
+        // Drops every recorded event, along with the overruns, budget
+        // violations and throttled sites reported for them.
         void clear();
         size_t entry_count() const;
 
+        // Events lost to full flight-recorder rings or accumulator tables,
+        // summed over the threads currently recording.
+        uint64_t dropped_events() const;
+
         void end();
 
+        // Stream the calling thread registered with the session identified by
+        // session_id, or nullptr if it has none yet (or it was retired by clear()).
+        static ThreadStream* cached_stream(uint64_t session_id) noexcept;
+
     private:
+        ThreadStream& local_stream();
+
+        ProfileEntry materialize(const EventRecord& record, const std::vector<const CallSite*>& sites,
+                                 const std::vector<ThreadDescriptor>& threads) const;
+
+        // Per-stream state while materializing. Metric records wait in pending
+        // for the scope they precede; open holds the scopes whose parent has
+        // not been read yet, with their nested scope counts; sample_path is
+        // the current sampled stack, by depth.
+        struct StreamReader
+        {
+            std::vector<EventRecord> pending;
+            std::vector<std::pair<size_t, uint32_t>> open;
+            std::vector<size_t> sample_path;
+
+            void reset()
+            {
+                pending.clear();
+                open.clear();
+                sample_path.clear();
+            }
+        };
+
+        // Materializes one record of a stream into entries and links it to
+        // its parent.
+        void append_entry(const EventRecord& record, StreamReader& reader,
+                          const std::vector<const CallSite*>& sites, const std::vector<ThreadDescriptor>& threads,
+                          std::vector<ProfileEntry>& entries) const;
+        int64_t start_ns(const EventRecord& record) const noexcept;
+        int64_t end_ns(const EventRecord& record) const noexcept;
+
+        // Moves queued violations into budget_sites_ and pending_violations_;
+        // called with mutex_ held.
+        void collect_budget_violations() const;
+        BudgetViolation resolve(const BudgetViolationRecord& record, const std::vector<const CallSite*>& sites,
+                                const std::vector<ThreadDescriptor>& threads) const;
+
+        std::vector<CallSiteStats> site_stats(bool with_events) const;
+
+        template<typename Fn>
+        void for_each_record(Fn&& fn) const;
+
+        // Walks the records past the cursor's positions and advances them,
+        // resetting a cursor of another session or generation first.
+        template<typename Fn>
+        void for_each_record_since(EntryCursor& cursor, Fn&& fn) const;
+
+        uint64_t id_;
         std::string name_;
+        SessionOptions options_;
         TimePoint start_time_;
         TimePoint end_time_;
-        bool active_;
+        ClockCalibration calibration_;
+        ProfilerOverhead overhead_;
+        std::atomic<bool> active_;
+
+        std::vector<std::shared_ptr<ThreadStream>> streams_;
+        std::map<uint32_t, uint32_t> max_sample_shifts_;
+        std::vector<OpenScope> overruns_;
 
-        std::vector<ProfileEntry> entries_;
+        // Slowest budget violations per site, slowest first; the sites
+        // themselves count them all, from the baseline taken by clear().
+        mutable std::map<uint32_t, std::vector<BudgetViolationRecord>> budget_sites_;
+        std::map<uint32_t, uint64_t> budget_baseline_;
+        mutable std::vector<BudgetViolationRecord> pending_violations_;
+        uint64_t generation_{0};
         mutable std::mutex mutex_;
     };
 }
-
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+
+namespace runscope::core
+{
+    // Fixed-capacity buffer written by exactly one thread that overwrites its
+    // oldest items once full. Items are stored as atomic words so readers can
+    // copy the buffer while the producer keeps writing; anything the producer
+    // may have overwritten during the copy is discarded (seqlock style).
+    template<typename T>
+    class RingBuffer
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "RingBuffer items are copied word by word");
+        static_assert(sizeof(T) % sizeof(uint64_t) == 0, "RingBuffer items must be a whole number of words");
+
+    public:
+        // Capacity is rounded down to a power of two.
+        explicit RingBuffer(const size_t capacity)
+            : capacity_(std::bit_floor(std::max<size_t>(capacity, 1)))
+            , mask_(capacity_ - 1)
+            , slots_(std::make_unique<Slot[]>(capacity_))
+        {
+
+        }
+
+        RingBuffer(const RingBuffer&) = delete;
+        RingBuffer& operator=(const RingBuffer&) = delete;
+
+        // Producer side, only ever called from the owning thread.
+        void push(const T& value) noexcept
+        {
+            const uint64_t sequence = head_.load(std::memory_order_relaxed);
+
+            // Announce the slot before touching it so readers can tell a copy
+            // raced with this write.
+            claimed_.store(sequence + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            std::array<uint64_t, word_count> words;
+            std::memcpy(words.data(), &value, sizeof(T));
+            Slot& slot = slots_[sequence & mask_];
+            for (size_t i = 0; i < word_count; ++i)
+            {
+                slot.words[i].store(words[i], std::memory_order_relaxed);
+            }
+
+            head_.store(sequence + 1, std::memory_order_release);
+        }
+
+        // Reader side, safe from any thread concurrently with push(). Visits
+        // the retained items oldest first.
+        template<typename Fn>
+        void for_each(Fn&& fn) const
+        {
+            for_each_since(0, fn);
+        }
+
+        // Visits retained items with a sequence number of at least `position`
+        // and returns the position to resume from. Items overwritten before
+        // they could be read are skipped.
+        template<typename Fn>
+        uint64_t for_each_since(const uint64_t position, Fn&& fn) const
+        {
+            const uint64_t head = head_.load(std::memory_order_acquire);
+            const uint64_t first = std::max(position, head > capacity_ ? head - capacity_ : 0);
+            if (first >= head)
+            {
+                return std::max(position, head);
+            }
+
+            std::vector<T> items(static_cast<size_t>(head - first));
+            for (uint64_t sequence = first; sequence < head; ++sequence)
+            {
+                std::array<uint64_t, word_count> words;
+                const Slot& slot = slots_[sequence & mask_];
+                for (size_t i = 0; i < word_count; ++i)
+                {
+                    words[i] = slot.words[i].load(std::memory_order_relaxed);
+                }
+                std::memcpy(&items[sequence - first], words.data(), sizeof(T));
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const uint64_t claimed = claimed_.load(std::memory_order_relaxed);
+            const uint64_t valid_from = claimed > capacity_ ? claimed - capacity_ : 0;
+
+            for (uint64_t sequence = std::max(first, valid_from); sequence < head; ++sequence)
+            {
+                fn(items[sequence - first]);
+            }
+            return head;
+        }
+
+        [[nodiscard]] size_t size() const noexcept
+        {
+            return static_cast<size_t>(std::min<uint64_t>(head_.load(std::memory_order_acquire), capacity_));
+        }
+
+        [[nodiscard]] size_t capacity() const noexcept { return capacity_; }
+
+        // Items lost to wrap-around since the buffer was created.
+        [[nodiscard]] uint64_t overwritten() const noexcept
+        {
+            const uint64_t head = head_.load(std::memory_order_acquire);
+            return head > capacity_ ? head - capacity_ : 0;
+        }
+
+    private:
+        static constexpr size_t word_count = sizeof(T) / sizeof(uint64_t);
+
+        struct Slot
+        {
+            std::array<std::atomic<uint64_t>, word_count> words{};
+        };
+
+        size_t capacity_;
+        size_t mask_;
+        std::unique_ptr<Slot[]> slots_;
+        std::atomic<uint64_t> head_{0};
+        std::atomic<uint64_t> claimed_{0};
+    };
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+
+namespace runscope::core
+{
+    // Time that the scopes of one call site directly inside a budgeted scope
+    // took; throttled sites count each timed call at its sampling weight.
+    struct BudgetChildRecord
+    {
+        uint32_t site_id{0};
+        uint32_t count{0};
+        int64_t total_ticks{0};
+    };
+
+    // Raw report of a scope that ran over its call site's budget, in Clock
+    // ticks. Only built once a scope has already overrun, so it may allocate.
+    struct BudgetViolationRecord
+    {
+        uint32_t site_id{0};
+        uint16_t thread_index{0};
+        int64_t start_ticks{0};
+        int64_t duration_ticks{0};
+        std::vector<BudgetChildRecord> children;
+    };
+
+    // Violations of one thread waiting to be collected by another. The owner
+    // thread pushes without taking a lock; any thread may take them all.
+    class BudgetViolationQueue
+    {
+    public:
+        // Violations past this many uncollected ones are only counted by
+        // their call site.
+        static constexpr uint32_t capacity = 1024;
+
+        BudgetViolationQueue() = default;
+        ~BudgetViolationQueue();
+        BudgetViolationQueue(const BudgetViolationQueue&) = delete;
+        BudgetViolationQueue& operator=(const BudgetViolationQueue&) = delete;
+
+        // False, dropping the record, when the queue is full.
+        bool push(BudgetViolationRecord record);
+
+        // Everything pushed so far, oldest first.
+        [[nodiscard]] std::vector<BudgetViolationRecord> take_all();
+
+    private:
+        struct Node
+        {
+            BudgetViolationRecord record;
+            Node* next{nullptr};
+        };
+
+        std::atomic<Node*> head_{nullptr};
+        std::atomic<uint32_t> size_{0};
+    };
+}
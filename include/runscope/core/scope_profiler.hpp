@@ -1,11 +1,17 @@
 #pragma once
 
 #include "types.hpp"
+#include "category.hpp"
+#include "call_site.hpp"
 #include "profile_entry.hpp"
 #include "profiler_engine.hpp"
 #include "clock.hpp"
+#include "alloc_tracker.hpp"
+#include "runscope/platform/perf_counters.hpp"
+#include <chrono>
 #include <string>
 #include <string_view>
+#include <type_traits>
 
 
 namespace runscope::core
@@ -13,8 +19,30 @@ namespace runscope::core
     class ScopeProfiler
     {
     public:
+        explicit ScopeProfiler(const CallSite& site) noexcept
+        {
+            if (ProfilerEngine::category_enabled(site.categories))
+            {
+                // Throttled sites time a random one in 2^shift calls.
+                const uint32_t shift = site.sample_shift();
+                if (shift == 0 || sampled(shift))
+                {
+                    begin(site.id(), site.categories, shift, &site);
+                }
+            }
+        }
+
+        // For names only known at runtime. Ids are memoized per thread, so only
+        // a name this thread has not used recently is interned.
         explicit ScopeProfiler(std::string_view name, const char* file = "", int line = 0);
-        ~ScopeProfiler();
+
+        ~ScopeProfiler()
+        {
+            if (site_id_ != 0)
+            {
+                end();
+            }
+        }
 
         ScopeProfiler(const ScopeProfiler&) = delete;
         ScopeProfiler& operator=(const ScopeProfiler&) = delete;
@@ -22,25 +50,146 @@ namespace runscope::core
         ScopeProfiler& operator=(ScopeProfiler&&) = delete;
 
     private:
+        // Auto-instrumented functions share the depth and nesting counters.
+        friend class FunctionTracer;
+
+        // Dynamic scopes pass no site and are never throttled, nor are sites
+        // with a budget, which must time every call to check it.
+        void begin(uint32_t site_id, uint32_t categories, uint32_t sample_shift = 0, const CallSite* site = nullptr) noexcept;
+        void end() noexcept;
+
+        static bool sampled(uint32_t shift) noexcept;
+
+        // Every throttle_interval timed scopes, a thread checks whether they
+        // came faster than the session's overhead budget allows. If so, the
+        // site of the scope that closed the window, most likely one of the
+        // hottest, halves its timing rate; if they came at a quarter of the
+        // allowed rate or less, a throttled site doubles it again.
+        static constexpr uint32_t throttle_interval = 1024;
+        static void update_throttle(const CallSite& site) noexcept;
+
         static int& depth_ref();
         static int get_depth();
         static void increment_depth();
         static void decrement_depth();
 
-        std::string name_;
-        std::string file_;
-        int line_;
-        TimePoint start_time_;
-        int depth_;
+        // Bytes allocated by finished child scopes of the innermost open scope.
+        static uint64_t& child_alloc_bytes_ref();
+
+        // Scopes this thread has ended; the difference across a scope's
+        // lifetime is the number of scopes nested in it.
+        static uint32_t& scopes_ended_ref();
+
+        uint32_t site_id_{0};
+        uint32_t sample_shift_{0};
+        int depth_{0};
+        uint32_t ended_at_begin_{0};
+        int64_t start_ticks_{0};
+
+        // Entered in the OpenScopeTable at begin(), so left again at end().
+        bool track_open_{false};
+
+        // A site with a budget; the scope's direct children are tallied in a
+        // per-thread frame while it is open.
+        const CallSite* budget_site_{nullptr};
+        void report_budget_violation(int64_t duration_ticks) noexcept;
+
+        // Allocation counters at begin(); tracked only with the hook installed.
+        bool track_allocations_{false};
+        uint64_t alloc_bytes_start_{0};
+        uint64_t alloc_count_start_{0};
+        uint64_t parent_child_alloc_bytes_{0};
+
+        // Thread CPU time at begin(), or -1 when the session does not measure it.
+        int64_t cpu_start_ns_{-1};
+
+        // perf_event snapshots live in a per-thread slot per depth rather than
+        // in every scope object; scopes nested deeper than this are not counted.
+        static constexpr int max_perf_depth = 64;
+        static platform::PerfSnapshot& perf_slot(int depth);
+        bool track_perf_{false};
+    };
+
+    // Stand-in for scopes whose category was compiled out.
+    class DisabledScopeProfiler
+    {
+    public:
+        explicit constexpr DisabledScopeProfiler(const CallSite&) noexcept {}
     };
+
+    template<uint32_t Categories, uint32_t Compiled = RUNSCOPE_ENABLED_CATEGORIES>
+    using CategoryScopeProfiler = std::conditional_t<(Categories & Compiled) != 0, ScopeProfiler, DisabledScopeProfiler>;
+
+    // Ends the current frame of the series named by the site and starts the next.
+    void mark_frame(const CallSite& site) noexcept;
+
+    void record_counter(const CallSite& site, double value) noexcept;
+
+    // Async spans are keyed by id and may begin, step and end on different threads.
+    void record_async(const CallSite& site, EventKind kind, uint64_t id) noexcept;
 }
 
 
 #define RUNSCOPE_CONCAT_IMPL(x, y) x##y
 #define RUNSCOPE_CONCAT(x, y) RUNSCOPE_CONCAT_IMPL(x, y)
 
+// The name must be a string literal (or otherwise outlive the program), since
+// only a pointer to it is kept in the call-site descriptor.
+#define RUNSCOPE_PROFILE_SCOPE_CAT(cat, name) \
+    static constinit ::runscope::core::CallSite RUNSCOPE_CONCAT(__runscope_site_, __LINE__){name, __FILE__, __LINE__, ::runscope::core::category::cat}; \
+    ::runscope::core::CategoryScopeProfiler<::runscope::core::category::cat> RUNSCOPE_CONCAT(__profiler_, __LINE__)(RUNSCOPE_CONCAT(__runscope_site_, __LINE__))
+
 #define RUNSCOPE_PROFILE_SCOPE(name) \
+    RUNSCOPE_PROFILE_SCOPE_CAT(General, name)
+
+// Scopes that take longer than the budget, a std::chrono duration, are
+// counted as violations of the call site; see ProfilerEngine::get_budget_stats().
+#define RUNSCOPE_PROFILE_SCOPE_BUDGET_CAT(cat, name, budget) \
+    static constinit ::runscope::core::CallSite RUNSCOPE_CONCAT(__runscope_site_, __LINE__){name, __FILE__, __LINE__, ::runscope::core::category::cat, \
+        ::std::chrono::duration_cast<::std::chrono::nanoseconds>(budget).count()}; \
+    ::runscope::core::CategoryScopeProfiler<::runscope::core::category::cat> RUNSCOPE_CONCAT(__profiler_, __LINE__)(RUNSCOPE_CONCAT(__runscope_site_, __LINE__))
+
+#define RUNSCOPE_PROFILE_SCOPE_BUDGET(name, budget) \
+    RUNSCOPE_PROFILE_SCOPE_BUDGET_CAT(General, name, budget)
+
+#define RUNSCOPE_PROFILE_SCOPE_DYNAMIC(name) \
     ::runscope::core::ScopeProfiler RUNSCOPE_CONCAT(__profiler_, __LINE__)(name, __FILE__, __LINE__)
 
 #define RUNSCOPE_PROFILE_FUNCTION() \
     RUNSCOPE_PROFILE_SCOPE(__FUNCTION__)
+
+#define RUNSCOPE_PROFILE_FUNCTION_CAT(cat) \
+    RUNSCOPE_PROFILE_SCOPE_CAT(cat, __FUNCTION__)
+
+#define RUNSCOPE_FRAME_MARK(name) \
+    do \
+    { \
+        static constinit ::runscope::core::CallSite RUNSCOPE_CONCAT(__runscope_frame_, __LINE__){name, __FILE__, __LINE__}; \
+        ::runscope::core::mark_frame(RUNSCOPE_CONCAT(__runscope_frame_, __LINE__)); \
+    } while (false)
+
+#define RUNSCOPE_ASYNC_EVENT(kind, name, id) \
+    do \
+    { \
+        static constinit ::runscope::core::CallSite RUNSCOPE_CONCAT(__runscope_async_, __LINE__){name, __FILE__, __LINE__}; \
+        if (::runscope::core::ProfilerEngine::category_enabled(RUNSCOPE_CONCAT(__runscope_async_, __LINE__).categories)) \
+        { \
+            ::runscope::core::record_async(RUNSCOPE_CONCAT(__runscope_async_, __LINE__), ::runscope::core::EventKind::kind, static_cast<uint64_t>(id)); \
+        } \
+    } while (false)
+
+// Begin a span when work is created (e.g. enqueued), step when a new phase
+// starts (e.g. a worker picks it up) and end when it finishes.
+#define RUNSCOPE_ASYNC_BEGIN(name, id) RUNSCOPE_ASYNC_EVENT(AsyncBegin, name, id)
+#define RUNSCOPE_ASYNC_STEP(name, id) RUNSCOPE_ASYNC_EVENT(AsyncStep, name, id)
+#define RUNSCOPE_ASYNC_END(name, id) RUNSCOPE_ASYNC_EVENT(AsyncEnd, name, id)
+
+#define RUNSCOPE_COUNTER(name, value) \
+    do \
+    { \
+        static constinit ::runscope::core::CallSite RUNSCOPE_CONCAT(__runscope_counter_, __LINE__){name, __FILE__, __LINE__}; \
+        if (::runscope::core::ProfilerEngine::category_enabled(RUNSCOPE_CONCAT(__runscope_counter_, __LINE__).categories)) \
+        { \
+            ::runscope::core::record_counter(RUNSCOPE_CONCAT(__runscope_counter_, __LINE__), static_cast<double>(value)); \
+        } \
+    } while (false)
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <algorithm>
+#include "chunk_pool.hpp"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+
+namespace runscope::core
+{
+    // Append-only buffer written by exactly one thread. Items live in fixed-size
+    // chunks that are never moved, so any other thread can walk everything that
+    // has been published so far without ever blocking the producer. Chunks come
+    // from a shared ChunkPool and go back to it when the buffer is destroyed.
+    template<typename T, size_t ChunkCapacity = 512>
+    class ThreadBuffer
+    {
+    public:
+        ThreadBuffer()
+            : head_(allocate_chunk())
+            , tail_(head_)
+        {
+
+        }
+
+        ~ThreadBuffer()
+        {
+            Chunk* chunk = head_;
+            while (chunk)
+            {
+                Chunk* next = chunk->next.load(std::memory_order_relaxed);
+                release_chunk(chunk);
+                chunk = next;
+            }
+        }
+
+        ThreadBuffer(const ThreadBuffer&) = delete;
+        ThreadBuffer& operator=(const ThreadBuffer&) = delete;
+
+        // Producer side, only ever called from the owning thread.
+        void push(T value)
+        {
+            if (write_index_ == ChunkCapacity)
+            {
+                Chunk* chunk = allocate_chunk();
+                tail_->next.store(chunk, std::memory_order_release);
+                tail_ = chunk;
+                write_index_ = 0;
+            }
+
+            tail_->items[write_index_] = std::move(value);
+            ++write_index_;
+            tail_->size.store(write_index_, std::memory_order_release);
+            size_.store(size_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        // Reader side, safe from any thread concurrently with push().
+        template<typename Fn>
+        void for_each(Fn&& fn) const
+        {
+            for_each_since(0, fn);
+        }
+
+        // Visits the items published after the first `position` ones and
+        // returns the position to resume from. Sealed chunks before the
+        // position are skipped without touching their items.
+        template<typename Fn>
+        size_t for_each_since(const size_t position, Fn&& fn) const
+        {
+            const Chunk* chunk = head_;
+            size_t chunk_start = 0;
+            while (chunk && chunk_start + ChunkCapacity <= position)
+            {
+                const Chunk* next = chunk->next.load(std::memory_order_acquire);
+                if (!next)
+                {
+                    break;
+                }
+                chunk = next;
+                chunk_start += ChunkCapacity;
+            }
+
+            size_t end = position;
+            while (chunk)
+            {
+                const size_t count = chunk->size.load(std::memory_order_acquire);
+                for (size_t i = position > chunk_start ? position - chunk_start : 0; i < count; ++i)
+                {
+                    fn(chunk->items[i]);
+                }
+                end = std::max(end, chunk_start + count);
+                chunk = chunk->next.load(std::memory_order_acquire);
+                chunk_start += ChunkCapacity;
+            }
+            return end;
+        }
+
+        [[nodiscard]] size_t size() const noexcept
+        {
+            return size_.load(std::memory_order_acquire);
+        }
+
+    private:
+        struct Chunk
+        {
+            std::array<T, ChunkCapacity> items;
+            std::atomic<size_t> size{0};
+            std::atomic<Chunk*> next{nullptr};
+        };
+
+        using Pool = ChunkPool<sizeof(Chunk), alignof(Chunk)>;
+
+        // Default-initialized so recycled chunks are not cleared item by item;
+        // only slots below the published size are ever read.
+        static Chunk* allocate_chunk()
+        {
+            return new (Pool::getInstance().acquire()) Chunk;
+        }
+
+        static void release_chunk(Chunk* chunk) noexcept
+        {
+            chunk->~Chunk();
+            Pool::getInstance().release(chunk);
+        }
+
+        Chunk* head_;
+        Chunk* tail_;
+        size_t write_index_{0};
+        std::atomic<size_t> size_{0};
+    };
+}
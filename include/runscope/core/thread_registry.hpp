@@ -0,0 +1,81 @@
+#pragma once
+
+#include "types.hpp"
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+
+namespace runscope::core
+{
+    struct ThreadDescriptor
+    {
+        ThreadId id;
+        uint16_t index{0};
+        uint64_t os_id{0};      // kernel thread id, 0 if the thread never registered itself
+        std::string name;
+
+        // Numeric id for trace viewers: the OS thread id when known.
+        [[nodiscard]] uint64_t trace_id() const noexcept
+        {
+            return os_id != 0 ? os_id : index + 1u;
+        }
+    };
+
+    // Process-wide table of profiled threads. Each thread gets a dense 16-bit
+    // index the first time it records, which events carry instead of a
+    // std::thread::id; names and OS ids are only looked up when exporting.
+    // Indices are never reused, since events recorded by an exited thread
+    // keep referring to its index; threads past the 16-bit range share the
+    // last one, named "other threads". The id lookup holds one entry per
+    // distinct std::thread::id, which the platform recycles.
+    class ThreadRegistry
+    {
+    public:
+        static constexpr uint16_t overflow_index = UINT16_MAX;
+
+        static ThreadRegistry& getInstance();
+
+        // Index of the calling thread, registering it on first use with its
+        // OS id and the name given by pthread_getname_np.
+        static uint16_t current_index();
+
+        // Names the calling thread in profiles and, where supported, for the OS
+        // (truncated to 15 characters on Linux).
+        static void set_current_thread_name(std::string_view name);
+
+        // Index for a thread known only by its id, e.g. an entry recorded on
+        // another thread's behalf. Unknown ids are registered without OS data.
+        uint16_t index_of(const ThreadId& id);
+
+        // Descriptor of a known thread. Never registers, so exporting or
+        // analyzing entries leaves the table as recording left it.
+        [[nodiscard]] std::optional<ThreadDescriptor> find(const ThreadId& id) const;
+
+        // Index-addressed copy for bulk lookups off the hot path.
+        [[nodiscard]] std::vector<ThreadDescriptor> snapshot() const;
+
+        [[nodiscard]] size_t size() const;
+
+    private:
+        ThreadRegistry() = default;
+        ~ThreadRegistry() = default;
+        ThreadRegistry(const ThreadRegistry&) = delete;
+        ThreadRegistry& operator=(const ThreadRegistry&) = delete;
+
+        uint16_t register_current();
+        uint16_t add(const ThreadId& id, uint64_t os_id, std::string name);
+
+        std::vector<ThreadDescriptor> threads_;
+        std::unordered_map<ThreadId, uint16_t> by_id_;
+        mutable std::mutex mutex_;
+    };
+}
+
+
+#define RUNSCOPE_SET_THREAD_NAME(name) \
+    ::runscope::core::ThreadRegistry::set_current_thread_name(name)
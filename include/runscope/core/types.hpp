@@ -20,6 +20,15 @@ namespace runscope::core
         Both
     };
 
+    // How a session stores instrumented scopes.
+    enum class RecordingMode
+    {
+        Full,           // every scope is kept as an event record
+        Aggregate,      // per-call-site counts, totals, min/max and latency histogram only;
+                        // samples, frames, counters, async spans and lock events are dropped
+        FlightRecorder  // most recent events per thread in a fixed-size ring
+    };
+
     enum class AttachmentStatus
     {
         Detached,
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "runscope/core/profile_entry.hpp"
+#include "runscope/core/profiler_session.hpp"
+#include <ostream>
 #include <string>
 #include <vector>
 
@@ -15,9 +17,30 @@ namespace runscope::export_format
 
         static bool export_to_chrome_trace(const std::vector<core::ProfileEntry>& entries, const std::string& filename);
 
+        // Counter samples become Chrome "C" events next to the scopes.
+        static bool export_to_chrome_trace(const std::vector<core::ProfileEntry>& entries,
+                                           const std::vector<core::CounterSample>& counters,
+                                           const std::string& filename);
+
+        // Everything the session holds: scopes, counters and async spans with
+        // their flow links. With subtract_overhead, scope timings have the
+        // session's calibrated profiler overhead taken out.
+        static bool export_to_chrome_trace(const core::ProfilerSession& session, const std::string& filename,
+                                           bool subtract_overhead = false);
+
+        // Writes the session's current contents as a Chrome trace while it keeps
+        // recording. Intended for flight-recorder sessions; the drop counter and
+        // the calibrated overhead are stored in the trace's otherData.
+        static bool export_snapshot(const core::ProfilerSession& session, const std::string& filename,
+                                    bool subtract_overhead = false);
+
         static bool import_from_json(const std::string& filename, std::vector<core::ProfileEntry>& entries);
 
     private:
+        static void write_chrome_events(std::ostream& out, const std::vector<core::ProfileEntry>& entries,
+                                        const std::vector<core::CounterSample>& counters = {},
+                                        const std::vector<core::AsyncSpan>& spans = {});
+
         static std::string thread_id_to_string(const core::ThreadId& id);
 
         static std::string extract_string(const std::string &src, const std::string &key);
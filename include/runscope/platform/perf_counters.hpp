@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+
+namespace runscope::platform
+{
+    enum class PerfCounter : uint8_t
+    {
+        // Software group: available wherever perf_event_open is allowed.
+        TaskClock,
+        PageFaults,
+        ContextSwitches,
+        // Hardware group: needs a PMU, so usually missing in VMs and containers.
+        Cycles,
+        Instructions,
+        CacheMisses,
+        Count
+    };
+
+    // Running counter values of the calling thread at one point in time.
+    struct PerfSnapshot
+    {
+        std::array<uint64_t, static_cast<size_t>(PerfCounter::Count)> values{};
+        std::array<uint64_t, 2> time_enabled{};    // per group: software, hardware
+        std::array<uint64_t, 2> time_running{};
+        bool software{false};
+        bool hardware{false};
+
+        [[nodiscard]] uint64_t operator[](const PerfCounter counter) const noexcept
+        {
+            return values[static_cast<size_t>(counter)];
+        }
+    };
+
+    // Counts accumulated between two snapshots of the same thread, scaled up
+    // when the kernel had to multiplex a group off the PMU for part of the time.
+    struct PerfDelta
+    {
+        std::array<uint64_t, static_cast<size_t>(PerfCounter::Count)> values{};
+        bool software{false};
+        bool hardware{false};
+
+        [[nodiscard]] uint64_t operator[](const PerfCounter counter) const noexcept
+        {
+            return values[static_cast<size_t>(counter)];
+        }
+    };
+
+    // Per-thread perf_event groups, opened on a thread's first read and closed
+    // when it exits. Each group is read with a single read() of PERF_FORMAT_GROUP.
+    // If the hardware counters cannot be opened only the software group is
+    // read, and without perf_event_open at all (or off Linux) reads fail.
+    class PerfCounters
+    {
+    public:
+        [[nodiscard]] static bool supported() noexcept;
+
+        // False when no group could be opened for the calling thread.
+        static bool read(PerfSnapshot& snapshot) noexcept;
+
+        [[nodiscard]] static PerfDelta delta(const PerfSnapshot& begin, const PerfSnapshot& end) noexcept;
+    };
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "runscope/core/types.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace runscope::platform
+{
+    // One captured call stack, leaf frame first.
+    struct StackSample
+    {
+        core::ThreadId thread;
+        int64_t timestamp{0};   // core::Clock::ticks() at capture
+        std::vector<uintptr_t> frames;
+    };
+
+    struct SymbolInfo
+    {
+        std::string name;
+        std::string module;
+    };
+
+    // In-process sampler for the profiler's own binary. Each registered thread
+    // gets a CPU-time timer that raises SIGPROF; the handler walks the frame
+    // pointer chain within the thread's stack bounds and stores the addresses
+    // in a per-thread lock-free ring. Symbolization happens later, in drain()
+    // callers, never in the handler. Linux only; elsewhere start() fails.
+    class SignalSampler
+    {
+    public:
+        static constexpr size_t max_frames = 64;
+
+        static SignalSampler& getInstance();
+
+        [[nodiscard]] static bool supported() noexcept;
+
+        bool start(uint32_t frequency_hz);
+        void stop();
+        [[nodiscard]] bool is_running() const noexcept { return running_.load(std::memory_order_acquire); }
+        [[nodiscard]] uint32_t frequency() const noexcept { return frequency_hz_.load(std::memory_order_relaxed); }
+
+        // Arms a timer for the calling thread. Threads are unregistered when
+        // they exit or when the sampler stops.
+        bool register_current_thread();
+        void unregister_current_thread();
+
+        // Moves captured samples into out and returns how many were added.
+        size_t drain(std::vector<StackSample>& out);
+
+        // Cached dladdr lookup; symbols need -rdynamic to resolve in executables.
+        SymbolInfo symbolize(uintptr_t address);
+
+        // Samples lost because a thread's ring was full.
+        [[nodiscard]] uint64_t dropped() const;
+
+        struct ThreadSlot;
+
+    private:
+        SignalSampler() = default;
+        ~SignalSampler() = default;
+        SignalSampler(const SignalSampler&) = delete;
+        SignalSampler& operator=(const SignalSampler&) = delete;
+
+        bool arm(ThreadSlot& slot) const;
+
+        std::atomic<bool> running_{false};
+        std::atomic<uint32_t> frequency_hz_{0};
+        std::vector<std::shared_ptr<ThreadSlot>> slots_;
+        std::atomic<uint64_t> retired_dropped_{0};
+        std::unordered_map<uintptr_t, SymbolInfo> symbols_;
+        mutable std::mutex mutex_;
+        std::mutex symbol_mutex_;
+    };
+}
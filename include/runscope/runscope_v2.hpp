@@ -6,8 +6,18 @@
 #include "core/profiler_session.hpp"
 #include "core/profiler_engine.hpp"
 #include "core/scope_profiler.hpp"
+#include "core/alloc_tracker.hpp"
+#include "core/profiled_mutex.hpp"
+#include "core/thread_registry.hpp"
+#include "core/function_tracer.hpp"
+#include "core/open_scopes.hpp"
+#include "core/scope_budget.hpp"
 #include "platform/process_info.hpp"
 #include "platform/process_attacher.hpp"
 #include "analysis/statistics.hpp"
+#include "analysis/frame_analyzer.hpp"
+#include "analysis/lock_analyzer.hpp"
+#include "analysis/call_tree.hpp"
+#include "analysis/overhead.hpp"
 #include "export/exporter.hpp"
 #include "ui/profiler_ui.hpp"
@@ -2,6 +2,7 @@
 
 #include "runscope/core/profile_entry.hpp"
 #include "runscope/analysis/statistics.hpp"
+#include "runscope/analysis/call_tree.hpp"
 #include "runscope/platform/process_info.hpp"
 #include "runscope/platform/process_attacher.hpp"
 #include <vector>
@@ -50,9 +51,11 @@ namespace runscope::ui
 
     private:
         void render_timeline_entry(const core::ProfileEntry& entry, float row_height, int64_t time_range_ns, int64_t min_time_ns, ImVec2 canvas_pos, ImVec2 canvas_size, float base_y_offset, size_t entry_idx) const;
+        float render_counter_tracks(int64_t time_range_ns, int64_t min_time_ns, ImVec2 canvas_pos, ImVec2 canvas_size, float base_y_offset) const;
         void render_flamegraph_node(const core::ProfileEntry& entry, float x, float y, float width, float height, size_t entry_idx) const;
 
-        static void render_call_tree_node(const core::ProfileEntry& entry, int depth);
+        static void render_call_tree_node(const std::vector<core::ProfileEntry>& entries,
+                                          const analysis::CallTree& tree, size_t index);
         void update_statistics(const std::vector<core::ProfileEntry>& entries) const;
 
         struct Impl;
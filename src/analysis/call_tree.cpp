@@ -0,0 +1,32 @@
+#include "runscope/analysis/call_tree.hpp"
+
+using namespace runscope::analysis;
+
+void CallTree::build(const std::vector<core::ProfileEntry>& entries)
+{
+    clear();
+    children_.resize(entries.size());
+    self_ns_.resize(entries.size());
+
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        const auto& entry = entries[i];
+        self_ns_[i] += entry.duration_ns();
+
+        const int64_t parent = entry.parent;
+        if (parent < 0 || static_cast<size_t>(parent) >= entries.size() || static_cast<size_t>(parent) == i)
+        {
+            roots_.push_back(i);
+            continue;
+        }
+        children_[static_cast<size_t>(parent)].push_back(i);
+        self_ns_[static_cast<size_t>(parent)] -= entry.duration_ns();
+    }
+}
+
+void CallTree::clear()
+{
+    roots_.clear();
+    children_.clear();
+    self_ns_.clear();
+}
@@ -0,0 +1,150 @@
+#include "runscope/analysis/frame_analyzer.hpp"
+#include <algorithm>
+#include <cmath>
+
+using namespace runscope::analysis;
+
+void FrameAnalyzer::analyze(const std::vector<core::FrameMark>& marks,
+                            const std::vector<core::ProfileEntry>& entries,
+                            const std::string& frame_name)
+{
+    clear();
+
+    frame_name_ = frame_name.empty() && !marks.empty() ? marks.front().name : frame_name;
+
+    std::vector<int64_t> boundaries;
+    for (const auto& mark : marks)
+    {
+        if (mark.name == frame_name_)
+        {
+            boundaries.push_back(mark.time_ns);
+        }
+    }
+    std::ranges::sort(boundaries);
+
+    for (size_t i = 1; i < boundaries.size(); ++i)
+    {
+        FrameInfo frame;
+        frame.index = i - 1;
+        frame.start_ns = boundaries[i - 1];
+        frame.end_ns = boundaries[i];
+        frames_.push_back(frame);
+        sorted_durations_.push_back(frame.duration_ns());
+    }
+    std::ranges::sort(sorted_durations_);
+
+    entries_ = entries;
+    std::ranges::stable_sort(entries_, {}, &core::ProfileEntry::start_ns);
+}
+
+FrameInfo FrameAnalyzer::get_frame(const size_t index) const
+{
+    if (index < frames_.size())
+    {
+        return frames_[index];
+    }
+    return FrameInfo();
+}
+
+FrameStats FrameAnalyzer::get_stats() const
+{
+    FrameStats stats;
+    if (sorted_durations_.empty())
+    {
+        return stats;
+    }
+
+    stats.frame_count = sorted_durations_.size();
+    for (const int64_t duration : sorted_durations_)
+    {
+        stats.total_time_ns += duration;
+    }
+    stats.min_time_ns = sorted_durations_.front();
+    stats.max_time_ns = sorted_durations_.back();
+    stats.avg_time_ns = static_cast<double>(stats.total_time_ns) / stats.frame_count;
+    stats.p50_time_ns = percentile_ns(50.0);
+    stats.p90_time_ns = percentile_ns(90.0);
+    stats.p99_time_ns = percentile_ns(99.0);
+    stats.p999_time_ns = percentile_ns(99.9);
+    return stats;
+}
+
+int64_t FrameAnalyzer::percentile_ns(const double percentile) const
+{
+    if (sorted_durations_.empty())
+    {
+        return 0;
+    }
+
+    // Nearest-rank: the smallest duration at or above the requested share.
+    const double clamped = std::clamp(percentile, 0.0, 100.0);
+    const auto rank = static_cast<size_t>(std::ceil(clamped / 100.0 * sorted_durations_.size()));
+    return sorted_durations_[std::max<size_t>(rank, 1) - 1];
+}
+
+FrameHistogram FrameAnalyzer::get_histogram(const size_t bucket_count) const
+{
+    FrameHistogram histogram;
+    if (sorted_durations_.empty() || bucket_count == 0)
+    {
+        return histogram;
+    }
+
+    histogram.min_ns = sorted_durations_.front();
+    const int64_t range = sorted_durations_.back() - histogram.min_ns;
+    histogram.bucket_width_ns = std::max<int64_t>(1, (range + static_cast<int64_t>(bucket_count)) / static_cast<int64_t>(bucket_count));
+    histogram.counts.assign(bucket_count, 0);
+
+    for (const int64_t duration : sorted_durations_)
+    {
+        const auto bucket = static_cast<size_t>((duration - histogram.min_ns) / histogram.bucket_width_ns);
+        ++histogram.counts[std::min(bucket, bucket_count - 1)];
+    }
+    return histogram;
+}
+
+std::vector<FrameInfo> FrameAnalyzer::get_slowest_frames(const size_t count) const
+{
+    std::vector<FrameInfo> slowest = frames_;
+    const size_t kept = std::min(count, slowest.size());
+    std::ranges::partial_sort(slowest, slowest.begin() + static_cast<std::ptrdiff_t>(kept),
+                              [](const FrameInfo& a, const FrameInfo& b)
+    {
+        return a.duration_ns() > b.duration_ns();
+    });
+    slowest.resize(kept);
+    return slowest;
+}
+
+std::vector<runscope::core::ProfileEntry> FrameAnalyzer::get_entries_in_frame(const size_t index) const
+{
+    if (index >= frames_.size())
+    {
+        return {};
+    }
+
+    const FrameInfo& frame = frames_[index];
+    const auto first = std::ranges::lower_bound(entries_, frame.start_ns, {}, &core::ProfileEntry::start_ns);
+    const auto last = std::ranges::lower_bound(first, entries_.end(), frame.end_ns, {}, &core::ProfileEntry::start_ns);
+    return {first, last};
+}
+
+size_t FrameAnalyzer::frame_at(const int64_t time_ns) const
+{
+    const auto it = std::ranges::upper_bound(frames_, time_ns, {}, &FrameInfo::start_ns);
+    if (it == frames_.begin())
+    {
+        return frames_.size();
+    }
+
+    const auto frame = std::prev(it);
+    return time_ns < frame->end_ns ? frame->index : frames_.size();
+}
+
+void FrameAnalyzer::clear()
+{
+    frame_name_.clear();
+    frames_.clear();
+    sorted_durations_.clear();
+    entries_.clear();
+}
@@ -0,0 +1,151 @@
+#include "runscope/analysis/lock_analyzer.hpp"
+#include <algorithm>
+#include <map>
+#include <ranges>
+#include <tuple>
+
+using namespace runscope::analysis;
+
+namespace
+{
+    using EntryList = std::vector<const runscope::core::ProfileEntry*>;
+
+    // A lock site: the same name at another file or line is another lock.
+    using SiteKey = std::tuple<std::string, std::string, int>;
+
+    // For each wait, in the order given, the innermost entry of the thread
+    // that encloses it. Entries and waits are both in start order, so one
+    // pass keeps the chain of open entries on a stack: an entry pops the ones
+    // that ended before it, and a wait looks at the stack from the top.
+    std::vector<const runscope::core::ProfileEntry*> enclosing_scopes(EntryList& entries,
+                                                                        const std::vector<const runscope::core::LockEvent*>& waits)
+    {
+        // Parents before the children that start with them.
+        std::ranges::sort(entries, [](const auto* a, const auto* b)
+        {
+            return a->start_ns != b->start_ns ? a->start_ns < b->start_ns : a->end_ns > b->end_ns;
+        });
+
+        std::vector<const runscope::core::ProfileEntry*> scopes;
+        scopes.reserve(waits.size());
+        EntryList open;
+        auto next = entries.begin();
+        for (const auto* wait : waits)
+        {
+            for (; next != entries.end() && (*next)->start_ns <= wait->start_ns; ++next)
+            {
+                while (!open.empty() && open.back()->end_ns < (*next)->end_ns)
+                {
+                    open.pop_back();
+                }
+                open.push_back(*next);
+            }
+            while (!open.empty() && open.back()->end_ns < wait->start_ns)
+            {
+                open.pop_back();
+            }
+
+            const runscope::core::ProfileEntry* scope = nullptr;
+            for (auto it = open.rbegin(); it != open.rend(); ++it)
+            {
+                if ((*it)->end_ns >= wait->end_ns)
+                {
+                    scope = *it;
+                    break;
+                }
+            }
+            scopes.push_back(scope);
+        }
+        return scopes;
+    }
+}
+
+void LockAnalyzer::analyze(const std::vector<core::LockEvent>& events,
+                           const std::vector<core::ProfileEntry>& entries)
+{
+    clear();
+
+    std::map<core::ThreadId, EntryList> by_thread;
+    for (const auto& entry : entries)
+    {
+        by_thread[entry.thread_id].push_back(&entry);
+    }
+
+    std::map<SiteKey, LockStats> by_site;
+    std::map<core::ThreadId, std::vector<const core::LockEvent*>> waits_by_thread;
+    for (const auto& event : events)
+    {
+        auto& stats = by_site[{event.name, event.file, event.line}];
+        stats.name = event.name;
+        stats.file = event.file;
+        stats.line = event.line;
+
+        const int64_t duration = event.duration_ns();
+        if (event.kind == core::LockEvent::Kind::Hold)
+        {
+            stats.hold_count++;
+            stats.total_hold_ns += duration;
+            stats.max_hold_ns = std::max(stats.max_hold_ns, duration);
+            continue;
+        }
+
+        stats.wait_count++;
+        stats.total_wait_ns += duration;
+        stats.max_wait_ns = std::max(stats.max_wait_ns, duration);
+        total_wait_ns_ += duration;
+
+        if (by_thread.contains(event.thread_id))
+        {
+            waits_by_thread[event.thread_id].push_back(&event);
+        }
+    }
+
+    std::map<SiteKey, std::map<std::string, BlockedScope>> blocked;
+    for (auto& [thread, waits] : waits_by_thread)
+    {
+        std::ranges::stable_sort(waits, {}, &core::LockEvent::start_ns);
+        const auto scopes = enclosing_scopes(by_thread[thread], waits);
+        for (size_t i = 0; i < waits.size(); ++i)
+        {
+            if (const auto* scope = scopes[i])
+            {
+                auto& scope_stats = blocked[{waits[i]->name, waits[i]->file, waits[i]->line}][scope->name];
+                scope_stats.name = scope->name;
+                scope_stats.wait_count++;
+                scope_stats.total_wait_ns += waits[i]->duration_ns();
+            }
+        }
+    }
+
+    for (auto& [site, stats] : by_site)
+    {
+        for (auto& scope : blocked[site] | std::views::values)
+        {
+            stats.blocked_scopes.push_back(std::move(scope));
+        }
+        std::ranges::stable_sort(stats.blocked_scopes, std::ranges::greater{}, &BlockedScope::total_wait_ns);
+        locks_.push_back(std::move(stats));
+    }
+    std::ranges::stable_sort(locks_, std::ranges::greater{}, &LockStats::total_wait_ns);
+}
+
+std::vector<LockStats> LockAnalyzer::get_top_locks(const size_t count) const
+{
+    return {locks_.begin(), locks_.begin() + static_cast<std::ptrdiff_t>(std::min(count, locks_.size()))};
+}
+
+LockStats LockAnalyzer::get_stats_for_lock(const std::string& name) const
+{
+    const auto it = std::ranges::find(locks_, name, &LockStats::name);
+    if (it != locks_.end())
+    {
+        return *it;
+    }
+    return LockStats();
+}
+
+void LockAnalyzer::clear()
+{
+    locks_.clear();
+    total_wait_ns_ = 0;
+}
@@ -0,0 +1,87 @@
+#include "runscope/analysis/overhead.hpp"
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <ranges>
+
+using namespace runscope::analysis;
+
+int64_t OverheadShift::shifted(const core::ThreadId& thread, const int64_t time_ns) const
+{
+    const auto it = closes.find(thread);
+    if (it == closes.end())
+    {
+        return time_ns;
+    }
+    const auto& thread_closes = it->second;
+    const auto next = std::ranges::upper_bound(thread_closes, time_ns, {}, &std::pair<int64_t, int64_t>::first);
+    return next == thread_closes.begin() ? time_ns : time_ns - std::prev(next)->second;
+}
+
+std::vector<runscope::core::ProfileEntry> runscope::analysis::compensate_overhead(std::vector<core::ProfileEntry> entries,
+                                                                                  const core::ProfilerOverhead& overhead,
+                                                                                  OverheadShift* shift_out)
+{
+    std::map<core::ThreadId, std::vector<size_t>> by_thread;
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        if (entries[i].source == core::EntrySource::Scope)
+        {
+            by_thread[entries[i].thread_id].push_back(i);
+        }
+    }
+
+    OverheadShift shifts;
+    for (auto& [thread, order] : by_thread)
+    {
+        std::ranges::stable_sort(order, [&entries](const size_t a, const size_t b)
+        {
+            return entries[a].start_ns != entries[b].start_ns ? entries[a].start_ns < entries[b].start_ns
+                                                              : entries[a].depth < entries[b].depth;
+        });
+
+        // Cost of every scope closed so far; scopes close innermost first.
+        int64_t shift = 0;
+        std::vector<size_t> open;
+        auto& closes = shifts.closes[thread];
+        auto close = [&entries, &overhead, &shift, &closes](const size_t index)
+        {
+            auto& entry = entries[index];
+            closes.emplace_back(entry.end_ns, shift + overhead.total_cost(entry.perf));
+            const int64_t end = entry.end_ns - shift - overhead.self_cost(entry.perf);
+            shift += overhead.total_cost(entry.perf);
+            entry.end_ns = std::max(end, entry.start_ns);
+        };
+
+        for (const size_t index : order)
+        {
+            while (!open.empty() && entries[open.back()].end_ns <= entries[index].start_ns)
+            {
+                close(open.back());
+                open.pop_back();
+            }
+            entries[index].start_ns -= shift;
+            open.push_back(index);
+        }
+        while (!open.empty())
+        {
+            close(open.back());
+            open.pop_back();
+        }
+    }
+
+    for (auto& entry : entries)
+    {
+        if (entry.source != core::EntrySource::Scope)
+        {
+            entry.start_ns = shifts.shifted(entry.thread_id, entry.start_ns);
+            entry.end_ns = std::max(shifts.shifted(entry.thread_id, entry.end_ns), entry.start_ns);
+        }
+    }
+
+    if (shift_out)
+    {
+        *shift_out = std::move(shifts);
+    }
+    return entries;
+}
@@ -8,18 +8,47 @@ void StatisticsAnalyzer::analyze(const std::vector<core::ProfileEntry>& entries)
 {
     function_stats_.clear();
     total_time_ns_ = 0;
-    
+
+    // Time spent in each entry's direct children, from the parent links.
+    std::vector<int64_t> child_ns(entries.size(), 0);
     for (const auto& entry : entries)
     {
+        if (entry.parent >= 0 && static_cast<size_t>(entry.parent) < entries.size())
+        {
+            child_ns[static_cast<size_t>(entry.parent)] += entry.duration_ns() * entry.sample_weight;
+        }
+    }
+    
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        const auto& entry = entries[i];
         auto& stats = function_stats_[entry.name];
         stats.name = entry.name;
-        stats.call_count++;
+        // Entries of throttled call sites stand for several calls each.
+        const int64_t weight = entry.sample_weight;
+        stats.call_count += static_cast<size_t>(weight);
         
         int64_t duration = entry.duration_ns();
-        stats.total_time_ns += duration;
         stats.min_time_ns = std::min(stats.min_time_ns, duration);
         stats.max_time_ns = std::max(stats.max_time_ns, duration);
+        stats.self_time_ns += static_cast<double>((duration - child_ns[i]) * weight);
+        duration *= weight;
+        stats.total_time_ns += duration;
         stats.inclusive_time_ns += duration;
+
+        if (entry.perf.software)
+        {
+            stats.software_call_count++;
+            stats.page_faults += entry.perf.page_faults;
+            stats.context_switches += entry.perf.context_switches;
+        }
+        if (entry.perf.hardware)
+        {
+            stats.hardware_call_count++;
+            stats.cycles += entry.perf.cycles;
+            stats.instructions += entry.perf.instructions;
+            stats.cache_misses += entry.perf.cache_misses;
+        }
         
         total_time_ns_ += duration;
     }
@@ -30,7 +59,6 @@ void StatisticsAnalyzer::analyze(const std::vector<core::ProfileEntry>& entries)
         {
             stats.avg_time_ns = static_cast<double>(stats.total_time_ns) / stats.call_count;
         }
-        stats.self_time_ns = stats.total_time_ns;
     }
 }
 
@@ -0,0 +1,262 @@
+// Linked into an application (as the runscope_alloc_hook object library) to
+// count its heap allocations per thread. Sizes are the allocator's usable
+// size, so an allocation and its free always cancel out.
+
+#include "runscope/core/alloc_tracker.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <new>
+
+#if defined(__APPLE__)
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
+
+using namespace runscope::core;
+
+namespace
+{
+    size_t usable_size(void* pointer) noexcept
+    {
+#if defined(__APPLE__)
+        return malloc_size(pointer);
+#else
+        return malloc_usable_size(pointer);
+#endif
+    }
+
+    const bool installed = []
+    {
+        AllocTracker::set_installed(true);
+        return true;
+    }();
+}
+
+#ifdef RUNSCOPE_ALLOC_HOOK_MALLOC
+
+// glibc only: the default operator new calls malloc, so everything is counted
+// here once, including allocations made by C code.
+extern "C"
+{
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t count, size_t size);
+    void* __libc_realloc(void* pointer, size_t size);
+    void* __libc_memalign(size_t alignment, size_t size);
+    void* __libc_valloc(size_t size);
+    void* __libc_pvalloc(size_t size);
+    void __libc_free(void* pointer);
+}
+
+namespace
+{
+    void* counted(void* pointer) noexcept
+    {
+        if (pointer)
+        {
+            AllocTracker::on_allocate(usable_size(pointer));
+        }
+        return pointer;
+    }
+}
+
+extern "C"
+{
+    void* malloc(const size_t size)
+    {
+        return counted(__libc_malloc(size));
+    }
+
+    void* calloc(const size_t count, const size_t size)
+    {
+        return counted(__libc_calloc(count, size));
+    }
+
+    void* realloc(void* pointer, const size_t size)
+    {
+        const size_t old_size = pointer ? usable_size(pointer) : 0;
+        void* result = __libc_realloc(pointer, size);
+        if (result || size == 0)
+        {
+            if (pointer)
+            {
+                AllocTracker::on_free(old_size);
+            }
+            counted(result);
+        }
+        return result;
+    }
+
+    void* reallocarray(void* pointer, const size_t count, const size_t size)
+    {
+        size_t total = 0;
+        if (__builtin_mul_overflow(count, size, &total))
+        {
+            errno = ENOMEM;
+            return nullptr;
+        }
+        return realloc(pointer, total);
+    }
+
+    void* memalign(const size_t alignment, const size_t size)
+    {
+        return counted(__libc_memalign(alignment, size));
+    }
+
+    void* aligned_alloc(const size_t alignment, const size_t size)
+    {
+        return counted(__libc_memalign(alignment, size));
+    }
+
+    void* valloc(const size_t size)
+    {
+        return counted(__libc_valloc(size));
+    }
+
+    void* pvalloc(const size_t size)
+    {
+        return counted(__libc_pvalloc(size));
+    }
+
+    int posix_memalign(void** result, const size_t alignment, const size_t size)
+    {
+        if (alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0)
+        {
+            return EINVAL;
+        }
+        void* pointer = counted(__libc_memalign(alignment, size));
+        if (!pointer)
+        {
+            return ENOMEM;
+        }
+        *result = pointer;
+        return 0;
+    }
+
+    void free(void* pointer)
+    {
+        if (pointer)
+        {
+            AllocTracker::on_free(usable_size(pointer));
+            __libc_free(pointer);
+        }
+    }
+}
+
+#else
+
+namespace
+{
+    void* allocate(const size_t size, const size_t alignment) noexcept
+    {
+        void* pointer = nullptr;
+        if (alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+        {
+            pointer = std::malloc(std::max<size_t>(size, 1));
+        }
+        else if (posix_memalign(&pointer, alignment, std::max<size_t>(size, 1)) != 0)
+        {
+            pointer = nullptr;
+        }
+
+        if (pointer)
+        {
+            AllocTracker::on_allocate(usable_size(pointer));
+        }
+        return pointer;
+    }
+
+    void* allocate_or_throw(const size_t size, const size_t alignment)
+    {
+        for (;;)
+        {
+            if (void* pointer = allocate(size, alignment))
+            {
+                return pointer;
+            }
+            const std::new_handler handler = std::get_new_handler();
+            if (!handler)
+            {
+                throw std::bad_alloc();
+            }
+            handler();
+        }
+    }
+
+    void* allocate_nothrow(const size_t size, const size_t alignment) noexcept
+    {
+        try
+        {
+            return allocate_or_throw(size, alignment);
+        }
+        catch (...)
+        {
+            return nullptr;
+        }
+    }
+
+    void release(void* pointer) noexcept
+    {
+        if (pointer)
+        {
+            AllocTracker::on_free(usable_size(pointer));
+            std::free(pointer);
+        }
+    }
+}
+
+void* operator new(const size_t size)
+{
+    return allocate_or_throw(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void* operator new[](const size_t size)
+{
+    return allocate_or_throw(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void* operator new(const size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate_nothrow(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void* operator new[](const size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate_nothrow(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void* operator new(const size_t size, const std::align_val_t alignment)
+{
+    return allocate_or_throw(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](const size_t size, const std::align_val_t alignment)
+{
+    return allocate_or_throw(size, static_cast<size_t>(alignment));
+}
+
+void* operator new(const size_t size, const std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocate_nothrow(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](const size_t size, const std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocate_nothrow(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* pointer) noexcept { release(pointer); }
+void operator delete[](void* pointer) noexcept { release(pointer); }
+void operator delete(void* pointer, size_t) noexcept { release(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { release(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { release(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { release(pointer); }
+void operator delete(void* pointer, std::align_val_t) noexcept { release(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { release(pointer); }
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept { release(pointer); }
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept { release(pointer); }
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { release(pointer); }
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { release(pointer); }
+
+#endif
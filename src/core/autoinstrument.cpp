@@ -0,0 +1,28 @@
+// Linked into an application (as the runscope_autoinstrument object library)
+// whose code is compiled with -finstrument-functions; the compiler then calls
+// these hooks on every function entry and exit.
+
+#include "runscope/core/function_tracer.hpp"
+
+using runscope::core::FunctionTracer;
+
+namespace
+{
+    // Lets sessions set up the function table before the hooks first run.
+    const bool hooks_registered = (FunctionTracer::register_hooks(), true);
+}
+
+extern "C"
+{
+    __attribute__((no_instrument_function))
+    void __cyg_profile_func_enter(void* function, void*)
+    {
+        FunctionTracer::enter(function);
+    }
+
+    __attribute__((no_instrument_function))
+    void __cyg_profile_func_exit(void* function, void*)
+    {
+        FunctionTracer::exit(function);
+    }
+}
@@ -0,0 +1,101 @@
+#include "runscope/core/call_site.hpp"
+
+using namespace runscope::core;
+
+CallSiteRegistry::DynamicSite::DynamicSite(std::string site_name, std::string site_file, const int line)
+    : name(std::move(site_name))
+    , file(std::move(site_file))
+    , site(name.c_str(), file.c_str(), line)
+{
+
+}
+
+CallSiteRegistry& CallSiteRegistry::getInstance()
+{
+    static CallSiteRegistry registry;
+    return registry;
+}
+
+uint32_t CallSiteRegistry::register_site(const CallSite& site)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Another thread may have registered the same site while we waited.
+    const uint32_t existing = site.id_.load(std::memory_order_acquire);
+    if (existing != 0)
+    {
+        return existing;
+    }
+
+    sites_.push_back(&site);
+    const auto id = static_cast<uint32_t>(sites_.size());
+    site.id_.store(id, std::memory_order_release);
+    return id;
+}
+
+uint32_t CallSiteRegistry::intern(const std::string_view name, const std::string_view file, const int line)
+{
+    std::string key;
+    key.reserve(name.size() + file.size() + 16);
+    key.append(name).push_back('\0');
+    key.append(file).push_back('\0');
+    key.append(std::to_string(line));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto it = interned_.find(key);
+    if (it != interned_.end())
+    {
+        return it->second;
+    }
+
+    const auto& dynamic = dynamic_sites_.emplace_back(std::string(name), std::string(file), line);
+    sites_.push_back(&dynamic.site);
+    const auto id = static_cast<uint32_t>(sites_.size());
+    dynamic.site.id_.store(id, std::memory_order_release);
+    interned_.emplace(std::move(key), id);
+    return id;
+}
+
+const CallSite* CallSiteRegistry::find(const uint32_t id) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (id == 0 || id > sites_.size())
+    {
+        return nullptr;
+    }
+    return sites_[id - 1];
+}
+
+void CallSiteRegistry::reset_sample_shifts()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const CallSite* site : sites_)
+    {
+        site->set_sample_shift(0);
+    }
+}
+
+void CallSiteRegistry::reset_budget_violations()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const CallSite* site : sites_)
+    {
+        site->budget_violations_.store(0, std::memory_order_relaxed);
+    }
+}
+
+std::vector<const CallSite*> CallSiteRegistry::snapshot() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<const CallSite*> table;
+    table.reserve(sites_.size() + 1);
+    table.push_back(nullptr);
+    table.insert(table.end(), sites_.begin(), sites_.end());
+    return table;
+}
+
+size_t CallSiteRegistry::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return sites_.size();
+}
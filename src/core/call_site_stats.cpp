@@ -0,0 +1,63 @@
+#include "runscope/core/call_site_stats.hpp"
+#include <cmath>
+#include <new>
+
+using namespace runscope::core;
+
+int64_t CallSiteStats::bucket_upper_bound_ns(const size_t bucket) const noexcept
+{
+    const double ticks = std::ldexp(1.0, static_cast<int>(bucket));
+    return std::llround(ticks * ns_per_tick);
+}
+
+int64_t CallSiteStats::percentile_ns(const double percentile) const noexcept
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    const auto target = static_cast<uint64_t>(std::ceil(static_cast<double>(count) * std::clamp(percentile, 0.0, 100.0) / 100.0));
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < histogram.size(); ++bucket)
+    {
+        seen += histogram[bucket];
+        if (seen >= target && seen > 0)
+        {
+            return std::min(bucket_upper_bound_ns(bucket), max_ns);
+        }
+    }
+    return max_ns;
+}
+
+SiteAccumulatorTable::~SiteAccumulatorTable()
+{
+    for (auto& block : blocks_)
+    {
+        delete block.load(std::memory_order_relaxed);
+    }
+}
+
+void SiteAccumulatorTable::add(const uint32_t site_id, const int64_t duration, const uint64_t weight) noexcept
+{
+    const size_t block_index = site_id / block_size;
+    if (block_index >= max_blocks)
+    {
+        dropped_.store(dropped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+
+    Block* block = blocks_[block_index].load(std::memory_order_relaxed);
+    if (!block)
+    {
+        block = new (std::nothrow) Block();
+        if (!block)
+        {
+            dropped_.store(dropped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return;
+        }
+        blocks_[block_index].store(block, std::memory_order_release);
+    }
+
+    block->sites[site_id % block_size].add(duration, weight);
+}
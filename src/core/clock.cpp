@@ -1,8 +1,62 @@
 #include "runscope/core/clock.hpp"
 #include <chrono>
+#include <cmath>
+#include <mutex>
+#include <ctime>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
 
 using namespace runscope::core;
 
+namespace
+{
+    // The tick/monotonic ratio is measured between a process-wide anchor and
+    // the current session start, so only the very first calibration has to wait.
+    constexpr int64_t min_calibration_window_ns = 5'000'000;
+
+    struct CalibrationAnchor
+    {
+        bool valid{false};
+        int64_t ticks{0};
+        int64_t monotonic_ns{0};
+    };
+
+    std::mutex calibration_mutex;
+    CalibrationAnchor calibration_anchor;
+
+    int64_t monotonic_nanoseconds() noexcept
+    {
+        timespec ts{};
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+    }
+
+    bool detect_invariant_tsc() noexcept
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+        if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx))
+        {
+            return false;
+        }
+        return (edx & (1u << 8)) != 0;
+#elif defined(__aarch64__)
+        // The generic timer runs at a fixed frequency by architecture.
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    std::atomic<ClockSource>& preferred_source() noexcept
+    {
+        static std::atomic<ClockSource> source{Clock::tsc_available() ? ClockSource::Tsc : ClockSource::System};
+        return source;
+    }
+}
+
 TimePoint Clock::now() noexcept
 {
     return std::chrono::high_resolution_clock::now();
@@ -13,6 +67,17 @@ int64_t Clock::now_nanoseconds() noexcept
     return to_nanoseconds(now());
 }
 
+int64_t Clock::thread_cpu_nanoseconds() noexcept
+{
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+#else
+    return 0;
+#endif
+}
+
 int64_t Clock::now_microseconds() noexcept
 {
     return to_microseconds(now());
@@ -57,3 +122,101 @@ double Clock::duration_milliseconds(const TimePoint& start, const TimePoint& end
 {
     return std::chrono::duration<double, std::milli>(end - start).count();
 }
+
+bool Clock::tsc_available() noexcept
+{
+    static const bool available = detect_invariant_tsc();
+    return available;
+}
+
+bool Clock::set_source(const ClockSource source) noexcept
+{
+    if (source == ClockSource::Tsc && !tsc_available())
+    {
+        preferred_source().store(ClockSource::System, std::memory_order_relaxed);
+        return false;
+    }
+    preferred_source().store(source, std::memory_order_relaxed);
+    return true;
+}
+
+ClockSource Clock::source() noexcept
+{
+    return preferred_source().load(std::memory_order_relaxed);
+}
+
+ClockCalibration Clock::calibrate()
+{
+    ClockCalibration calibration;
+    if (source() != ClockSource::Tsc)
+    {
+        tsc_active_.store(false, std::memory_order_release);
+        return calibration;
+    }
+
+    std::lock_guard<std::mutex> lock(calibration_mutex);
+    if (!calibration_anchor.valid)
+    {
+        calibration_anchor.ticks = read_tsc();
+        calibration_anchor.monotonic_ns = monotonic_nanoseconds();
+        calibration_anchor.valid = true;
+    }
+
+#if defined(__aarch64__)
+    uint64_t frequency;
+    asm volatile("mrs %0, cntfrq_el0" : "=r"(frequency));
+    calibration.ns_per_tick = 1e9 / static_cast<double>(frequency);
+#else
+    int64_t now_ticks;
+    int64_t now_ns;
+    do
+    {
+        now_ticks = read_tsc();
+        now_ns = monotonic_nanoseconds();
+    }
+    while (now_ns - calibration_anchor.monotonic_ns < min_calibration_window_ns);
+
+    calibration.ns_per_tick = static_cast<double>(now_ns - calibration_anchor.monotonic_ns) /
+                              static_cast<double>(now_ticks - calibration_anchor.ticks);
+#endif
+
+    // Pin tick_origin to the same instant as a system clock reading, so
+    // converted timestamps stay comparable with Clock::now_nanoseconds().
+    const int64_t before = read_tsc();
+    const int64_t system_ns = now_nanoseconds();
+    const int64_t after = read_tsc();
+
+    calibration.source = ClockSource::Tsc;
+    calibration.tick_origin = before + (after - before) / 2;
+    calibration.ns_origin = system_ns;
+
+    tsc_active_.store(true, std::memory_order_release);
+    return calibration;
+}
+
+int64_t Clock::to_nanoseconds(const int64_t ticks, const ClockCalibration& calibration) noexcept
+{
+    if (calibration.source == ClockSource::System)
+    {
+        return ticks;
+    }
+    return calibration.ns_origin + std::llround(static_cast<double>(ticks - calibration.tick_origin) * calibration.ns_per_tick);
+}
+
+int64_t Clock::ticks_to_duration_ns(const int64_t ticks, const ClockCalibration& calibration) noexcept
+{
+    if (calibration.source == ClockSource::System)
+    {
+        return ticks;
+    }
+    return std::llround(static_cast<double>(ticks) * calibration.ns_per_tick);
+}
+
+int64_t Clock::duration_ns_to_ticks(const int64_t nanoseconds, const ClockCalibration& calibration) noexcept
+{
+    if (calibration.source == ClockSource::System)
+    {
+        return nanoseconds;
+    }
+    return std::llround(static_cast<double>(nanoseconds) / calibration.ns_per_tick);
+}
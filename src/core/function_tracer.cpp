@@ -0,0 +1,534 @@
+#include "runscope/core/function_tracer.hpp"
+#include "runscope/core/scope_profiler.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace runscope::core;
+
+namespace
+{
+    // Upper bound on distinct instrumented functions; calls to functions past
+    // it are not recorded.
+    constexpr uint32_t max_functions = 1u << 18;
+    constexpr uint32_t segment_size = 1024;
+    constexpr uint32_t segment_count = max_functions / segment_size;
+    constexpr uint32_t table_bits = 19;
+    constexpr uint32_t table_slots = 1u << table_bits;
+    static_assert(table_slots >= 2 * max_functions);
+
+    struct FunctionInfo
+    {
+        uintptr_t address{0};
+        uint32_t id{0};
+        std::atomic<bool> excluded{false};
+        std::atomic<bool> resolved{false};
+        runscope::platform::SymbolInfo symbol;
+    };
+
+    // Hits of one thread by function id, in segments allocated by reserve()
+    // or else on first use. Only the owning thread writes; readers sum them
+    // under the table's lock.
+    class HitCounts
+    {
+    public:
+        ~HitCounts()
+        {
+            for (auto& segment : segments_)
+            {
+                delete[] segment.load(std::memory_order_relaxed);
+            }
+        }
+
+        uint64_t add(const uint32_t id, const uint64_t count = 1)
+        {
+            std::atomic<uint64_t>& counter = at(id);
+            const uint64_t hits = counter.load(std::memory_order_relaxed) + count;
+            counter.store(hits, std::memory_order_relaxed);
+            return hits;
+        }
+
+        [[nodiscard]] uint64_t get(const uint32_t id) const
+        {
+            const auto* segment = segments_[id / segment_size].load(std::memory_order_acquire);
+            return segment ? segment[id % segment_size].load(std::memory_order_relaxed) : 0;
+        }
+
+        // Allocates the segments of the first count ids. Called under the
+        // table's lock, possibly while the owner is counting: it only fills
+        // segments the owner has not, and the owner's own at() does the same.
+        void reserve(const uint32_t count)
+        {
+            for (uint32_t index = 0; index < (count + segment_size - 1) / segment_size; ++index)
+            {
+                auto& slot = segments_[index];
+                std::atomic<uint64_t>* segment = slot.load(std::memory_order_acquire);
+                if (!segment)
+                {
+                    auto* fresh = new std::atomic<uint64_t>[segment_size]{};
+                    if (!slot.compare_exchange_strong(segment, fresh, std::memory_order_acq_rel))
+                    {
+                        delete[] fresh;
+                    }
+                }
+            }
+        }
+
+        // Adds every count to target and zeroes them.
+        void move_to(HitCounts& target)
+        {
+            for (uint32_t index = 0; index < segment_count; ++index)
+            {
+                auto* segment = segments_[index].load(std::memory_order_relaxed);
+                for (uint32_t offset = 0; segment && offset < segment_size; ++offset)
+                {
+                    if (const uint64_t hits = segment[offset].exchange(0, std::memory_order_relaxed); hits != 0)
+                    {
+                        target.add(index * segment_size + offset, hits);
+                    }
+                }
+            }
+        }
+
+    private:
+        std::atomic<uint64_t>& at(const uint32_t id)
+        {
+            auto& slot = segments_[id / segment_size];
+            std::atomic<uint64_t>* segment = slot.load(std::memory_order_acquire);
+            if (!segment)
+            {
+                auto* fresh = new std::atomic<uint64_t>[segment_size]{};
+                if (slot.compare_exchange_strong(segment, fresh, std::memory_order_acq_rel))
+                {
+                    segment = fresh;
+                }
+                else
+                {
+                    delete[] fresh;
+                }
+            }
+            return segment[id % segment_size];
+        }
+
+        std::array<std::atomic<std::atomic<uint64_t>*>, segment_count> segments_{};
+    };
+
+    // Insert-only open-addressing map from address to function, safe to use
+    // from the hooks without a lock. Ids are dense and never reused. Created
+    // by FunctionTracer::prepare() when a session begins, so processes that
+    // link the hooks but never profile do not pay for its slots. Never
+    // destroyed: instrumented code keeps running during static destruction.
+    class FunctionTable
+    {
+    public:
+        static FunctionTable& getInstance()
+        {
+            static auto* table = new FunctionTable();
+            return *table;
+        }
+
+        // nullptr once max_functions functions are known.
+        FunctionInfo* find_or_add(const uintptr_t address)
+        {
+            for (uint32_t probe = 0, index = slot_of(address); probe < table_slots;
+                 ++probe, index = (index + 1) % table_slots)
+            {
+                Slot& slot = slots_[index];
+                uintptr_t current = slot.address.load(std::memory_order_acquire);
+                if (current == 0)
+                {
+                    if (slot.address.compare_exchange_strong(current, address, std::memory_order_acq_rel))
+                    {
+                        return publish(slot, address);
+                    }
+                }
+                if (current == address)
+                {
+                    return ready(slot);
+                }
+            }
+            return nullptr;
+        }
+
+        // Never adds the function, unlike find_or_add.
+        FunctionInfo* find(const uintptr_t address) const
+        {
+            for (uint32_t probe = 0, index = slot_of(address); probe < table_slots;
+                 ++probe, index = (index + 1) % table_slots)
+            {
+                const Slot& slot = slots_[index];
+                const uintptr_t current = slot.address.load(std::memory_order_acquire);
+                if (current == 0)
+                {
+                    return nullptr;
+                }
+                if (current == address)
+                {
+                    return ready(slot);
+                }
+            }
+            return nullptr;
+        }
+
+        FunctionInfo* find(const uint32_t id) const
+        {
+            if (id >= std::min(next_id_.load(std::memory_order_acquire), max_functions))
+            {
+                return nullptr;
+            }
+            auto* segment = segments_[id / segment_size].load(std::memory_order_acquire);
+            return segment ? &segment[id % segment_size] : nullptr;
+        }
+
+        HitCounts& acquire_counts()
+        {
+            std::lock_guard<std::mutex> lock(counts_mutex_);
+            if (!free_counts_.empty())
+            {
+                HitCounts* counts = free_counts_.back();
+                free_counts_.pop_back();
+                return *counts;
+            }
+            return counts_.emplace_back();
+        }
+
+        // Gives every thread's counts, in use or free, the segments of the
+        // functions known so far.
+        void reserve_counts()
+        {
+            const uint32_t known = std::min(next_id_.load(std::memory_order_acquire), max_functions);
+            std::lock_guard<std::mutex> lock(counts_mutex_);
+            for (HitCounts& counts : counts_)
+            {
+                counts.reserve(known);
+            }
+        }
+
+        // Folds an exiting thread's counts into retired_ so the next thread
+        // starts from zero.
+        void release_counts(HitCounts& counts)
+        {
+            std::lock_guard<std::mutex> lock(counts_mutex_);
+            counts.move_to(retired_);
+            free_counts_.push_back(&counts);
+        }
+
+        uint64_t hits(const uint32_t id) const
+        {
+            std::lock_guard<std::mutex> lock(counts_mutex_);
+            uint64_t hits = retired_.get(id);
+            for (const HitCounts& counts : counts_)
+            {
+                hits += counts.get(id);
+            }
+            return hits;
+        }
+
+        std::mutex symbol_mutex;
+
+    private:
+        struct Slot
+        {
+            std::atomic<uintptr_t> address{0};
+            // id + 1 once the function is ready, unused_id if the table is full.
+            std::atomic<uint32_t> id{0};
+        };
+
+        static constexpr uint32_t unused_id = UINT32_MAX;
+
+        static uint32_t slot_of(const uintptr_t address)
+        {
+            return static_cast<uint32_t>((static_cast<uint64_t>(address) * 0x9E3779B97F4A7C15ull) >> (64 - table_bits));
+        }
+
+        FunctionInfo* publish(Slot& slot, const uintptr_t address)
+        {
+            const uint32_t id = next_id_.fetch_add(1, std::memory_order_relaxed);
+            if (id >= max_functions)
+            {
+                slot.id.store(unused_id, std::memory_order_release);
+                return nullptr;
+            }
+
+            auto& segment_slot = segments_[id / segment_size];
+            FunctionInfo* segment = segment_slot.load(std::memory_order_acquire);
+            if (!segment)
+            {
+                auto* fresh = new FunctionInfo[segment_size];
+                if (segment_slot.compare_exchange_strong(segment, fresh, std::memory_order_acq_rel))
+                {
+                    segment = fresh;
+                }
+                else
+                {
+                    delete[] fresh;
+                }
+            }
+
+            FunctionInfo& info = segment[id % segment_size];
+            info.address = address;
+            info.id = id;
+            slot.id.store(id + 1, std::memory_order_release);
+            return &info;
+        }
+
+        // Waits out a thread that has claimed the slot but not yet filled it.
+        FunctionInfo* ready(const Slot& slot) const
+        {
+            uint32_t id = slot.id.load(std::memory_order_acquire);
+            while (id == 0)
+            {
+                std::this_thread::yield();
+                id = slot.id.load(std::memory_order_acquire);
+            }
+            if (id == unused_id)
+            {
+                return nullptr;
+            }
+            return &segments_[(id - 1) / segment_size].load(std::memory_order_acquire)[(id - 1) % segment_size];
+        }
+
+        std::unique_ptr<Slot[]> slots_{std::make_unique<Slot[]>(table_slots)};
+        std::array<std::atomic<FunctionInfo*>, segment_count> segments_{};
+        std::atomic<uint32_t> next_id_{0};
+
+        std::deque<HitCounts> counts_;
+        std::vector<HitCounts*> free_counts_;
+        HitCounts retired_;
+        mutable std::mutex counts_mutex_;
+    };
+
+    struct CacheSlot
+    {
+        uintptr_t address;
+        FunctionInfo* info;
+    };
+
+    struct Frame
+    {
+        int64_t start_ticks;
+        FunctionInfo* info;
+        uint32_t call_depth;
+        uint32_t ended_at_begin;
+        int depth;
+    };
+
+    constexpr size_t max_frames = 256;
+    constexpr size_t cache_slots = 256;
+
+    struct ThreadState
+    {
+        // Counts every hook call, recorded or not, so an exit can tell
+        // whether the innermost frame belongs to it.
+        uint32_t call_depth;
+        uint32_t frame_count;
+        // Set while the tracer itself runs, so hooks from instrumented code
+        // it calls into are counted but otherwise ignored.
+        bool busy;
+        // Set once the thread has handed back its hit counts on exit.
+        bool exited;
+        HitCounts* hits;
+        std::array<Frame, max_frames> frames;
+        std::array<CacheSlot, cache_slots> cache;
+    };
+
+    constinit thread_local ThreadState state{};
+    constinit std::atomic<uint64_t> hit_cutoff{0};
+    constinit std::atomic<bool> hooks_linked{false};
+
+    // Owns the calling thread's hit counts and hands them back when the
+    // thread exits.
+    struct LocalHits
+    {
+        HitCounts* counts{nullptr};
+
+        ~LocalHits()
+        {
+            if (counts)
+            {
+                FunctionTable::getInstance().release_counts(*counts);
+            }
+            state.hits = nullptr;
+            state.exited = true;
+        }
+    };
+
+    HitCounts* local_hits()
+    {
+        if (!state.hits && !state.exited)
+        {
+            thread_local LocalHits local;
+            if (!local.counts)
+            {
+                local.counts = &FunctionTable::getInstance().acquire_counts();
+            }
+            state.hits = local.counts;
+        }
+        return state.hits;
+    }
+
+    FunctionInfo* lookup(void* function)
+    {
+        const auto address = reinterpret_cast<uintptr_t>(function);
+        CacheSlot& slot = state.cache[(address >> 4) % cache_slots];
+        if (slot.address != address)
+        {
+            slot.info = FunctionTable::getInstance().find_or_add(address);
+            slot.address = address;
+        }
+        return slot.info;
+    }
+}
+
+void FunctionTracer::enter(void* function) noexcept
+{
+    ++state.call_depth;
+    if (state.busy)
+    {
+        return;
+    }
+    state.busy = true;
+    const AllocTracker::Pause pause;
+    if (!ProfilerEngine::category_enabled(category::Functions))
+    {
+        state.busy = false;
+        return;
+    }
+
+    FunctionInfo* info = lookup(function);
+    HitCounts* counts = local_hits();
+    if (!info || !counts)
+    {
+        state.busy = false;
+        return;
+    }
+    const uint64_t hits = counts->add(info->id);
+    const uint64_t limit = hit_cutoff.load(std::memory_order_relaxed);
+    if (!info->excluded.load(std::memory_order_relaxed) && (limit == 0 || hits <= limit) &&
+        state.frame_count < max_frames)
+    {
+        Frame& frame = state.frames[state.frame_count++];
+        frame.info = info;
+        frame.call_depth = state.call_depth;
+        frame.depth = ScopeProfiler::get_depth();
+        ScopeProfiler::increment_depth();
+        frame.ended_at_begin = ScopeProfiler::scopes_ended_ref();
+        frame.start_ticks = Clock::ticks();
+    }
+
+    state.busy = false;
+}
+
+void FunctionTracer::exit(void*) noexcept
+{
+    const uint32_t call_depth = state.call_depth--;
+    if (state.busy)
+    {
+        return;
+    }
+    const int64_t end_ticks = Clock::ticks();
+
+    // Frames left open by longjmp or a missed exit are dropped.
+    while (state.frame_count > 0 && state.frames[state.frame_count - 1].call_depth > call_depth)
+    {
+        --state.frame_count;
+        ScopeProfiler::decrement_depth();
+    }
+    if (state.frame_count == 0 || state.frames[state.frame_count - 1].call_depth != call_depth)
+    {
+        return;
+    }
+    state.busy = true;
+
+    const Frame& frame = state.frames[--state.frame_count];
+    EventRecord record{};
+    record.start = frame.start_ticks;
+    record.end = end_ticks;
+    record.site_id = frame.info->id;
+    record.depth = static_cast<uint16_t>(frame.depth);
+    record.kind = EventKind::Function;
+    record.flags = EventRecord::flag_nested;
+    uint32_t& scopes_ended = ScopeProfiler::scopes_ended_ref();
+    record.aux = scopes_ended - frame.ended_at_begin;
+    ++scopes_ended;
+
+    ProfilerEngine::getInstance().record_event(record);
+    ScopeProfiler::decrement_depth();
+
+    state.busy = false;
+}
+
+void FunctionTracer::register_hooks() noexcept
+{
+    hooks_linked.store(true, std::memory_order_relaxed);
+}
+
+void FunctionTracer::prepare()
+{
+    if (!hooks_linked.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    const AllocTracker::Pause pause;
+    FunctionTable::getInstance().reserve_counts();
+}
+
+void FunctionTracer::exclude(const void* function)
+{
+    if (FunctionInfo* info = FunctionTable::getInstance().find_or_add(reinterpret_cast<uintptr_t>(function)))
+    {
+        info->excluded.store(true, std::memory_order_relaxed);
+    }
+}
+
+void FunctionTracer::include(const void* function)
+{
+    if (FunctionInfo* info = FunctionTable::getInstance().find(reinterpret_cast<uintptr_t>(function)))
+    {
+        info->excluded.store(false, std::memory_order_relaxed);
+    }
+}
+
+void FunctionTracer::set_hit_limit(const uint64_t calls) noexcept
+{
+    hit_cutoff.store(calls, std::memory_order_relaxed);
+}
+
+uint64_t FunctionTracer::hit_limit() noexcept
+{
+    return hit_cutoff.load(std::memory_order_relaxed);
+}
+
+uint64_t FunctionTracer::hits(const void* function)
+{
+    auto& table = FunctionTable::getInstance();
+    const FunctionInfo* info = table.find(reinterpret_cast<uintptr_t>(function));
+    return info ? table.hits(info->id) : 0;
+}
+
+const runscope::platform::SymbolInfo& FunctionTracer::symbol(const uint32_t id)
+{
+    static const platform::SymbolInfo unknown{"<unknown function>", ""};
+
+    auto& table = FunctionTable::getInstance();
+    FunctionInfo* info = table.find(id);
+    if (!info)
+    {
+        return unknown;
+    }
+    if (!info->resolved.load(std::memory_order_acquire))
+    {
+        std::lock_guard<std::mutex> lock(table.symbol_mutex);
+        if (!info->resolved.load(std::memory_order_relaxed))
+        {
+            info->symbol = platform::SignalSampler::getInstance().symbolize(info->address);
+            info->resolved.store(true, std::memory_order_release);
+        }
+    }
+    return info->symbol;
+}
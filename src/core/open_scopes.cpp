@@ -0,0 +1,122 @@
+#include "runscope/core/open_scopes.hpp"
+#include "runscope/core/thread_registry.hpp"
+#include <algorithm>
+
+using namespace runscope::core;
+
+// Owns the calling thread's stack and hands it back when the thread exits.
+struct OpenScopeTable::LocalStack
+{
+    Stack* stack{nullptr};
+
+    ~LocalStack()
+    {
+        if (stack)
+        {
+            getInstance().release(*stack);
+        }
+    }
+};
+
+OpenScopeTable& OpenScopeTable::getInstance()
+{
+    // Never destroyed: threads may still close scopes during static destruction.
+    static auto* table = new OpenScopeTable();
+    return *table;
+}
+
+OpenScopeTable::Stack& OpenScopeTable::local()
+{
+    thread_local LocalStack local;
+    if (!local.stack)
+    {
+        local.stack = &getInstance().acquire(ThreadRegistry::current_index());
+    }
+    return *local.stack;
+}
+
+void OpenScopeTable::push(const uint32_t site_id, const int64_t start_ticks) noexcept
+{
+    Stack& stack = local();
+    const uint32_t depth = stack.depth.load(std::memory_order_relaxed);
+    if (depth < max_depth)
+    {
+        Slot& slot = stack.slots[depth];
+        const uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+        slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.site_id.store(site_id, std::memory_order_relaxed);
+        slot.start_ticks.store(start_ticks, std::memory_order_relaxed);
+        slot.sequence.store(sequence + 2, std::memory_order_release);
+    }
+    stack.depth.store(depth + 1, std::memory_order_release);
+}
+
+void OpenScopeTable::pop() noexcept
+{
+    Stack& stack = local();
+    stack.depth.store(stack.depth.load(std::memory_order_relaxed) - 1, std::memory_order_release);
+}
+
+std::vector<OpenScopeRecord> OpenScopeTable::snapshot() const
+{
+    std::vector<OpenScopeRecord> result;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const Stack& stack : stacks_)
+    {
+        if (!stack.in_use.load(std::memory_order_acquire))
+        {
+            continue;
+        }
+        const uint16_t thread_index = stack.thread_index.load(std::memory_order_relaxed);
+        const uint32_t depth = std::min<uint32_t>(stack.depth.load(std::memory_order_acquire), max_depth);
+        for (uint32_t i = 0; i < depth; ++i)
+        {
+            const Slot& slot = stack.slots[i];
+            OpenScopeRecord record;
+            record.thread_index = thread_index;
+            record.depth = static_cast<uint16_t>(i);
+
+            uint32_t before = 0;
+            uint32_t after = 0;
+            do
+            {
+                before = slot.sequence.load(std::memory_order_acquire);
+                record.site_id = slot.site_id.load(std::memory_order_relaxed);
+                record.start_ticks = slot.start_ticks.load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                after = slot.sequence.load(std::memory_order_relaxed);
+            } while (before != after || (before & 1) != 0);
+
+            result.push_back(record);
+        }
+    }
+    return result;
+}
+
+OpenScopeTable::Stack& OpenScopeTable::acquire(const uint16_t thread_index)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stack* stack = nullptr;
+    if (!free_.empty())
+    {
+        stack = free_.back();
+        free_.pop_back();
+    }
+    else
+    {
+        stack = &stacks_.emplace_back();
+    }
+    stack->depth.store(0, std::memory_order_relaxed);
+    stack->thread_index.store(thread_index, std::memory_order_relaxed);
+    stack->in_use.store(true, std::memory_order_release);
+    return *stack;
+}
+
+void OpenScopeTable::release(Stack& stack)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    stack.in_use.store(false, std::memory_order_release);
+    stack.depth.store(0, std::memory_order_relaxed);
+    free_.push_back(&stack);
+}
@@ -0,0 +1,16 @@
+#include "runscope/core/profiled_mutex.hpp"
+
+using namespace runscope::core;
+
+void runscope::core::record_lock_event(const uint32_t site_id, const EventKind kind, const int64_t start_ticks,
+                                       const int64_t end_ticks, const bool shared) noexcept
+{
+    EventRecord record{};
+    record.start = start_ticks;
+    record.end = end_ticks;
+    record.site_id = site_id;
+    record.kind = kind;
+    record.aux = shared ? 1 : 0;
+
+    ProfilerEngine::getInstance().record_event(record);
+}
@@ -1,23 +1,181 @@
 #include "runscope/core/profiler_engine.hpp"
+#include "runscope/core/alloc_tracker.hpp"
+#include "runscope/core/call_site.hpp"
+#include "runscope/core/function_tracer.hpp"
+#include "runscope/core/scope_profiler.hpp"
+#include "runscope/platform/signal_sampler.hpp"
+#include "runscope/platform/perf_counters.hpp"
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <set>
+#include <tuple>
 
 using namespace runscope::core;
 
+namespace
+{
+    constexpr int calibration_scopes = 1000;
+    constexpr int calibration_rounds = 5;
+
+    bool tracks_open_scopes(const SessionOptions& options) noexcept
+    {
+        return options.track_open_scopes || options.open_scope_budget_ns > 0;
+    }
+
+    struct ScopeCost
+    {
+        int64_t self_ns{0};
+        int64_t total_ns{0};
+    };
+
+    // Runs rounds of empty scopes nested in an outer scope. The median inner
+    // duration is what a scope adds to itself; the outer duration per inner
+    // scope is what each one adds to its enclosing scopes. The fastest round
+    // is kept, since preemption only ever adds time.
+    ScopeCost measure_scope_cost(ProfilerSession& session)
+    {
+        static constinit CallSite outer_site{"runscope::calibration", __FILE__, __LINE__};
+        static constinit CallSite inner_site{"runscope::calibration::scope", __FILE__, __LINE__};
+        const ThreadId thread = std::this_thread::get_id();
+
+        std::vector<int64_t> self_ns;
+        int64_t total_ns = std::numeric_limits<int64_t>::max();
+        for (int round = 0; round < calibration_rounds; ++round)
+        {
+            session.clear();
+            {
+                ScopeProfiler outer(outer_site);
+                for (int i = 0; i < calibration_scopes; ++i)
+                {
+                    ScopeProfiler inner(inner_site);
+                }
+            }
+
+            int64_t outer_ns = -1;
+            size_t inner_count = 0;
+            for (const auto& entry : session.get_entries())
+            {
+                if (entry.thread_id != thread)
+                {
+                    continue;
+                }
+                if (entry.name == inner_site.name)
+                {
+                    self_ns.push_back(entry.duration_ns());
+                    ++inner_count;
+                }
+                else if (entry.name == outer_site.name)
+                {
+                    outer_ns = entry.duration_ns();
+                }
+            }
+            if (outer_ns >= 0 && inner_count == calibration_scopes)
+            {
+                total_ns = std::min(total_ns, outer_ns / calibration_scopes);
+            }
+        }
+        session.clear();
+
+        if (self_ns.empty() || total_ns == std::numeric_limits<int64_t>::max())
+        {
+            return {};
+        }
+        const auto median = self_ns.begin() + static_cast<std::ptrdiff_t>(self_ns.size() / 2);
+        std::ranges::nth_element(self_ns, median);
+
+        ScopeCost cost;
+        cost.self_ns = *median;
+        cost.total_ns = std::max(total_ns, cost.self_ns);
+        return cost;
+    }
+}
+
 ProfilerEngine& ProfilerEngine::getInstance()
 {
     static ProfilerEngine engine;
     return engine;
 }
 
+ProfilerEngine::~ProfilerEngine()
+{
+    stop_sampling();
+    stop_watchdog();
+}
+
 void ProfilerEngine::begin_session(const std::string& name, const ProfilerMode mode)
 {
-    std::lock_guard<std::mutex> lock(mutex_);
-    mode_ = mode;
-    current_session_ = std::make_shared<ProfilerSession>(name);
+    SessionOptions options;
+    options.mode = mode;
+    begin_session(name, options);
+}
+
+void ProfilerEngine::begin_session(const std::string& name, const SessionOptions& options)
+{
+    stop_sampling();
+    stop_watchdog();
+    CallSiteRegistry::getInstance().reset_sample_shifts();
+    CallSiteRegistry::getInstance().reset_budget_violations();
+
+    // Sampling-only sessions never run instrumented scopes.
+    ProfilerOverhead overhead;
+    if (options.calibrate_overhead && options.mode != ProfilerMode::Sampling && is_enabled())
+    {
+        overhead = calibrate_overhead(options);
+    }
+    FunctionTracer::prepare();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        mode_.store(options.mode, std::memory_order_release);
+        current_session_ = std::make_shared<ProfilerSession>(name, options);
+        current_session_->set_overhead(overhead);
+        active_session_id_.store(current_session_->id(), std::memory_order_release);
+        shared_settings_.cpu_time_active.store(options.cpu_time, std::memory_order_relaxed);
+        shared_settings_.perf_categories_active.store(platform::PerfCounters::supported() ? options.perf_categories : 0,
+                                      std::memory_order_relaxed);
+        shared_settings_.lock_threshold_ticks.store(Clock::duration_ns_to_ticks(options.lock_threshold_ns, current_session_->calibration()),
+                                    std::memory_order_relaxed);
+        // Throttling needs the calibrated cost of a scope.
+        int64_t budget_ticks = 0;
+        if (options.overhead_budget > 0.0 && overhead.total_ns > 0)
+        {
+            const auto budget_ns = static_cast<int64_t>(static_cast<double>(overhead.total_ns) / options.overhead_budget);
+            budget_ticks = std::max<int64_t>(Clock::duration_ns_to_ticks(budget_ns, current_session_->calibration()), 1);
+        }
+        shared_settings_.scope_budget_ticks.store(budget_ticks, std::memory_order_relaxed);
+        shared_settings_.entry_threshold_ticks.store(Clock::duration_ns_to_ticks(options.entry_threshold_ns, current_session_->calibration()),
+                                     std::memory_order_relaxed);
+        shared_settings_.open_scopes_active.store(tracks_open_scopes(options), std::memory_order_relaxed);
+        const ClockCalibration& calibration = current_session_->calibration();
+        shared_settings_.ns_per_tick.store(calibration.source == ClockSource::System ? 1.0 : calibration.ns_per_tick,
+                           std::memory_order_relaxed);
+        update_active_categories();
+        if (options.open_scope_budget_ns > 0 || options.on_budget_violation)
+        {
+            start_watchdog(current_session_);
+        }
+    }
+
+    if (options.mode != ProfilerMode::Instrumentation)
+    {
+        start_sampling(options.sampling_hz);
+    }
 }
 
 void ProfilerEngine::end_session() const
 {
+    stop_sampling();
+    stop_watchdog();
+
     std::lock_guard<std::mutex> lock(mutex_);
+    active_session_id_.store(0, std::memory_order_release);
+    shared_settings_.cpu_time_active.store(false, std::memory_order_relaxed);
+    shared_settings_.perf_categories_active.store(0, std::memory_order_relaxed);
+    shared_settings_.scope_budget_ticks.store(0, std::memory_order_relaxed);
+    shared_settings_.entry_threshold_ticks.store(0, std::memory_order_relaxed);
+    shared_settings_.open_scopes_active.store(false, std::memory_order_relaxed);
+    update_active_categories();
     if (current_session_)
     {
         current_session_->end();
@@ -26,11 +184,11 @@ void ProfilerEngine::end_session() const
 
 void ProfilerEngine::record_entry(ProfileEntry entry) const
 {
-    if (!enabled_.load(std::memory_order_acquire))
+    if (!enabled_.load(std::memory_order_acquire) || active_session_id_.load(std::memory_order_acquire) == 0)
     {
         return;
     }
-    
+
     std::lock_guard<std::mutex> lock(mutex_);
     if (current_session_ && current_session_->is_active())
     {
@@ -38,6 +196,73 @@ void ProfilerEngine::record_entry(ProfileEntry entry) const
     }
 }
 
+void ProfilerEngine::record_event(const EventRecord& record) const
+{
+    if (!enabled_.load(std::memory_order_acquire))
+    {
+        return;
+    }
+
+    const AllocTracker::Pause pause;
+
+    if (ProfilerSession* const session = settings().private_session)
+    {
+        session->add_record(record);
+        return;
+    }
+
+    const uint64_t session_id = active_session_id_.load(std::memory_order_acquire);
+    if (session_id == 0)
+    {
+        return;
+    }
+
+    // Fast path: this thread already owns a stream in the active session.
+    if (auto* stream = ProfilerSession::cached_stream(session_id))
+    {
+        stream->record(record);
+        return;
+    }
+
+    // First event from this thread: register a stream once under the lock.
+    // In Both mode the thread is sampled as well from now on.
+    if (mode_.load(std::memory_order_acquire) == ProfilerMode::Both)
+    {
+        platform::SignalSampler::getInstance().register_current_thread();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (current_session_ && current_session_->id() == session_id && current_session_->is_active())
+    {
+        current_session_->add_record(record);
+    }
+}
+
+void ProfilerEngine::record_throttle(const uint32_t site_id, const uint32_t sample_shift) const
+{
+    const AllocTracker::Pause pause;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (current_session_ && current_session_->is_active())
+    {
+        current_session_->add_throttle(site_id, sample_shift);
+    }
+}
+
+void ProfilerEngine::record_budget_violation(BudgetViolationRecord violation) const
+{
+    // The scope's own record has just registered this thread's stream, so
+    // the queue is reached without taking a lock.
+    const uint64_t session_id = active_session_id_.load(std::memory_order_acquire);
+    if (session_id == 0)
+    {
+        return;
+    }
+    if (auto* stream = ProfilerSession::cached_stream(session_id))
+    {
+        stream->budget_violations.push(std::move(violation));
+    }
+}
+
 bool ProfilerEngine::is_active() const noexcept
 {
     std::lock_guard<std::mutex> lock(mutex_);
@@ -46,7 +271,7 @@ bool ProfilerEngine::is_active() const noexcept
 
 ProfilerMode ProfilerEngine::mode() const noexcept
 {
-    return mode_;
+    return mode_.load(std::memory_order_acquire);
 }
 
 std::shared_ptr<ProfilerSession> ProfilerEngine::current_session()
@@ -65,6 +290,146 @@ std::vector<ProfileEntry> ProfilerEngine::get_entries() const
     return {};
 }
 
+std::vector<ProfileEntry> ProfilerEngine::get_entries_since(EntryCursor& cursor) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (current_session_)
+    {
+        return current_session_->get_entries_since(cursor);
+    }
+    return {};
+}
+
+std::vector<FrameMark> ProfilerEngine::get_frame_marks() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (current_session_)
+    {
+        return current_session_->get_frame_marks();
+    }
+    return {};
+}
+
+std::vector<FrameMark> ProfilerEngine::get_frame_marks(EntryCursor& cursor) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (current_session_)
+    {
+        return current_session_->get_frame_marks(cursor);
+    }
+    return {};
+}
+
+std::vector<CounterSample> ProfilerEngine::get_counter_samples() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (current_session_)
+    {
+        return current_session_->get_counter_samples();
+    }
+    return {};
+}
+
+std::vector<CounterSample> ProfilerEngine::get_counter_samples(EntryCursor& cursor) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (current_session_)
+    {
+        return current_session_->get_counter_samples(cursor);
+    }
+    return {};
+}
+
+std::vector<AsyncSpan> ProfilerEngine::get_async_spans() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (current_session_)
+    {
+        return current_session_->get_async_spans();
+    }
+    return {};
+}
+
+std::vector<LockEvent> ProfilerEngine::get_lock_events() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (current_session_)
+    {
+        return current_session_->get_lock_events();
+    }
+    return {};
+}
+
+std::vector<CallSiteStats> ProfilerEngine::get_site_stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (current_session_)
+    {
+        return current_session_->get_site_stats();
+    }
+    return {};
+}
+
+std::vector<CallSiteStats> ProfilerEngine::get_accumulated_stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (current_session_)
+    {
+        return current_session_->get_accumulated_stats();
+    }
+    return {};
+}
+
+std::vector<ThrottledSite> ProfilerEngine::get_throttled_sites() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (current_session_)
+    {
+        return current_session_->get_throttled_sites();
+    }
+    return {};
+}
+
+std::vector<OpenScope> ProfilerEngine::get_open_scopes() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (current_session_)
+    {
+        return current_session_->get_open_scopes();
+    }
+    return {};
+}
+
+std::vector<OpenScope> ProfilerEngine::get_scope_overruns() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (current_session_)
+    {
+        return current_session_->get_scope_overruns();
+    }
+    return {};
+}
+
+std::vector<BudgetSiteStats> ProfilerEngine::get_budget_stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (current_session_)
+    {
+        return current_session_->get_budget_stats();
+    }
+    return {};
+}
+
+uint64_t ProfilerEngine::dropped_events() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (current_session_)
+    {
+        return current_session_->dropped_events();
+    }
+    return 0;
+}
+
 void ProfilerEngine::clear() const
 {
     std::lock_guard<std::mutex> lock(mutex_);
@@ -77,9 +442,241 @@ void ProfilerEngine::clear() const
 void ProfilerEngine::set_enabled(const bool enabled) noexcept
 {
     enabled_.store(enabled, std::memory_order_release);
+    update_active_categories();
 }
 
 bool ProfilerEngine::is_enabled() const noexcept
 {
     return enabled_.load(std::memory_order_acquire);
-}
\ No newline at end of file
+}
+
+void ProfilerEngine::set_categories(const uint32_t mask) noexcept
+{
+    category_mask_.store(mask, std::memory_order_release);
+    update_active_categories();
+}
+
+uint32_t ProfilerEngine::categories() const noexcept
+{
+    return category_mask_.load(std::memory_order_acquire);
+}
+
+void ProfilerEngine::update_active_categories() const noexcept
+{
+    // Sampling-only sessions skip instrumented scopes entirely.
+    const bool recording = enabled_.load(std::memory_order_acquire) &&
+                           active_session_id_.load(std::memory_order_acquire) != 0 &&
+                           mode_.load(std::memory_order_acquire) != ProfilerMode::Sampling;
+    shared_settings_.active_categories.store(recording ? category_mask_.load(std::memory_order_acquire) : 0,
+                             std::memory_order_relaxed);
+}
+
+ProfilerOverhead ProfilerEngine::calibrate_overhead(const SessionOptions& options)
+{
+    SessionOptions scratch_options;
+    scratch_options.cpu_time = options.cpu_time;
+    ProfilerSession scratch("runscope calibration", scratch_options);
+
+    // Only this thread's scopes see the scratch settings and land in the
+    // scratch session; other threads keep recording as before.
+    ScopeSettings calibration;
+    calibration.active_categories.store(category::General, std::memory_order_relaxed);
+    calibration.cpu_time_active.store(options.cpu_time, std::memory_order_relaxed);
+    // Tracking is part of what a scope costs, so the scratch scopes pay it too.
+    calibration.open_scopes_active.store(tracks_open_scopes(options), std::memory_order_relaxed);
+    const ClockCalibration& clock = scratch.calibration();
+    calibration.ns_per_tick.store(clock.source == ClockSource::System ? 1.0 : clock.ns_per_tick, std::memory_order_relaxed);
+    calibration.private_session = &scratch;
+
+    const ScopeSettings* const shared = std::exchange(settings_, &calibration);
+    ProfilerOverhead overhead;
+    const ScopeCost cost = measure_scope_cost(scratch);
+    overhead.self_ns = cost.self_ns;
+    overhead.total_ns = cost.total_ns;
+    overhead.perf_self_ns = cost.self_ns;
+    overhead.perf_total_ns = cost.total_ns;
+
+    if (options.perf_categories != 0 && platform::PerfCounters::supported())
+    {
+        calibration.perf_categories_active.store(category::General, std::memory_order_relaxed);
+        const ScopeCost perf_cost = measure_scope_cost(scratch);
+        overhead.perf_self_ns = perf_cost.self_ns;
+        overhead.perf_total_ns = perf_cost.total_ns;
+    }
+    settings_ = shared;
+
+    return overhead;
+}
+
+void ProfilerEngine::start_sampling(const uint32_t frequency_hz) const
+{
+    std::lock_guard<std::mutex> lock(sampling_mutex_);
+    if (sample_collector_.joinable() || !platform::SignalSampler::getInstance().start(frequency_hz))
+    {
+        return;
+    }
+
+    collecting_.store(true, std::memory_order_release);
+    sample_collector_ = std::thread([this]
+    {
+        while (collecting_.load(std::memory_order_acquire))
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            collect_samples();
+        }
+    });
+}
+
+void ProfilerEngine::stop_sampling() const
+{
+    std::lock_guard<std::mutex> lock(sampling_mutex_);
+    if (!sample_collector_.joinable())
+    {
+        return;
+    }
+
+    platform::SignalSampler::getInstance().stop();
+    collecting_.store(false, std::memory_order_release);
+    sample_collector_.join();
+    collect_samples();
+}
+
+void ProfilerEngine::start_watchdog(std::shared_ptr<ProfilerSession> session) const
+{
+    std::lock_guard<std::mutex> lock(watchdog_mutex_);
+    if (watchdog_.joinable())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> watching_lock(watching_mutex_);
+        watching_ = true;
+    }
+    watchdog_ = std::thread([this, session = std::move(session)]
+    {
+        run_watchdog(*session);
+    });
+}
+
+void ProfilerEngine::stop_watchdog() const
+{
+    std::lock_guard<std::mutex> lock(watchdog_mutex_);
+    if (!watchdog_.joinable())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> watching_lock(watching_mutex_);
+        watching_ = false;
+    }
+    watching_changed_.notify_all();
+    watchdog_.join();
+}
+
+void ProfilerEngine::run_watchdog(ProfilerSession& session) const
+{
+    // Several checks per budget, so an overrun is reported soon after it
+    // happens, but never so often that the checks cost more than the scopes.
+    const SessionOptions& options = session.options();
+    const int64_t budget_ns = options.open_scope_budget_ns;
+    const auto interval = budget_ns > 0
+        ? std::clamp<std::chrono::nanoseconds>(std::chrono::nanoseconds(budget_ns / 4),
+                                               std::chrono::milliseconds(1),
+                                               std::chrono::milliseconds(100))
+        : std::chrono::milliseconds(10);
+    auto deliver_violations = [&session, &options]
+    {
+        if (options.on_budget_violation)
+        {
+            for (const auto& violation : session.take_budget_violations())
+            {
+                options.on_budget_violation(violation);
+            }
+        }
+    };
+
+    // Each open scope is reported once, however long it stays open.
+    using ScopeKey = std::tuple<ThreadId, int, int64_t>;
+    std::set<ScopeKey> reported;
+
+    std::unique_lock<std::mutex> lock(watching_mutex_);
+    while (!watching_changed_.wait_for(lock, interval, [this] { return !watching_; }))
+    {
+        lock.unlock();
+        deliver_violations();
+        if (budget_ns <= 0)
+        {
+            lock.lock();
+            continue;
+        }
+
+        const auto open = session.get_open_scopes();
+        std::set<ScopeKey> overrunning;
+        for (const auto& scope : open)
+        {
+            if (scope.elapsed_ns <= budget_ns)
+            {
+                continue;
+            }
+            ScopeKey key{scope.thread_id, scope.depth, scope.start_ns};
+            if (!reported.contains(key))
+            {
+                session.add_scope_overrun(scope);
+                if (options.on_scope_overrun)
+                {
+                    options.on_scope_overrun(scope, open);
+                }
+            }
+            overrunning.insert(std::move(key));
+        }
+        reported = std::move(overrunning);
+        lock.lock();
+    }
+
+    // Violations of scopes that ended just before the session.
+    lock.unlock();
+    deliver_violations();
+}
+
+void ProfilerEngine::collect_samples() const
+{
+    auto& sampler = platform::SignalSampler::getInstance();
+    std::vector<platform::StackSample> samples;
+    if (sampler.drain(samples) == 0)
+    {
+        return;
+    }
+
+    std::shared_ptr<ProfilerSession> session;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        session = current_session_;
+    }
+    if (!session || !session->is_active())
+    {
+        return;
+    }
+
+    const int64_t period = Clock::duration_ns_to_ticks(1000000000LL / sampler.frequency(), session->calibration());
+
+    std::vector<uint32_t> frame_sites;
+    for (const auto& sample : samples)
+    {
+        frame_sites.clear();
+        for (size_t i = 0; i < sample.frames.size(); ++i)
+        {
+            // Return addresses point past the call; look up the call itself.
+            const uintptr_t address = i == 0 ? sample.frames[i] : sample.frames[i] - 1;
+            auto it = sample_sites_.find(address);
+            if (it == sample_sites_.end())
+            {
+                const auto symbol = sampler.symbolize(address);
+                it = sample_sites_.emplace(address, CallSiteRegistry::getInstance().intern(symbol.name, symbol.module, 0)).first;
+            }
+            frame_sites.push_back(it->second);
+        }
+        session->add_sample(sample.thread, sample.timestamp, period, frame_sites);
+    }
+}
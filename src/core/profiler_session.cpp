@@ -1,14 +1,95 @@
 #include "runscope/core/profiler_session.hpp"
 #include "runscope/core/clock.hpp"
+#include "runscope/core/call_site.hpp"
+#include "runscope/core/thread_registry.hpp"
+#include "runscope/core/function_tracer.hpp"
+#include "runscope/core/open_scopes.hpp"
 #include <algorithm>
+#include <utility>
 
 #include "runscope/platform/process_attacher.hpp"
 
 using namespace runscope::core;
 
-ProfilerSession::ProfilerSession(std::string name)
-    : name_(std::move(name))
+namespace
+{
+    std::atomic<uint64_t> next_session_id{1};
+
+    // Frame marks are kept in the streams but are not entries.
+    bool is_entry(const EventRecord& record) noexcept
+    {
+        return record.kind == EventKind::Scope || record.kind == EventKind::Function || record.kind == EventKind::Sample;
+    }
+
+    // Threads that registered after the snapshot was taken resolve to no id.
+    ThreadId thread_of(const std::vector<ThreadDescriptor>& threads, const EventRecord& record) noexcept
+    {
+        return record.thread_index < threads.size() ? threads[record.thread_index].id : ThreadId();
+    }
+
+    void apply_metric(ProfileEntry& entry, const EventRecord& metric) noexcept
+    {
+        switch (metric.metric)
+        {
+        case MetricKind::Allocations:
+            entry.memory_used = static_cast<uint64_t>(metric.start);
+            entry.self_memory_used = static_cast<uint64_t>(metric.end);
+            entry.allocation_count = metric.aux;
+            break;
+        case MetricKind::CpuTime:
+            entry.cpu_time_ns = metric.start;
+            if (entry.duration_ns() > 0)
+            {
+                entry.cpu_usage = 100.0 * static_cast<double>(metric.start) / static_cast<double>(entry.duration_ns());
+            }
+            break;
+        case MetricKind::PerfSoftware:
+            entry.perf.software = true;
+            entry.perf.task_clock_ns = static_cast<uint64_t>(metric.start);
+            entry.perf.page_faults = static_cast<uint64_t>(metric.end);
+            entry.perf.context_switches = metric.aux;
+            break;
+        case MetricKind::PerfHardware:
+            entry.perf.hardware = true;
+            entry.perf.cycles = static_cast<uint64_t>(metric.start);
+            entry.perf.instructions = static_cast<uint64_t>(metric.end);
+            entry.perf.cache_misses = metric.aux;
+            break;
+        case MetricKind::None:
+            break;
+        }
+    }
+
+    struct LocalStreamCache
+    {
+        uint64_t session_id{0};
+        std::shared_ptr<ProfilerSession::ThreadStream> stream;
+    };
+
+    LocalStreamCache& local_stream_cache()
+    {
+        thread_local LocalStreamCache cache;
+        return cache;
+    }
+}
+
+ProfilerSession::ThreadStream::ThreadStream(const ThreadId owner_id, const uint16_t index, const SessionOptions& options)
+    : owner(owner_id)
+    , thread_index(index)
+    , recording(options.recording)
+{
+    if (recording == RecordingMode::FlightRecorder)
+    {
+        ring = std::make_unique<RingBuffer<EventRecord>>(options.ring_bytes_per_thread / sizeof(EventRecord));
+    }
+}
+
+ProfilerSession::ProfilerSession(std::string name, const SessionOptions options)
+    : id_(next_session_id.fetch_add(1, std::memory_order_relaxed))
+    , name_(std::move(name))
+    , options_(options)
     , start_time_(Clock::now())
+    , calibration_(Clock::calibrate())
     , active_(true)
 {
 
@@ -22,46 +103,701 @@ ProfilerSession::~ProfilerSession()
     }
 }
 
+ProfilerSession::ThreadStream* ProfilerSession::cached_stream(const uint64_t session_id) noexcept
+{
+    const auto& cache = local_stream_cache();
+    if (cache.session_id == session_id && cache.stream && !cache.stream->retired.load(std::memory_order_acquire))
+    {
+        return cache.stream.get();
+    }
+    return nullptr;
+}
+
+ProfilerSession::ThreadStream& ProfilerSession::local_stream()
+{
+    if (auto* stream = cached_stream(id_))
+    {
+        return *stream;
+    }
+
+    const auto this_thread = std::this_thread::get_id();
+    const uint16_t index = ThreadRegistry::current_index();
+    auto& cache = local_stream_cache();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto it = std::ranges::find_if(streams_, [this_thread](const auto& stream)
+    {
+        return stream->owner == this_thread;
+    });
+
+    if (it != streams_.end())
+    {
+        cache.stream = *it;
+    }
+    else
+    {
+        cache.stream = std::make_shared<ThreadStream>(this_thread, index, options_);
+        streams_.push_back(cache.stream);
+    }
+    cache.session_id = id_;
+
+    return *cache.stream;
+}
+
+template<typename Fn>
+void ProfilerSession::for_each_record(Fn&& fn) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& stream : streams_)
+    {
+        stream->for_each(fn);
+    }
+}
+
+template<typename Fn>
+void ProfilerSession::for_each_record_since(EntryCursor& cursor, Fn&& fn) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (cursor.session_id != id_ || cursor.generation != generation_)
+    {
+        cursor.session_id = id_;
+        cursor.generation = generation_;
+        cursor.positions.clear();
+        cursor.entries_read = 0;
+    }
+    cursor.positions.resize(streams_.size(), 0);
+    for (size_t i = 0; i < streams_.size(); ++i)
+    {
+        cursor.positions[i] = streams_[i]->for_each_since(cursor.positions[i], fn);
+    }
+}
+
+ProfileEntry ProfilerSession::materialize(const EventRecord& record, const std::vector<const CallSite*>& sites,
+                                          const std::vector<ThreadDescriptor>& threads) const
+{
+    ProfileEntry entry;
+    if (record.kind == EventKind::Function)
+    {
+        const auto& symbol = FunctionTracer::symbol(record.site_id);
+        entry.name = symbol.name;
+        entry.file = symbol.module;
+    }
+    else if (record.site_id < sites.size() && sites[record.site_id])
+    {
+        const CallSite& site = *sites[record.site_id];
+        entry.name = site.name;
+        entry.file = site.file;
+        entry.line = site.line;
+    }
+    entry.start_ns = start_ns(record);
+    entry.end_ns = end_ns(record);
+    entry.thread_id = thread_of(threads, record);
+    entry.depth = record.depth;
+    entry.sample_weight = static_cast<uint32_t>(record.weight());
+    switch (record.kind)
+    {
+    case EventKind::Function:
+        entry.source = EntrySource::Function;
+        break;
+    case EventKind::Sample:
+        entry.source = EntrySource::Sample;
+        break;
+    default:
+        entry.source = record.flags & EventRecord::flag_nanoseconds ? EntrySource::Recorded : EntrySource::Scope;
+        break;
+    }
+    return entry;
+}
+
+void ProfilerSession::append_entry(const EventRecord& record, StreamReader& reader,
+                                   const std::vector<const CallSite*>& sites, const std::vector<ThreadDescriptor>& threads,
+                                   std::vector<ProfileEntry>& entries) const
+{
+    if (record.kind == EventKind::Metric)
+    {
+        reader.pending.push_back(record);
+        return;
+    }
+    if (!is_entry(record))
+    {
+        reader.pending.clear();
+        return;
+    }
+
+    const size_t index = entries.size();
+    entries.push_back(materialize(record, sites, threads));
+    auto& entry = entries.back();
+    for (const auto& metric : reader.pending)
+    {
+        if (record.kind == EventKind::Scope && metric.site_id == record.site_id)
+        {
+            apply_metric(entry, metric);
+        }
+    }
+    reader.pending.clear();
+
+    if (record.kind == EventKind::Sample)
+    {
+        // Sampled stacks are stored outermost frame first.
+        if (record.depth > 0 && reader.sample_path.size() >= record.depth)
+        {
+            reader.sample_path.resize(record.depth);
+            entry.parent = static_cast<int64_t>(reader.sample_path.back());
+        }
+        else
+        {
+            reader.sample_path.clear();
+        }
+        reader.sample_path.push_back(index);
+        return;
+    }
+    if (!(record.flags & EventRecord::flag_nested))
+    {
+        return;
+    }
+
+    // The scopes nested in this one were read already; its children are the
+    // unparented ones covering that many records. The start check keeps a
+    // scope from adopting earlier siblings when nested records were lost.
+    uint32_t covered = 0;
+    while (covered < record.aux && !reader.open.empty())
+    {
+        const auto [child, nested] = reader.open.back();
+        if (entries[child].start_ns < entry.start_ns)
+        {
+            break;
+        }
+        entries[child].parent = static_cast<int64_t>(index);
+        covered += nested + 1;
+        reader.open.pop_back();
+    }
+    reader.open.emplace_back(index, record.aux);
+}
+
+int64_t ProfilerSession::start_ns(const EventRecord& record) const noexcept
+{
+    if (record.flags & EventRecord::flag_nanoseconds)
+    {
+        return record.start;
+    }
+    return Clock::to_nanoseconds(record.start, calibration_);
+}
+
+int64_t ProfilerSession::end_ns(const EventRecord& record) const noexcept
+{
+    if (record.flags & EventRecord::flag_nanoseconds)
+    {
+        return record.end;
+    }
+    return Clock::to_nanoseconds(record.end, calibration_);
+}
+
 void ProfilerSession::add_entry(ProfileEntry entry)
 {
-    if (active_)
+    if (!is_active())
     {
-        entries_.push_back(std::move(entry));
+        return;
     }
+
+    EventRecord record{};
+    record.start = entry.start_ns;
+    record.end = entry.end_ns;
+    record.site_id = CallSiteRegistry::getInstance().intern(entry.name, entry.file, entry.line);
+    record.depth = static_cast<uint16_t>(entry.depth);
+    record.kind = EventKind::Scope;
+    record.flags = EventRecord::flag_nanoseconds;
+
+    if (options_.recording == RecordingMode::Aggregate)
+    {
+        // Accumulators work in ticks, so only the converted duration is kept.
+        record.start = 0;
+        record.end = Clock::duration_ns_to_ticks(entry.duration_ns(), calibration_);
+        record.flags = 0;
+    }
+
+    // Entries may describe work done on another thread; keep their thread id
+    // rather than stamping the recording thread's index.
+    record.thread_index = ThreadRegistry::getInstance().index_of(entry.thread_id);
+    local_stream().store(record);
 }
 
 void ProfilerSession::add_entry_mt(ProfileEntry entry)
 {
-    if (active_)
+    add_entry(std::move(entry));
+}
+
+void ProfilerSession::add_record(const EventRecord& record)
+{
+    if (is_active())
     {
-        std::lock_guard<std::mutex> lock(mutex_);
-        entries_.push_back(std::move(entry));
+        local_stream().record(record);
+    }
+}
+
+void ProfilerSession::add_sample(const ThreadId thread, const int64_t timestamp, const int64_t period,
+                                 const std::vector<uint32_t>& frame_sites)
+{
+    if (!is_active() || frame_sites.empty())
+    {
+        return;
+    }
+
+    EventRecord record{};
+    record.start = timestamp;
+    record.end = timestamp + period;
+    record.kind = EventKind::Sample;
+    record.thread_index = ThreadRegistry::getInstance().index_of(thread);
+
+    auto& stream = local_stream();
+    const size_t depth = std::min<size_t>(frame_sites.size(), UINT16_MAX);
+    for (size_t i = 0; i < depth; ++i)
+    {
+        record.site_id = frame_sites[frame_sites.size() - 1 - i];
+        record.depth = static_cast<uint16_t>(i);
+        stream.store(record);
     }
 }
 
 std::vector<ProfileEntry> ProfilerSession::get_entries() const
 {
-    return entries_;
+    const auto sites = CallSiteRegistry::getInstance().snapshot();
+    const auto threads = ThreadRegistry::getInstance().snapshot();
+
+    std::vector<ProfileEntry> entries;
+    entries.reserve(entry_count());
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    StreamReader reader;
+    for (const auto& stream : streams_)
+    {
+        reader.reset();
+        stream->for_each([this, &reader, &entries, &sites, &threads](const EventRecord& record)
+        {
+            append_entry(record, reader, sites, threads, entries);
+        });
+    }
+    return entries;
 }
 
 std::vector<ProfileEntry> ProfilerSession::get_entries_mt() const
 {
+    return get_entries();
+}
+
+std::vector<ProfileEntry> ProfilerSession::get_entries_since(EntryCursor& cursor) const
+{
+    const auto sites = CallSiteRegistry::getInstance().snapshot();
+    const auto threads = ThreadRegistry::getInstance().snapshot();
+
     std::lock_guard<std::mutex> lock(mutex_);
-    return entries_;
+    if (cursor.session_id != id_ || cursor.generation != generation_)
+    {
+        cursor.session_id = id_;
+        cursor.generation = generation_;
+        cursor.positions.clear();
+        cursor.entries_read = 0;
+    }
+    cursor.positions.resize(streams_.size(), 0);
+
+    std::vector<ProfileEntry> entries;
+    // Scopes whose parent ends after this read keep parent == -1.
+    StreamReader reader;
+    for (size_t i = 0; i < streams_.size(); ++i)
+    {
+        reader.reset();
+        const uint64_t end = streams_[i]->for_each_since(cursor.positions[i],
+            [this, &reader, &entries, &sites, &threads](const EventRecord& record)
+            {
+                append_entry(record, reader, sites, threads, entries);
+            });
+        // Metrics whose scope is not written yet are read again next time.
+        cursor.positions[i] = end - reader.pending.size();
+    }
+
+    for (auto& entry : entries)
+    {
+        if (entry.parent >= 0)
+        {
+            entry.parent += static_cast<int64_t>(cursor.entries_read);
+        }
+    }
+    cursor.entries_read += entries.size();
+    return entries;
 }
 
-std::map<ThreadId, ThreadInfo> ProfilerSession::get_thread_info() const
+std::vector<FrameMark> ProfilerSession::get_frame_marks() const
+{
+    EntryCursor cursor;
+    return get_frame_marks(cursor);
+}
+
+std::vector<FrameMark> ProfilerSession::get_frame_marks(EntryCursor& cursor) const
+{
+    const auto sites = CallSiteRegistry::getInstance().snapshot();
+    const auto threads = ThreadRegistry::getInstance().snapshot();
+
+    std::vector<FrameMark> marks;
+    for_each_record_since(cursor, [this, &marks, &sites, &threads](const EventRecord& record)
+    {
+        if (record.kind != EventKind::Frame)
+        {
+            return;
+        }
+        FrameMark mark;
+        if (record.site_id < sites.size() && sites[record.site_id])
+        {
+            mark.name = sites[record.site_id]->name;
+        }
+        mark.thread_id = thread_of(threads, record);
+        mark.time_ns = start_ns(record);
+        marks.push_back(std::move(mark));
+    });
+
+    std::ranges::stable_sort(marks, {}, &FrameMark::time_ns);
+    cursor.entries_read += marks.size();
+    return marks;
+}
+
+std::vector<CounterSample> ProfilerSession::get_counter_samples() const
+{
+    EntryCursor cursor;
+    return get_counter_samples(cursor);
+}
+
+std::vector<CounterSample> ProfilerSession::get_counter_samples(EntryCursor& cursor) const
+{
+    const auto sites = CallSiteRegistry::getInstance().snapshot();
+    const auto threads = ThreadRegistry::getInstance().snapshot();
+
+    std::vector<CounterSample> samples;
+    for_each_record_since(cursor, [this, &samples, &sites, &threads](const EventRecord& record)
+    {
+        if (record.kind != EventKind::Counter)
+        {
+            return;
+        }
+        CounterSample sample;
+        if (record.site_id < sites.size() && sites[record.site_id])
+        {
+            sample.name = sites[record.site_id]->name;
+        }
+        sample.thread_id = thread_of(threads, record);
+        sample.time_ns = Clock::to_nanoseconds(record.start, calibration_);
+        sample.value = record.counter_value();
+        samples.push_back(std::move(sample));
+    });
+
+    std::ranges::stable_sort(samples, {}, &CounterSample::time_ns);
+    cursor.entries_read += samples.size();
+    return samples;
+}
+
+std::vector<AsyncSpan> ProfilerSession::get_async_spans() const
+{
+    const auto sites = CallSiteRegistry::getInstance().snapshot();
+    auto site_name = [&sites](const uint32_t site_id)
+    {
+        return site_id < sites.size() && sites[site_id] ? std::string(sites[site_id]->name) : std::string();
+    };
+
+    // Events of one span come from several threads, so order them by time first.
+    std::vector<EventRecord> events;
+    for_each_record([&events](const EventRecord& record)
+    {
+        if (record.kind == EventKind::AsyncBegin || record.kind == EventKind::AsyncStep || record.kind == EventKind::AsyncEnd)
+        {
+            events.push_back(record);
+        }
+    });
+    // Taken after reading: the registry only grows, so it covers every event.
+    const auto threads = ThreadRegistry::getInstance().snapshot();
+    std::ranges::stable_sort(events, {}, &EventRecord::start);
+
+    std::vector<AsyncSpan> spans;
+    std::map<uint64_t, size_t> open;
+    for (const auto& record : events)
+    {
+        const uint64_t id = record.async_id();
+        const int64_t time_ns = Clock::to_nanoseconds(record.start, calibration_);
+
+        if (record.kind == EventKind::AsyncBegin)
+        {
+            AsyncSpan span;
+            span.id = id;
+            span.name = site_name(record.site_id);
+            span.begin_thread = thread_of(threads, record);
+            span.begin_ns = time_ns;
+            open[id] = spans.size();
+            spans.push_back(std::move(span));
+            continue;
+        }
+
+        const auto it = open.find(id);
+        if (it == open.end())
+        {
+            continue;
+        }
+
+        AsyncSpan& span = spans[it->second];
+        if (record.kind == EventKind::AsyncStep)
+        {
+            span.steps.push_back({site_name(record.site_id), thread_of(threads, record), time_ns});
+        }
+        else
+        {
+            span.end_thread = thread_of(threads, record);
+            span.end_ns = time_ns;
+            span.complete = true;
+            open.erase(it);
+        }
+    }
+    return spans;
+}
+
+std::vector<LockEvent> ProfilerSession::get_lock_events() const
+{
+    const auto sites = CallSiteRegistry::getInstance().snapshot();
+    const auto threads = ThreadRegistry::getInstance().snapshot();
+
+    std::vector<LockEvent> events;
+    for_each_record([this, &events, &sites, &threads](const EventRecord& record)
+    {
+        if (record.kind != EventKind::LockWait && record.kind != EventKind::LockHold)
+        {
+            return;
+        }
+        LockEvent event;
+        event.kind = record.kind == EventKind::LockWait ? LockEvent::Kind::Wait : LockEvent::Kind::Hold;
+        event.shared = record.aux != 0;
+        if (record.site_id < sites.size() && sites[record.site_id])
+        {
+            event.name = sites[record.site_id]->name;
+            event.file = sites[record.site_id]->file;
+            event.line = sites[record.site_id]->line;
+        }
+        event.thread_id = thread_of(threads, record);
+        event.start_ns = start_ns(record);
+        event.end_ns = end_ns(record);
+        events.push_back(std::move(event));
+    });
+
+    std::ranges::stable_sort(events, {}, &LockEvent::start_ns);
+    return events;
+}
+
+std::vector<OpenScope> ProfilerSession::get_open_scopes() const
+{
+    if (!options_.track_open_scopes && options_.open_scope_budget_ns <= 0)
+    {
+        return {};
+    }
+
+    const auto records = OpenScopeTable::getInstance().snapshot();
+    const int64_t now = Clock::ticks();
+    const auto sites = CallSiteRegistry::getInstance().snapshot();
+    const auto threads = ThreadRegistry::getInstance().snapshot();
+
+    std::vector<OpenScope> scopes;
+    scopes.reserve(records.size());
+    for (const auto& record : records)
+    {
+        OpenScope scope;
+        if (record.site_id < sites.size() && sites[record.site_id])
+        {
+            scope.name = sites[record.site_id]->name;
+            scope.file = sites[record.site_id]->file;
+            scope.line = sites[record.site_id]->line;
+        }
+        if (record.thread_index < threads.size())
+        {
+            scope.thread_id = threads[record.thread_index].id;
+            scope.thread_name = threads[record.thread_index].name;
+        }
+        scope.depth = record.depth;
+        scope.start_ns = Clock::to_nanoseconds(record.start_ticks, calibration_);
+        scope.elapsed_ns = Clock::ticks_to_duration_ns(std::max<int64_t>(now - record.start_ticks, 0), calibration_);
+        scopes.push_back(std::move(scope));
+    }
+    return scopes;
+}
+
+std::vector<OpenScope> ProfilerSession::get_scope_overruns() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return overruns_;
+}
+
+void ProfilerSession::add_scope_overrun(OpenScope overrun)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    overruns_.push_back(std::move(overrun));
+}
+
+void ProfilerSession::collect_budget_violations() const
+{
+    for (const auto& stream : streams_)
+    {
+        for (auto& violation : stream->budget_violations.take_all())
+        {
+            if (options_.on_budget_violation && pending_violations_.size() < max_pending_violations)
+            {
+                pending_violations_.push_back(violation);
+            }
+
+            auto& worst = budget_sites_[violation.site_id];
+            if (worst.size() >= options_.budget_worst_count)
+            {
+                if (worst.empty() || violation.duration_ticks <= worst.back().duration_ticks)
+                {
+                    continue;
+                }
+                worst.pop_back();
+            }
+            const auto slower = std::ranges::upper_bound(worst, violation.duration_ticks, std::ranges::greater{},
+                                                         &BudgetViolationRecord::duration_ticks);
+            worst.insert(slower, std::move(violation));
+        }
+    }
+}
+
+std::vector<BudgetSiteStats> ProfilerSession::get_budget_stats() const
 {
+    const auto sites = CallSiteRegistry::getInstance().snapshot();
+    const auto threads = ThreadRegistry::getInstance().snapshot();
+
+    std::vector<BudgetSiteStats> stats;
     std::lock_guard<std::mutex> lock(mutex_);
+    collect_budget_violations();
+    for (uint32_t site_id = 0; site_id < sites.size(); ++site_id)
+    {
+        const CallSite* site = sites[site_id];
+        if (!site)
+        {
+            continue;
+        }
+        uint64_t violations = site->budget_violations();
+        if (const auto baseline = budget_baseline_.find(site_id); baseline != budget_baseline_.end())
+        {
+            violations -= baseline->second;
+        }
+        if (violations == 0)
+        {
+            continue;
+        }
+        BudgetSiteStats site_stats;
+        site_stats.name = site->name;
+        site_stats.file = site->file;
+        site_stats.line = site->line;
+        site_stats.budget_ns = site->budget_ns;
+        site_stats.violations = violations;
+        if (const auto worst = budget_sites_.find(site_id); worst != budget_sites_.end())
+        {
+            for (const auto& violation : worst->second)
+            {
+                site_stats.worst.push_back(resolve(violation, sites, threads));
+            }
+        }
+        stats.push_back(std::move(site_stats));
+    }
+    std::ranges::stable_sort(stats, std::ranges::greater{}, &BudgetSiteStats::violations);
+    return stats;
+}
+
+std::vector<BudgetViolation> ProfilerSession::take_budget_violations()
+{
+    std::vector<BudgetViolationRecord> pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        collect_budget_violations();
+        pending.swap(pending_violations_);
+    }
+    if (pending.empty())
+    {
+        return {};
+    }
+
+    const auto sites = CallSiteRegistry::getInstance().snapshot();
+    const auto threads = ThreadRegistry::getInstance().snapshot();
+    std::vector<BudgetViolation> violations;
+    violations.reserve(pending.size());
+    for (const auto& record : pending)
+    {
+        violations.push_back(resolve(record, sites, threads));
+    }
+    return violations;
+}
+
+BudgetViolation ProfilerSession::resolve(const BudgetViolationRecord& record, const std::vector<const CallSite*>& sites,
+                                         const std::vector<ThreadDescriptor>& threads) const
+{
+    auto site_of = [&sites](const uint32_t site_id) -> const CallSite*
+    {
+        return site_id < sites.size() ? sites[site_id] : nullptr;
+    };
+
+    BudgetViolation violation;
+    if (const CallSite* site = site_of(record.site_id))
+    {
+        violation.name = site->name;
+        violation.file = site->file;
+        violation.line = site->line;
+        violation.budget_ns = site->budget_ns;
+    }
+    if (record.thread_index < threads.size())
+    {
+        violation.thread_id = threads[record.thread_index].id;
+        violation.thread_name = threads[record.thread_index].name;
+    }
+    violation.start_ns = Clock::to_nanoseconds(record.start_ticks, calibration_);
+    violation.duration_ns = Clock::ticks_to_duration_ns(record.duration_ticks, calibration_);
+    for (const auto& child_record : record.children)
+    {
+        BudgetChild child;
+        if (const CallSite* site = site_of(child_record.site_id))
+        {
+            child.name = site->name;
+        }
+        child.count = child_record.count;
+        child.total_ns = Clock::ticks_to_duration_ns(child_record.total_ticks, calibration_);
+        violation.children.push_back(std::move(child));
+    }
+    std::ranges::stable_sort(violation.children, std::ranges::greater{}, &BudgetChild::total_ns);
+    return violation;
+}
+
+std::map<ThreadId, ThreadInfo> ProfilerSession::get_thread_info() const
+{
+    const auto threads = ThreadRegistry::getInstance().snapshot();
     std::map<ThreadId, ThreadInfo> thread_map;
     
-    for (const auto& entry : entries_)
+    // Perf metric records precede the scope that read the counters.
+    bool read_perf = false;
+    for_each_record([this, &thread_map, &threads, &read_perf](const EventRecord& record)
     {
-        auto& info = thread_map[entry.thread_id];
-        info.id = entry.thread_id;
-        info.total_time_ns += entry.duration_ns();
+        if (record.kind == EventKind::Metric)
+        {
+            read_perf |= record.metric == MetricKind::PerfSoftware || record.metric == MetricKind::PerfHardware;
+            return;
+        }
+        const bool scope_read_perf = std::exchange(read_perf, false);
+        if (!is_entry(record))
+        {
+            return;
+        }
+        const ThreadId thread = thread_of(threads, record);
+        auto& info = thread_map[thread];
+        info.id = thread;
+        if (record.thread_index < threads.size() && !threads[record.thread_index].name.empty())
+        {
+            info.name = threads[record.thread_index].name;
+        }
+        info.total_time_ns += end_ns(record) - start_ns(record);
         info.entry_count++;
-    }
+        if (record.kind == EventKind::Scope)
+        {
+            info.overhead_ns += static_cast<uint64_t>(scope_read_perf ? overhead_.perf_total_ns : overhead_.total_ns);
+        }
+    });
     
     return thread_map;
 }
@@ -69,10 +805,9 @@ std::map<ThreadId, ThreadInfo> ProfilerSession::get_thread_info() const
 std::map<std::string, uint64_t> ProfilerSession::get_memory_usage() const
 {
 #if defined(__linux__) || defined(__APPLE__)
-    std::lock_guard<std::mutex> lock(mutex_);
     std::map<std::string, uint64_t> memory_map;
 
-    for (const auto& entry : entries_)
+    for (const auto& entry : get_entries())
     {
         memory_map[entry.name] += entry.memory_used;
     }
@@ -85,29 +820,222 @@ std::map<std::string, uint64_t> ProfilerSession::get_memory_usage() const
 std::map<std::string, double> ProfilerSession::get_cpu_usage() const
 {
 #if defined(__linux__) || defined(__APPLE__)
-    std::lock_guard<std::mutex> lock(mutex_);
-    std::map<std::string, double> cpu_map;
-
-    for (const auto& entry : entries_)
+    // Weighted by duration: total CPU time over total wall time per name.
+    std::map<std::string, std::pair<int64_t, int64_t>> totals;
+    for (const auto& entry : get_entries())
     {
-        cpu_map[entry.name] += entry.cpu_usage;
+        if (entry.cpu_time_ns > 0)
+        {
+            auto& [cpu_ns, wall_ns] = totals[entry.name];
+            cpu_ns += entry.cpu_time_ns;
+            wall_ns += entry.duration_ns();
+        }
     }
 
+    std::map<std::string, double> cpu_map;
+    for (const auto& [name, total] : totals)
+    {
+        cpu_map[name] = total.second > 0 ? 100.0 * static_cast<double>(total.first) / static_cast<double>(total.second) : 0.0;
+    }
     return cpu_map;
 #endif
     return {};
 }
 
-void ProfilerSession::clear()
+std::vector<CallSiteStats> ProfilerSession::get_site_stats() const
+{
+    return site_stats(true);
+}
+
+std::vector<CallSiteStats> ProfilerSession::get_accumulated_stats() const
+{
+    return site_stats(false);
+}
+
+std::vector<CallSiteStats> ProfilerSession::site_stats(const bool with_events) const
+{
+    const auto sites = CallSiteRegistry::getInstance().snapshot();
+
+    std::vector<CallSiteStats> by_site(sites.size());
+    auto merge = [&by_site](const uint32_t site_id, const uint64_t count, const int64_t total,
+                            const int64_t min, const int64_t max, const auto& histogram)
+    {
+        if (site_id >= by_site.size())
+        {
+            by_site.resize(site_id + 1);
+        }
+        auto& stats = by_site[site_id];
+        stats.count += count;
+        stats.total_ns += total;
+        stats.min_ns = std::min(stats.min_ns, min);
+        stats.max_ns = std::max(stats.max_ns, max);
+        for (size_t bucket = 0; bucket < latency_bucket_count; ++bucket)
+        {
+            stats.histogram[bucket] += histogram[bucket];
+        }
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& stream : streams_)
+        {
+            // Outside Aggregate mode, accumulators hold only folded scopes.
+            const bool folded = options_.recording != RecordingMode::Aggregate;
+            stream->accumulators.for_each([&merge, &by_site, folded](const uint32_t site_id, const SiteAccumulator& accumulator)
+            {
+                std::array<uint64_t, latency_bucket_count> histogram{};
+                for (size_t bucket = 0; bucket < latency_bucket_count; ++bucket)
+                {
+                    histogram[bucket] = accumulator.histogram[bucket].load(std::memory_order_relaxed);
+                }
+                const uint64_t count = accumulator.count.load(std::memory_order_relaxed);
+                const int64_t total = accumulator.total.load(std::memory_order_relaxed);
+                merge(site_id,
+                      count,
+                      total,
+                      accumulator.min.load(std::memory_order_relaxed),
+                      accumulator.max.load(std::memory_order_relaxed),
+                      histogram);
+                if (folded)
+                {
+                    by_site[site_id].folded_count += count;
+                    by_site[site_id].folded_total_ns += total;
+                }
+            });
+
+            if (!with_events)
+            {
+                continue;
+            }
+            stream->for_each([this, &merge](const EventRecord& record)
+            {
+                if (record.kind != EventKind::Scope)
+                {
+                    return;
+                }
+                int64_t ticks = record.duration();
+                if (record.flags & EventRecord::flag_nanoseconds)
+                {
+                    ticks = Clock::duration_ns_to_ticks(ticks, calibration_);
+                }
+                const uint64_t weight = record.weight();
+                std::array<uint64_t, latency_bucket_count> histogram{};
+                histogram[latency_bucket(ticks)] = weight;
+                merge(record.site_id, weight, ticks * static_cast<int64_t>(weight), ticks, ticks, histogram);
+            });
+        }
+    }
+
+    // Totals were merged in ticks; convert once per site.
+    std::vector<CallSiteStats> result;
+    for (uint32_t site_id = 0; site_id < by_site.size(); ++site_id)
+    {
+        auto& stats = by_site[site_id];
+        if (stats.count == 0)
+        {
+            continue;
+        }
+        stats.site_id = site_id;
+        if (site_id < sites.size() && sites[site_id])
+        {
+            stats.name = sites[site_id]->name;
+            stats.file = sites[site_id]->file;
+            stats.line = sites[site_id]->line;
+        }
+        stats.total_ns = Clock::ticks_to_duration_ns(stats.total_ns, calibration_);
+        stats.folded_total_ns = Clock::ticks_to_duration_ns(stats.folded_total_ns, calibration_);
+        stats.min_ns = Clock::ticks_to_duration_ns(stats.min_ns, calibration_);
+        stats.max_ns = Clock::ticks_to_duration_ns(stats.max_ns, calibration_);
+        stats.ns_per_tick = calibration_.source == ClockSource::System ? 1.0 : calibration_.ns_per_tick;
+        result.push_back(std::move(stats));
+    }
+    return result;
+}
+
+void ProfilerSession::add_throttle(const uint32_t site_id, const uint32_t sample_shift)
 {
     std::lock_guard<std::mutex> lock(mutex_);
-    entries_.clear();
+    auto& shift = max_sample_shifts_[site_id];
+    shift = std::max(shift, sample_shift);
+}
+
+std::vector<ThrottledSite> ProfilerSession::get_throttled_sites() const
+{
+    std::map<uint32_t, uint32_t> shifts;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        shifts = max_sample_shifts_;
+    }
+
+    const auto& registry = CallSiteRegistry::getInstance();
+    std::vector<ThrottledSite> result;
+    for (const auto& [site_id, shift] : shifts)
+    {
+        ThrottledSite throttled;
+        throttled.site_id = site_id;
+        throttled.max_sample_every = 1u << shift;
+        if (const CallSite* site = registry.find(site_id))
+        {
+            throttled.name = site->name;
+            throttled.file = site->file;
+            throttled.line = site->line;
+        }
+        result.push_back(std::move(throttled));
+    }
+    return result;
+}
+
+void ProfilerSession::clear()
+{
+    // Streams are released after the lock is dropped; their chunks go back to
+    // the pool, which costs one step per chunk rather than per event.
+    std::vector<std::shared_ptr<ThreadStream>> retired;
+    const auto sites = CallSiteRegistry::getInstance().snapshot();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& stream : streams_)
+        {
+            stream->retired.store(true, std::memory_order_release);
+        }
+        retired.swap(streams_);
+
+        // Everything derived from the cleared events goes with them.
+        overruns_.clear();
+        max_sample_shifts_.clear();
+        budget_sites_.clear();
+        pending_violations_.clear();
+        budget_baseline_.clear();
+        for (uint32_t site_id = 0; site_id < sites.size(); ++site_id)
+        {
+            if (sites[site_id] && sites[site_id]->budget_violations() != 0)
+            {
+                budget_baseline_[site_id] = sites[site_id]->budget_violations();
+            }
+        }
+        ++generation_;
+    }
 }
 
 size_t ProfilerSession::entry_count() const
 {
     std::lock_guard<std::mutex> lock(mutex_);
-    return entries_.size();
+    size_t count = 0;
+    for (const auto& stream : streams_)
+    {
+        count += stream->size();
+    }
+    return count;
+}
+
+uint64_t ProfilerSession::dropped_events() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t dropped = 0;
+    for (const auto& stream : streams_)
+    {
+        dropped += stream->dropped();
+    }
+    return dropped;
 }
 
 void ProfilerSession::end()
@@ -0,0 +1,46 @@
+#include "runscope/core/scope_budget.hpp"
+#include <algorithm>
+#include <utility>
+
+using namespace runscope::core;
+
+BudgetViolationQueue::~BudgetViolationQueue()
+{
+    Node* node = head_.exchange(nullptr, std::memory_order_acquire);
+    while (node)
+    {
+        delete std::exchange(node, node->next);
+    }
+}
+
+bool BudgetViolationQueue::push(BudgetViolationRecord record)
+{
+    if (size_.load(std::memory_order_relaxed) >= capacity)
+    {
+        return false;
+    }
+    size_.fetch_add(1, std::memory_order_relaxed);
+
+    // Pushed as a stack: a taker swaps out the whole list, so no node is ever
+    // unlinked on its own and there is no ABA problem.
+    auto* node = new Node{std::move(record)};
+    node->next = head_.load(std::memory_order_relaxed);
+    while (!head_.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed))
+    {
+    }
+    return true;
+}
+
+std::vector<BudgetViolationRecord> BudgetViolationQueue::take_all()
+{
+    Node* node = head_.exchange(nullptr, std::memory_order_acquire);
+    std::vector<BudgetViolationRecord> records;
+    while (node)
+    {
+        records.push_back(std::move(node->record));
+        delete std::exchange(node, node->next);
+    }
+    size_.fetch_sub(static_cast<uint32_t>(records.size()), std::memory_order_relaxed);
+    std::ranges::reverse(records);
+    return records;
+}
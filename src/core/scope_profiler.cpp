@@ -1,35 +1,393 @@
 #include "runscope/core/scope_profiler.hpp"
-#include <thread>
+#include "runscope/core/open_scopes.hpp"
+#include "runscope/core/scope_budget.hpp"
+#include "runscope/core/thread_registry.hpp"
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
 
 using namespace runscope::core;
 
+namespace
+{
+    // Direct children of the budgeted scopes open on this thread, innermost
+    // last. Frames are reused, so their child lists keep their capacity.
+    struct BudgetFrame
+    {
+        int depth{0};
+        std::vector<BudgetChildRecord> children;
+    };
+
+    std::vector<BudgetFrame>& budget_frames()
+    {
+        thread_local std::vector<BudgetFrame> frames;
+        return frames;
+    }
+
+    // Kept apart from the frames so that every scope's check is a plain
+    // thread-local load.
+    size_t& open_budget_frames()
+    {
+        thread_local constinit size_t open = 0;
+        return open;
+    }
+
+    // Per-thread memo of dynamic sites, direct-mapped by name and line. Names
+    // are compared by content, since a runtime name's buffer may be reused
+    // for another name; the file is a __FILE__ literal.
+    struct DynamicSiteSlot
+    {
+        std::string name;
+        const char* file{nullptr};
+        int line{0};
+        uint32_t id{0};
+    };
+
+    constexpr size_t dynamic_site_slots = 64;
+
+    uint32_t dynamic_site_id(const std::string_view name, const char* file, const int line)
+    {
+        thread_local std::array<DynamicSiteSlot, dynamic_site_slots> slots;
+        const size_t hash = std::hash<std::string_view>{}(name) ^ static_cast<size_t>(line) * 0x9E3779B97F4A7C15ull;
+        DynamicSiteSlot& slot = slots[hash % dynamic_site_slots];
+        if (slot.id == 0 || slot.file != file || slot.line != line || slot.name != name)
+        {
+            slot.id = CallSiteRegistry::getInstance().intern(name, file, line);
+            slot.name.assign(name);
+            slot.file = file;
+            slot.line = line;
+        }
+        return slot.id;
+    }
+}
+
 ScopeProfiler::ScopeProfiler(const std::string_view name, const char* file, const int line)
-    : name_(name)
-    , file_(file)
-    , line_(line)
-    , start_time_(Clock::now())
-    , depth_(get_depth())
 {
+    if (ProfilerEngine::category_enabled(category::General))
+    {
+        // Covers the memo's first use on a thread too: registering its
+        // destructor allocates inside the C library.
+        const AllocTracker::Pause pause;
+        begin(dynamic_site_id(name, file, line), category::General);
+    }
+}
+
+bool ScopeProfiler::sampled(const uint32_t shift) noexcept
+{
+    // xorshift64: per-thread, so throttled sites share no counter between
+    // threads, and random, so sites called in lockstep are not aliased.
+    thread_local uint64_t state = 0;
+    if (state == 0)
+    {
+        state = static_cast<uint64_t>(Clock::ticks()) | 1;
+    }
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return (state & ((uint64_t{1} << shift) - 1)) == 0;
+}
+
+void ScopeProfiler::update_throttle(const CallSite& site) noexcept
+{
+    struct Window
+    {
+        uint32_t timed;
+        int64_t start;
+    };
+    thread_local Window window{0, 0};
+    if (++window.timed < throttle_interval)
+    {
+        return;
+    }
+
+    const int64_t now = Clock::ticks();
+    const int64_t elapsed = now - window.start;
+    window = {0, now};
+
+    const int64_t budget = ProfilerEngine::scope_budget_ticks() * throttle_interval;
+    if (budget == 0)
+    {
+        return;
+    }
+
+    const uint32_t shift = site.sample_shift();
+    if (elapsed < budget && shift < EventRecord::max_sample_shift)
+    {
+        site.set_sample_shift(shift + 1);
+        ProfilerEngine::getInstance().record_throttle(site.id(), shift + 1);
+    }
+    else if (elapsed > 4 * budget && shift > 0)
+    {
+        site.set_sample_shift(shift - 1);
+    }
+}
+
+void ScopeProfiler::begin(const uint32_t site_id, const uint32_t categories, const uint32_t sample_shift,
+                          const CallSite* site) noexcept
+{
+    // Counters are read inside, but nothing the profiler allocates for its
+    // own bookkeeping is counted.
+    const AllocTracker::Pause pause;
+
+    if (site && site->budget_ns > 0)
+    {
+        budget_site_ = site;
+    }
+    else if (site && ProfilerEngine::scope_budget_ticks() != 0)
+    {
+        // Without an overhead budget the window is never looked at, so
+        // unthrottled sessions skip its thread_local altogether.
+        update_throttle(*site);
+    }
+
+    site_id_ = site_id;
+    sample_shift_ = sample_shift;
+    depth_ = get_depth();
     increment_depth();
+    ended_at_begin_ = scopes_ended_ref();
+
+    if (budget_site_)
+    {
+        std::vector<BudgetFrame>& frames = budget_frames();
+        size_t& open = open_budget_frames();
+        if (open == frames.size())
+        {
+            frames.emplace_back();
+        }
+        BudgetFrame& frame = frames[open++];
+        frame.depth = depth_;
+        frame.children.clear();
+    }
+
+    if (AllocTracker::installed())
+    {
+        const AllocCounters& counters = AllocTracker::local();
+        track_allocations_ = true;
+        alloc_bytes_start_ = counters.allocated_bytes;
+        alloc_count_start_ = counters.allocations;
+        parent_child_alloc_bytes_ = std::exchange(child_alloc_bytes_ref(), 0);
+    }
+
+    start_ticks_ = Clock::ticks();
+
+    if (ProfilerEngine::open_scopes_enabled())
+    {
+        OpenScopeTable::push(site_id, start_ticks_);
+        track_open_ = true;
+    }
+
+    // Read inside the wall-clock interval so the clock reads themselves are
+    // not charged as CPU time the scope did not have.
+    if (ProfilerEngine::cpu_time_enabled())
+    {
+        cpu_start_ns_ = Clock::thread_cpu_nanoseconds();
+    }
+
+    if (ProfilerEngine::perf_counters_enabled(categories) && depth_ < max_perf_depth)
+    {
+        track_perf_ = platform::PerfCounters::read(perf_slot(depth_));
+    }
 }
 
-ScopeProfiler::~ScopeProfiler()
+void ScopeProfiler::end() noexcept
 {
-    const auto end_time = Clock::now();
-    
-    ProfileEntry entry;
-    entry.name = name_;
-    entry.file = file_;
-    entry.line = line_;
-    entry.start_ns = Clock::to_nanoseconds(start_time_);
-    entry.end_ns = Clock::to_nanoseconds(end_time);
-    entry.thread_id = std::this_thread::get_id();
-    entry.depth = depth_;
-    entry.memory_used = 0;
-    entry.cpu_usage = 0.0;
+    const AllocTracker::Pause pause;
+    platform::PerfSnapshot perf_end;
+    const bool perf_read = track_perf_ && platform::PerfCounters::read(perf_end);
+    const int64_t cpu_end_ns = cpu_start_ns_ >= 0 ? Clock::thread_cpu_nanoseconds() : 0;
+    const int64_t end_ticks = Clock::ticks();
+    if (track_open_)
+    {
+        OpenScopeTable::pop();
+    }
+
+    // Short scopes only feed their site's counters: no metrics, and no place
+    // in the parent's nested count, so the parent's own record is unaffected.
+    const bool folded = end_ticks - start_ticks_ < ProfilerEngine::entry_threshold_ticks();
+
+    if (track_allocations_)
+    {
+        // Self bytes exclude what finished children allocated; this scope's
+        // total is then handed up to its parent's child sum.
+        const AllocCounters& counters = AllocTracker::local();
+        const uint64_t bytes = counters.allocated_bytes - alloc_bytes_start_;
+        const uint64_t count = counters.allocations - alloc_count_start_;
+        uint64_t& child_bytes = child_alloc_bytes_ref();
+
+        const uint64_t self_bytes = bytes - child_bytes;
+        child_bytes = parent_child_alloc_bytes_ + bytes;
+
+        // Scopes that allocated nothing cost no extra record. Otherwise the
+        // metric goes first, so a reader never sees the scope without it.
+        if (count != 0 && !folded)
+        {
+            EventRecord metric{};
+            metric.start = static_cast<int64_t>(bytes);
+            metric.end = static_cast<int64_t>(self_bytes);
+            metric.site_id = site_id_;
+            metric.kind = EventKind::Metric;
+            metric.metric = MetricKind::Allocations;
+            metric.aux = static_cast<uint32_t>(std::min<uint64_t>(count, UINT32_MAX));
+            ProfilerEngine::getInstance().record_event(metric);
+        }
+    }
+
+    if (cpu_start_ns_ >= 0 && !folded)
+    {
+        EventRecord metric{};
+        metric.start = cpu_end_ns - cpu_start_ns_;
+        metric.site_id = site_id_;
+        metric.kind = EventKind::Metric;
+        metric.metric = MetricKind::CpuTime;
+        ProfilerEngine::getInstance().record_event(metric);
+    }
 
-    ProfilerEngine::getInstance().record_entry(std::move(entry));
+    if (perf_read && !folded)
+    {
+        const platform::PerfDelta delta = platform::PerfCounters::delta(perf_slot(depth_), perf_end);
+        auto saturated = [](const uint64_t value)
+        {
+            return static_cast<uint32_t>(std::min<uint64_t>(value, UINT32_MAX));
+        };
+
+        EventRecord metric{};
+        metric.site_id = site_id_;
+        metric.kind = EventKind::Metric;
+        if (delta.software)
+        {
+            metric.metric = MetricKind::PerfSoftware;
+            metric.start = static_cast<int64_t>(delta[platform::PerfCounter::TaskClock]);
+            metric.end = static_cast<int64_t>(delta[platform::PerfCounter::PageFaults]);
+            metric.aux = saturated(delta[platform::PerfCounter::ContextSwitches]);
+            ProfilerEngine::getInstance().record_event(metric);
+        }
+        if (delta.hardware)
+        {
+            metric.metric = MetricKind::PerfHardware;
+            metric.start = static_cast<int64_t>(delta[platform::PerfCounter::Cycles]);
+            metric.end = static_cast<int64_t>(delta[platform::PerfCounter::Instructions]);
+            metric.aux = saturated(delta[platform::PerfCounter::CacheMisses]);
+            ProfilerEngine::getInstance().record_event(metric);
+        }
+    }
+
+    EventRecord record{};
+    record.end = end_ticks;
+    record.start = start_ticks_;
+    record.site_id = site_id_;
+    record.depth = static_cast<uint16_t>(depth_);
+    record.kind = EventKind::Scope;
+    if (folded)
+    {
+        record.flags = EventRecord::flag_folded;
+    }
+    else
+    {
+        record.flags = EventRecord::flag_nested;
+        uint32_t& scopes_ended = scopes_ended_ref();
+        record.aux = scopes_ended - ended_at_begin_;
+        ++scopes_ended;
+    }
+    record.set_sample_shift(sample_shift_);
+
+    ProfilerEngine::getInstance().record_event(record);
     decrement_depth();
+
+    const int64_t duration_ticks = end_ticks - start_ticks_;
+    if (budget_site_)
+    {
+        if (ProfilerEngine::ticks_to_ns(duration_ticks) > budget_site_->budget_ns)
+        {
+            report_budget_violation(duration_ticks);
+        }
+        --open_budget_frames();
+    }
+
+    // Scopes directly inside a budgeted scope add their time to its frame.
+    if (const size_t open = open_budget_frames(); open != 0)
+    {
+        BudgetFrame& frame = budget_frames()[open - 1];
+        if (frame.depth == depth_ - 1)
+        {
+            auto child = std::ranges::find(frame.children, site_id_, &BudgetChildRecord::site_id);
+            if (child == frame.children.end())
+            {
+                child = frame.children.insert(child, BudgetChildRecord{site_id_, 0, 0});
+            }
+            child->count += 1u << sample_shift_;
+            child->total_ticks += duration_ticks << sample_shift_;
+        }
+    }
+}
+
+void ScopeProfiler::report_budget_violation(const int64_t duration_ticks) noexcept
+{
+    BudgetFrame& frame = budget_frames()[open_budget_frames() - 1];
+
+    budget_site_->count_budget_violation();
+
+    // Copied, so the frame keeps its capacity for the next scope.
+    BudgetViolationRecord violation;
+    violation.site_id = site_id_;
+    violation.thread_index = ThreadRegistry::current_index();
+    violation.start_ticks = start_ticks_;
+    violation.duration_ticks = duration_ticks;
+    violation.children = frame.children;
+    ProfilerEngine::getInstance().record_budget_violation(std::move(violation));
+}
+
+void runscope::core::mark_frame(const CallSite& site) noexcept
+{
+    EventRecord record{};
+    record.start = Clock::ticks();
+    record.end = record.start;
+    record.site_id = site.id();
+    record.kind = EventKind::Frame;
+
+    ProfilerEngine::getInstance().record_event(record);
+}
+
+void runscope::core::record_counter(const CallSite& site, const double value) noexcept
+{
+    EventRecord record{};
+    record.start = Clock::ticks();
+    record.set_counter_value(value);
+    record.site_id = site.id();
+    record.kind = EventKind::Counter;
+
+    ProfilerEngine::getInstance().record_event(record);
+}
+
+void runscope::core::record_async(const CallSite& site, const EventKind kind, const uint64_t id) noexcept
+{
+    EventRecord record{};
+    record.start = Clock::ticks();
+    record.set_async_id(id);
+    record.site_id = site.id();
+    record.kind = kind;
+
+    ProfilerEngine::getInstance().record_event(record);
+}
+
+runscope::platform::PerfSnapshot& ScopeProfiler::perf_slot(const int depth)
+{
+    thread_local std::array<platform::PerfSnapshot, max_perf_depth> slots;
+    return slots[static_cast<size_t>(depth)];
+}
+
+uint64_t& ScopeProfiler::child_alloc_bytes_ref()
+{
+    thread_local uint64_t bytes = 0;
+    return bytes;
+}
+
+uint32_t& ScopeProfiler::scopes_ended_ref()
+{
+    thread_local uint32_t count = 0;
+    return count;
 }
 
 int& ScopeProfiler::depth_ref()
@@ -51,4 +409,4 @@ void ScopeProfiler::increment_depth()
 void ScopeProfiler::decrement_depth()
 {
     --depth_ref();
-}
\ No newline at end of file
+}
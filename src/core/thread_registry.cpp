@@ -0,0 +1,150 @@
+#include "runscope/core/thread_registry.hpp"
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <pthread.h>
+#endif
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace runscope::core;
+
+namespace
+{
+    uint64_t current_os_id() noexcept
+    {
+#if defined(__linux__)
+        return static_cast<uint64_t>(syscall(SYS_gettid));
+#elif defined(__APPLE__)
+        uint64_t id = 0;
+        pthread_threadid_np(nullptr, &id);
+        return id;
+#else
+        return 0;
+#endif
+    }
+
+    std::string current_os_name()
+    {
+#if defined(__linux__) || defined(__APPLE__)
+        char name[64] = {};
+        if (pthread_getname_np(pthread_self(), name, sizeof(name)) == 0)
+        {
+            return name;
+        }
+#endif
+        return {};
+    }
+
+    void set_os_name(const std::string_view name)
+    {
+#if defined(__linux__)
+        const std::string truncated(name.substr(0, 15));
+        pthread_setname_np(pthread_self(), truncated.c_str());
+#elif defined(__APPLE__)
+        const std::string copy(name);
+        pthread_setname_np(copy.c_str());
+#else
+        (void)name;
+#endif
+    }
+}
+
+ThreadRegistry& ThreadRegistry::getInstance()
+{
+    // Never destroyed: threads may still record during static destruction.
+    static auto* registry = new ThreadRegistry();
+    return *registry;
+}
+
+uint16_t ThreadRegistry::current_index()
+{
+    thread_local int32_t index = -1;
+    if (index < 0)
+    {
+        index = getInstance().register_current();
+    }
+    return static_cast<uint16_t>(index);
+}
+
+void ThreadRegistry::set_current_thread_name(const std::string_view name)
+{
+    const uint16_t index = current_index();
+    set_os_name(name);
+
+    auto& registry = getInstance();
+    std::lock_guard<std::mutex> lock(registry.mutex_);
+    if (index != overflow_index && index < registry.threads_.size())
+    {
+        registry.threads_[index].name = name;
+    }
+}
+
+uint16_t ThreadRegistry::register_current()
+{
+    // Always a new index: a std::thread::id may be reused once its thread has
+    // exited, and the new thread must not inherit the old one's name.
+    const uint64_t os_id = current_os_id();
+    std::string name = current_os_name();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    return add(std::this_thread::get_id(), os_id, std::move(name));
+}
+
+uint16_t ThreadRegistry::index_of(const ThreadId& id)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (const auto it = by_id_.find(id); it != by_id_.end())
+    {
+        return it->second;
+    }
+    return add(id, 0, {});
+}
+
+uint16_t ThreadRegistry::add(const ThreadId& id, const uint64_t os_id, std::string name)
+{
+    if (threads_.size() >= overflow_index)
+    {
+        if (threads_.size() == overflow_index)
+        {
+            ThreadDescriptor overflow;
+            overflow.index = overflow_index;
+            overflow.name = "other threads";
+            threads_.push_back(std::move(overflow));
+        }
+        by_id_[id] = overflow_index;
+        return overflow_index;
+    }
+
+    ThreadDescriptor descriptor;
+    descriptor.id = id;
+    descriptor.index = static_cast<uint16_t>(threads_.size());
+    descriptor.os_id = os_id;
+    descriptor.name = std::move(name);
+    threads_.push_back(std::move(descriptor));
+    by_id_[id] = threads_.back().index;
+    return threads_.back().index;
+}
+
+std::optional<ThreadDescriptor> ThreadRegistry::find(const ThreadId& id) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (const auto it = by_id_.find(id); it != by_id_.end())
+    {
+        return threads_[it->second];
+    }
+    return std::nullopt;
+}
+
+std::vector<ThreadDescriptor> ThreadRegistry::snapshot() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return threads_;
+}
+
+size_t ThreadRegistry::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return threads_.size();
+}
@@ -1,10 +1,66 @@
 #include "runscope/export/exporter.hpp"
+#include "runscope/core/thread_registry.hpp"
+#include "runscope/analysis/overhead.hpp"
 #include <fstream>
 #include <sstream>
 #include <iomanip>
+#include <set>
+#include <unordered_map>
 
 using namespace runscope::export_format;
 
+namespace
+{
+    // Resolves each distinct thread once per export rather than per entry.
+    // Threads the registry does not know share the overflow slot.
+    class ThreadTable
+    {
+    public:
+        const runscope::core::ThreadDescriptor& operator[](const runscope::core::ThreadId& id)
+        {
+            auto it = cache_.find(id);
+            if (it == cache_.end())
+            {
+                auto descriptor = runscope::core::ThreadRegistry::getInstance().find(id);
+                if (!descriptor)
+                {
+                    descriptor.emplace();
+                    descriptor->id = id;
+                    descriptor->index = runscope::core::ThreadRegistry::overflow_index;
+                }
+                it = cache_.emplace(id, std::move(*descriptor)).first;
+            }
+            return it->second;
+        }
+
+    private:
+        std::unordered_map<runscope::core::ThreadId, runscope::core::ThreadDescriptor> cache_;
+    };
+
+    // Moves counters and span events with the compensated scopes of their
+    // threads, so the trace still lines up.
+    void apply_shift(const runscope::analysis::OverheadShift& shift, std::vector<runscope::core::CounterSample>& counters,
+                     std::vector<runscope::core::AsyncSpan>& spans)
+    {
+        for (auto& counter : counters)
+        {
+            counter.time_ns = shift.shifted(counter.thread_id, counter.time_ns);
+        }
+        for (auto& span : spans)
+        {
+            span.begin_ns = shift.shifted(span.begin_thread, span.begin_ns);
+            for (auto& step : span.steps)
+            {
+                step.time_ns = shift.shifted(step.thread_id, step.time_ns);
+            }
+            if (span.complete)
+            {
+                span.end_ns = shift.shifted(span.end_thread, span.end_ns);
+            }
+        }
+    }
+}
+
 std::string Exporter::thread_id_to_string(const core::ThreadId& id)
 {
     std::ostringstream oss;
@@ -20,6 +76,7 @@ bool Exporter::export_to_json(const std::vector<core::ProfileEntry>& entries, co
         return false;
     }
     
+    ThreadTable threads;
     file << "{\n";
     file << "  \"entries\": [\n";
     
@@ -34,10 +91,15 @@ bool Exporter::export_to_json(const std::vector<core::ProfileEntry>& entries, co
         file << "      \"end_ns\": " << entry.end_ns << ",\n";
         file << "      \"duration_ns\": " << entry.duration_ns() << ",\n";
         file << "      \"duration_ms\": " << entry.duration_ms() << ",\n";
+        // thread_id keeps its original string form; trace_tid is the
+        // numeric id Chrome trace exports use for the same thread.
+        const auto& thread = threads[entry.thread_id];
         file << "      \"thread_id\": \"" << thread_id_to_string(entry.thread_id) << "\",\n";
         file << "      \"depth\": " << entry.depth << ",\n";
         file << "      \"memory_used\": " << entry.memory_used << ",\n";
-        file << "      \"cpu_usage\": " << entry.cpu_usage << "\n";
+        file << "      \"cpu_usage\": " << entry.cpu_usage << ",\n";
+        file << "      \"trace_tid\": " << thread.trace_id() << ",\n";
+        file << "      \"thread_name\": \"" << thread.name << "\"\n";
         file << "    }";
         if (i < entries.size() - 1)
         {
@@ -60,10 +122,12 @@ bool Exporter::export_to_csv(const std::vector<core::ProfileEntry>& entries, con
         return false;
     }
     
-    file << "Name,File,Line,Start(ns),End(ns),Duration(ns),Duration(ms),ThreadID,Depth,Memory,CPU\n";
+    ThreadTable threads;
+    file << "Name,File,Line,Start(ns),End(ns),Duration(ns),Duration(ms),ThreadID,Depth,Memory,CPU,TraceTID,ThreadName\n";
     
     for (const auto& entry : entries)
     {
+        const auto& thread = threads[entry.thread_id];
         file << entry.name << ","
              << entry.file << ","
              << entry.line << ","
@@ -74,7 +138,9 @@ bool Exporter::export_to_csv(const std::vector<core::ProfileEntry>& entries, con
              << thread_id_to_string(entry.thread_id) << ","
              << entry.depth << ","
              << entry.memory_used << ","
-             << entry.cpu_usage << "\n";
+             << entry.cpu_usage << ","
+             << thread.trace_id() << ","
+             << thread.name << "\n";
     }
     
     return true;
@@ -89,36 +155,208 @@ bool Exporter::export_to_chrome_trace(const std::vector<core::ProfileEntry>& ent
     }
     
     file << "[\n";
+    write_chrome_events(file, entries);
+    file << "]\n";
     
-    for (size_t i = 0; i < entries.size(); ++i)
+    return true;
+}
+
+bool Exporter::export_to_chrome_trace(const std::vector<core::ProfileEntry>& entries,
+                                      const std::vector<core::CounterSample>& counters,
+                                      const std::string& filename)
+{
+    std::ofstream file(filename);
+    if (!file.is_open())
     {
-        const auto& entry = entries[i];
-        
-        file << "  {\n";
-        file << "    \"name\": \"" << entry.name << "\",\n";
-        file << "    \"cat\": \"function\",\n";
-        file << "    \"ph\": \"X\",\n";
-        file << "    \"ts\": " << (entry.start_ns / 1000) << ",\n";
-        file << "    \"dur\": " << (entry.duration_ns() / 1000) << ",\n";
-        file << "    \"pid\": 1,\n";
-        file << "    \"tid\": \"" << thread_id_to_string(entry.thread_id) << "\",\n";
-        file << "    \"args\": {\n";
-        file << "      \"file\": \"" << entry.file << "\",\n";
-        file << "      \"line\": " << entry.line << "\n";
-        file << "    }\n";
-        file << "  }";
-        if (i < entries.size() - 1)
-        {
-            file << ",";
-        }
-        file << "\n";
+        return false;
     }
-    
+
+    file << "[\n";
+    write_chrome_events(file, entries, counters);
     file << "]\n";
-    
+
+    return true;
+}
+
+bool Exporter::export_to_chrome_trace(const core::ProfilerSession& session, const std::string& filename,
+                                      const bool subtract_overhead)
+{
+    std::ofstream file(filename);
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    auto entries = session.get_entries();
+    auto counters = session.get_counter_samples();
+    auto spans = session.get_async_spans();
+    if (subtract_overhead)
+    {
+        analysis::OverheadShift shift;
+        entries = analysis::compensate_overhead(std::move(entries), session.overhead(), &shift);
+        apply_shift(shift, counters, spans);
+    }
+
+    file << "[\n";
+    write_chrome_events(file, entries, counters, spans);
+    file << "]\n";
+
+    return true;
+}
+
+bool Exporter::export_snapshot(const core::ProfilerSession& session, const std::string& filename,
+                               const bool subtract_overhead)
+{
+    std::ofstream file(filename);
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    auto entries = session.get_entries();
+    auto counters = session.get_counter_samples();
+    auto spans = session.get_async_spans();
+    if (subtract_overhead)
+    {
+        analysis::OverheadShift shift;
+        entries = analysis::compensate_overhead(std::move(entries), session.overhead(), &shift);
+        apply_shift(shift, counters, spans);
+    }
+    const uint64_t dropped = session.dropped_events();
+
+    file << "{\n";
+    file << "\"traceEvents\": [\n";
+    write_chrome_events(file, entries, counters, spans);
+    file << "],\n";
+    file << "\"otherData\": {\n";
+    file << "  \"session\": \"" << session.name() << "\",\n";
+    file << "  \"dropped_events\": " << dropped << ",\n";
+    file << "  \"scope_overhead_ns\": " << session.overhead().total_ns << ",\n";
+    file << "  \"overhead_subtracted\": " << (subtract_overhead ? "true" : "false") << "\n";
+    file << "}\n";
+    file << "}\n";
+
     return true;
 }
 
+void Exporter::write_chrome_events(std::ostream& out, const std::vector<core::ProfileEntry>& entries,
+                                   const std::vector<core::CounterSample>& counters,
+                                   const std::vector<core::AsyncSpan>& spans)
+{
+    ThreadTable threads;
+    bool first = true;
+    auto begin_event = [&out, &first]()
+    {
+        if (!first)
+        {
+            out << ",\n";
+        }
+        first = false;
+        out << "  {\n";
+    };
+
+    for (const auto& entry : entries)
+    {
+        begin_event();
+        out << "    \"name\": \"" << entry.name << "\",\n";
+        out << "    \"cat\": \"function\",\n";
+        out << "    \"ph\": \"X\",\n";
+        out << "    \"ts\": " << (entry.start_ns / 1000) << ",\n";
+        out << "    \"dur\": " << (entry.duration_ns() / 1000) << ",\n";
+        out << "    \"pid\": 1,\n";
+        out << "    \"tid\": " << threads[entry.thread_id].trace_id() << ",\n";
+        out << "    \"args\": {\n";
+        out << "      \"file\": \"" << entry.file << "\",\n";
+        out << "      \"line\": " << entry.line << "\n";
+        out << "    }\n";
+        out << "  }";
+    }
+
+    for (const auto& counter : counters)
+    {
+        begin_event();
+        out << "    \"name\": \"" << counter.name << "\",\n";
+        out << "    \"ph\": \"C\",\n";
+        out << "    \"ts\": " << (counter.time_ns / 1000) << ",\n";
+        out << "    \"pid\": 1,\n";
+        out << "    \"args\": {\n";
+        const std::streamsize precision = out.precision(15);
+        out << "      \"value\": " << counter.value << "\n";
+        out.precision(precision);
+        out << "    }\n";
+        out << "  }";
+    }
+
+    // Each span is a nestable async slice ("b"/"n"/"e") plus a flow ("s"/"t"/"f")
+    // that links the threads it passed through.
+    auto write_async = [&](const core::AsyncSpan& span, const std::string& name, const char* cat, const char* phase,
+                           const int64_t time_ns, const core::ThreadId& thread)
+    {
+        begin_event();
+        out << "    \"name\": \"" << name << "\",\n";
+        out << "    \"cat\": \"" << cat << "\",\n";
+        out << "    \"ph\": \"" << phase << "\",\n";
+        out << "    \"id\": \"0x" << std::hex << span.id << std::dec << "\",\n";
+        out << "    \"ts\": " << (time_ns / 1000) << ",\n";
+        out << "    \"pid\": 1,\n";
+        if (phase[0] == 'f')
+        {
+            out << "    \"bp\": \"e\",\n";
+        }
+        out << "    \"tid\": " << threads[thread].trace_id() << "\n";
+        out << "  }";
+    };
+
+    for (const auto& span : spans)
+    {
+        write_async(span, span.name, "async", "b", span.begin_ns, span.begin_thread);
+        for (const auto& step : span.steps)
+        {
+            write_async(span, step.name, "async", "n", step.time_ns, step.thread_id);
+        }
+        if (span.complete)
+        {
+            write_async(span, span.name, "async", "e", span.end_ns, span.end_thread);
+        }
+
+        write_async(span, span.name, "flow", "s", span.begin_ns, span.begin_thread);
+        for (const auto& step : span.steps)
+        {
+            write_async(span, span.name, "flow", "t", step.time_ns, step.thread_id);
+        }
+        if (span.complete)
+        {
+            write_async(span, span.name, "flow", "f", span.end_ns, span.end_thread);
+        }
+    }
+
+    // Viewers label tracks from thread_name metadata; several ThreadIds may
+    // share a tid once the registry overflows, so name each tid once.
+    std::set<uint64_t> named;
+    for (const auto& entry : entries)
+    {
+        const auto& thread = threads[entry.thread_id];
+        if (thread.name.empty() || !named.insert(thread.trace_id()).second)
+        {
+            continue;
+        }
+        begin_event();
+        out << "    \"name\": \"thread_name\",\n";
+        out << "    \"ph\": \"M\",\n";
+        out << "    \"pid\": 1,\n";
+        out << "    \"tid\": " << thread.trace_id() << ",\n";
+        out << "    \"args\": {\n";
+        out << "      \"name\": \"" << thread.name << "\"\n";
+        out << "    }\n";
+        out << "  }";
+    }
+
+    if (!first)
+    {
+        out << "\n";
+    }
+}
+
 bool Exporter::import_from_json(const std::string& filename, std::vector<core::ProfileEntry>& entries)
 {
     std::ifstream file(filename);
@@ -152,6 +390,7 @@ bool Exporter::import_from_json(const std::string& filename, std::vector<core::P
         std::string obj = json.substr(obj_start, obj_end - obj_start + 1);
 
         core::ProfileEntry entry{};
+        entry.source = core::EntrySource::Recorded;
         entry.name = extract_string(obj, "name");
         entry.file = extract_string(obj, "file");
         entry.line = extract_number<int>(obj, "line");
@@ -161,7 +400,8 @@ bool Exporter::import_from_json(const std::string& filename, std::vector<core::P
         entry.memory_used = extract_number<size_t>(obj, "memory_used");
         entry.cpu_usage = extract_number<double>(obj, "cpu_usage");
 
-        std::string tid_str = extract_string(obj, "thread_id");
+        // Exported thread ids belong to the recording process and do not map
+        // back to a std::thread::id here.
         entry.thread_id = std::thread::id();
 
         entries.push_back(std::move(entry));
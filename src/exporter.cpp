@@ -1,11 +1,43 @@
 #include "runscope/exporter.hpp"
+#include "runscope/core/thread_registry.hpp"
 #include <fstream>
 #include <sstream>
 #include <iomanip>
-#include <functional>
+#include <unordered_map>
 
 using namespace runscope;
 
+namespace
+{
+    // Trace ids of every registered thread, taken once per export. Threads
+    // the registry does not know share the overflow slot.
+    class TraceIds
+    {
+    public:
+        TraceIds()
+        {
+            // Later descriptors win, as in the registry: a thread id may be
+            // reused once its thread has exited.
+            for (const auto& thread : core::ThreadRegistry::getInstance().snapshot())
+            {
+                if (thread.index != core::ThreadRegistry::overflow_index)
+                {
+                    ids_[thread.id] = thread.trace_id();
+                }
+            }
+        }
+
+        uint64_t operator[](const core::ThreadId& id) const
+        {
+            const auto it = ids_.find(id);
+            return it != ids_.end() ? it->second : core::ThreadRegistry::overflow_index + 1u;
+        }
+
+    private:
+        std::unordered_map<core::ThreadId, uint64_t> ids_;
+    };
+}
+
 bool Exporter::export_to_json(const std::vector<ProfileEntry>& entries, const std::string_view filename)
 {
     std::ofstream file(filename.data());
@@ -14,6 +46,7 @@ bool Exporter::export_to_json(const std::vector<ProfileEntry>& entries, const st
         return false;
     }
 
+    const TraceIds trace_ids;
     file << "{\n";
     file << "  \"traceEvents\": [\n";
 
@@ -28,7 +61,7 @@ bool Exporter::export_to_json(const std::vector<ProfileEntry>& entries, const st
         file << "      \"ts\": " << (entry.start_ns / 1000) << ",\n";
         file << "      \"dur\": " << (entry.duration_ns() / 1000) << ",\n";
         file << "      \"pid\": 0,\n";
-        file << "      \"tid\": " << std::hash<std::thread::id>{}(entry.thread_id) << ",\n";
+        file << "      \"tid\": " << trace_ids[entry.thread_id] << ",\n";
         file << "      \"args\": {\"depth\": " << entry.depth << "}\n";
         file << "    }";
         
@@ -53,6 +86,7 @@ bool Exporter::export_to_csv(const std::vector<ProfileEntry>& entries, const std
         return false;
     }
 
+    const TraceIds trace_ids;
     file << "Name,Start(ns),End(ns),Duration(ns),Duration(ms),Thread,Depth\n";
 
     for (const auto& entry : entries)
@@ -62,7 +96,7 @@ bool Exporter::export_to_csv(const std::vector<ProfileEntry>& entries, const std
              << entry.end_ns << ","
              << entry.duration_ns() << ","
              << std::fixed << std::setprecision(3) << entry.duration_ms() << ","
-             << std::hash<std::thread::id>{}(entry.thread_id) << ","
+             << trace_ids[entry.thread_id] << ","
              << entry.depth << "\n";
     }
 
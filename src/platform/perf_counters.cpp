@@ -0,0 +1,205 @@
+#include "runscope/platform/perf_counters.hpp"
+
+#if defined(__linux__)
+#define RUNSCOPE_PERF_EVENTS 1
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace runscope::platform;
+
+namespace
+{
+    constexpr size_t software_group = 0;
+    constexpr size_t hardware_group = 1;
+    constexpr size_t max_group_size = 3;
+
+#ifdef RUNSCOPE_PERF_EVENTS
+    struct EventSpec
+    {
+        PerfCounter counter;
+        uint32_t type;
+        uint64_t config;
+    };
+
+    constexpr std::array<EventSpec, 3> software_events{{
+        {PerfCounter::TaskClock, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+        {PerfCounter::PageFaults, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+        {PerfCounter::ContextSwitches, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+    }};
+
+    constexpr std::array<EventSpec, 3> hardware_events{{
+        {PerfCounter::Cycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PerfCounter::Instructions, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PerfCounter::CacheMisses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    }};
+
+    int open_event(const EventSpec& spec, const int group_fd, const bool exclude_kernel) noexcept
+    {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = spec.type;
+        attr.config = spec.config;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.exclude_kernel = exclude_kernel ? 1 : 0;
+        attr.exclude_hv = 1;
+
+        // pid 0, cpu -1: the calling thread, on whichever CPU it runs.
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, PERF_FLAG_FD_CLOEXEC));
+    }
+
+    struct Group
+    {
+        int leader{-1};
+        std::array<int, max_group_size> fds{-1, -1, -1};
+        std::array<PerfCounter, max_group_size> members{};
+        size_t size{0};
+
+        // Members the kernel refuses (e.g. no cache-miss event on this PMU) are
+        // left out; the group only fails when its leader cannot be opened.
+        bool open(const std::array<EventSpec, 3>& events) noexcept
+        {
+            for (const bool exclude_kernel : {false, true})
+            {
+                for (const auto& spec : events)
+                {
+                    const int fd = open_event(spec, leader, exclude_kernel);
+                    if (fd < 0)
+                    {
+                        if (leader < 0)
+                        {
+                            break;
+                        }
+                        continue;
+                    }
+                    if (leader < 0)
+                    {
+                        leader = fd;
+                    }
+                    fds[size] = fd;
+                    members[size] = spec.counter;
+                    ++size;
+                }
+                // Restricted perf_event_paranoid settings only allow user-space counting.
+                if (leader >= 0 || (errno != EACCES && errno != EPERM))
+                {
+                    break;
+                }
+            }
+            return leader >= 0;
+        }
+
+        bool read(PerfSnapshot& snapshot, const size_t group) const noexcept
+        {
+            std::array<uint64_t, 3 + max_group_size> buffer{};
+            const ssize_t bytes = ::read(leader, buffer.data(), sizeof(buffer));
+            if (bytes < static_cast<ssize_t>((3 + size) * sizeof(uint64_t)) || buffer[0] != size)
+            {
+                return false;
+            }
+            snapshot.time_enabled[group] = buffer[1];
+            snapshot.time_running[group] = buffer[2];
+            for (size_t i = 0; i < size; ++i)
+            {
+                snapshot.values[static_cast<size_t>(members[i])] = buffer[3 + i];
+            }
+            return true;
+        }
+
+        void close() noexcept
+        {
+            for (size_t i = size; i-- > 0;)
+            {
+                ::close(fds[i]);
+            }
+            leader = -1;
+            size = 0;
+        }
+    };
+
+    struct ThreadGroups
+    {
+        bool opened{false};
+        Group software;
+        Group hardware;
+
+        ThreadGroups() = default;
+        ThreadGroups(const ThreadGroups&) = delete;
+        ThreadGroups& operator=(const ThreadGroups&) = delete;
+
+        ~ThreadGroups()
+        {
+            software.close();
+            hardware.close();
+        }
+
+        void open() noexcept
+        {
+            opened = true;
+            software.open(software_events);
+            hardware.open(hardware_events);
+        }
+    };
+
+    thread_local ThreadGroups thread_groups;
+#endif
+
+    uint64_t scaled(const uint64_t value, const uint64_t enabled, const uint64_t running) noexcept
+    {
+        if (running == 0 || running >= enabled)
+        {
+            return value;
+        }
+        return static_cast<uint64_t>(static_cast<double>(value) * static_cast<double>(enabled) / static_cast<double>(running));
+    }
+}
+
+bool PerfCounters::supported() noexcept
+{
+#ifdef RUNSCOPE_PERF_EVENTS
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool PerfCounters::read(PerfSnapshot& snapshot) noexcept
+{
+#ifdef RUNSCOPE_PERF_EVENTS
+    ThreadGroups& groups = thread_groups;
+    if (!groups.opened)
+    {
+        groups.open();
+    }
+
+    snapshot.software = groups.software.leader >= 0 && groups.software.read(snapshot, software_group);
+    snapshot.hardware = groups.hardware.leader >= 0 && groups.hardware.read(snapshot, hardware_group);
+    return snapshot.software || snapshot.hardware;
+#else
+    (void)snapshot;
+    return false;
+#endif
+}
+
+PerfDelta PerfCounters::delta(const PerfSnapshot& begin, const PerfSnapshot& end) noexcept
+{
+    PerfDelta delta;
+    const std::array<bool, 2> available{begin.software && end.software, begin.hardware && end.hardware};
+    for (size_t i = 0; i < delta.values.size(); ++i)
+    {
+        const size_t group = i < static_cast<size_t>(PerfCounter::Cycles) ? software_group : hardware_group;
+        if (available[group])
+        {
+            delta.values[i] = scaled(end.values[i] - begin.values[i],
+                                     end.time_enabled[group] - begin.time_enabled[group],
+                                     end.time_running[group] - begin.time_running[group]);
+        }
+    }
+    delta.software = available[software_group];
+    delta.hardware = available[hardware_group] && end.time_running[hardware_group] != begin.time_running[hardware_group];
+    return delta;
+}
@@ -534,6 +534,7 @@ private:
         if (thread_ids.empty())
         {
             core::ProfileEntry entry;
+            entry.source = core::EntrySource::Sample;
             entry.name = "[Attached to: " + exe_name + " (PID:" + std::to_string(attached_pid_) + ")]";
             entry.start_ns = sample_time;
             entry.end_ns = sample_time + 1000000; // 1ms
@@ -547,6 +548,7 @@ private:
             {
                 ThreadState thread_state = read_thread_state(attached_pid_, tid);
                 core::ProfileEntry entry;
+                entry.source = core::EntrySource::Sample;
                 std::string state_str;
                 switch (thread_state.state[0])
                 {
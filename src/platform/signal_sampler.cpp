@@ -0,0 +1,406 @@
+#include "runscope/platform/signal_sampler.hpp"
+#include "runscope/core/clock.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+
+#if defined(__linux__) && (defined(__x86_64__) || defined(__aarch64__))
+#define RUNSCOPE_SIGNAL_SAMPLER 1
+#include <cerrno>
+#include <csignal>
+#include <ctime>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <ucontext.h>
+#include <unistd.h>
+#endif
+
+using namespace runscope::platform;
+using namespace runscope::core;
+
+struct SignalSampler::ThreadSlot
+{
+    static constexpr size_t ring_capacity = 128;
+
+    struct RawSample
+    {
+        int64_t timestamp;
+        uint32_t depth;
+        std::array<uintptr_t, max_frames> frames;
+    };
+
+    ThreadId thread;
+    uintptr_t stack_low{0};
+    uintptr_t stack_high{0};
+    bool retired{false};
+
+#ifdef RUNSCOPE_SIGNAL_SAMPLER
+    pid_t tid{0};
+    pthread_t handle{};
+    timer_t timer{};
+    bool armed{false};
+#endif
+
+    // Single producer (the signal handler on the owning thread), single
+    // consumer (drain() under the sampler mutex).
+    std::array<RawSample, ring_capacity> ring;
+    std::atomic<uint64_t> head{0};
+    std::atomic<uint64_t> tail{0};
+    std::atomic<uint64_t> dropped{0};
+};
+
+namespace
+{
+    constinit thread_local SignalSampler::ThreadSlot* current_slot = nullptr;
+
+    struct RegistrationGuard
+    {
+        bool active{false};
+
+        ~RegistrationGuard()
+        {
+            if (active)
+            {
+                SignalSampler::getInstance().unregister_current_thread();
+            }
+        }
+    };
+
+    thread_local RegistrationGuard registration_guard;
+
+#ifdef RUNSCOPE_SIGNAL_SAMPLER
+    std::atomic<bool> sampling_enabled{false};
+
+    void capture(SignalSampler::ThreadSlot& slot, const ucontext_t& context) noexcept
+    {
+        const uint64_t head = slot.head.load(std::memory_order_relaxed);
+        if (head - slot.tail.load(std::memory_order_acquire) >= SignalSampler::ThreadSlot::ring_capacity)
+        {
+            slot.dropped.store(slot.dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return;
+        }
+
+        auto& sample = slot.ring[head % SignalSampler::ThreadSlot::ring_capacity];
+        sample.timestamp = Clock::ticks();
+
+#if defined(__x86_64__)
+        uintptr_t pc = static_cast<uintptr_t>(context.uc_mcontext.gregs[REG_RIP]);
+        uintptr_t fp = static_cast<uintptr_t>(context.uc_mcontext.gregs[REG_RBP]);
+        const auto sp = static_cast<uintptr_t>(context.uc_mcontext.gregs[REG_RSP]);
+#else
+        uintptr_t pc = static_cast<uintptr_t>(context.uc_mcontext.pc);
+        uintptr_t fp = static_cast<uintptr_t>(context.uc_mcontext.regs[29]);
+        const auto sp = static_cast<uintptr_t>(context.uc_mcontext.sp);
+#endif
+
+        // Every frame read is checked against the live part of the thread's
+        // stack, from the interrupted stack pointer up, so a frame built
+        // without a frame pointer ends the walk instead of faulting or reading
+        // stale frames below the stack pointer.
+        const uintptr_t stack_low = std::max(slot.stack_low, sp);
+        uint32_t depth = 0;
+        sample.frames[depth++] = pc;
+        while (depth < SignalSampler::max_frames &&
+               fp >= stack_low && fp + 2 * sizeof(uintptr_t) <= slot.stack_high &&
+               fp % alignof(uintptr_t) == 0)
+        {
+            const auto* frame = reinterpret_cast<const uintptr_t*>(fp);
+            const uintptr_t next = frame[0];
+            const uintptr_t return_address = frame[1];
+            if (return_address == 0)
+            {
+                break;
+            }
+            sample.frames[depth++] = return_address;
+            if (next <= fp)
+            {
+                break;
+            }
+            fp = next;
+        }
+        sample.depth = depth;
+
+        slot.head.store(head + 1, std::memory_order_release);
+    }
+
+    void handle_sigprof(int, siginfo_t*, void* context) noexcept
+    {
+        const int saved_errno = errno;
+        SignalSampler::ThreadSlot* slot = current_slot;
+        if (slot && context && sampling_enabled.load(std::memory_order_relaxed))
+        {
+            capture(*slot, *static_cast<const ucontext_t*>(context));
+        }
+        errno = saved_errno;
+    }
+
+    // The handler stays installed once set: a SIGPROF still pending after the
+    // timers are deleted must not fall back to the default action.
+    bool install_handler()
+    {
+        static const bool installed = []
+        {
+            struct sigaction action{};
+            action.sa_sigaction = handle_sigprof;
+            action.sa_flags = SA_SIGINFO | SA_RESTART;
+            sigemptyset(&action.sa_mask);
+            return sigaction(SIGPROF, &action, nullptr) == 0;
+        }();
+        return installed;
+    }
+
+    void disarm(SignalSampler::ThreadSlot& slot)
+    {
+        if (slot.armed)
+        {
+            timer_delete(slot.timer);
+            slot.armed = false;
+        }
+    }
+#endif
+}
+
+SignalSampler& SignalSampler::getInstance()
+{
+    // Never destroyed: exiting threads unregister during static destruction.
+    static auto* sampler = new SignalSampler();
+    return *sampler;
+}
+
+bool SignalSampler::supported() noexcept
+{
+#ifdef RUNSCOPE_SIGNAL_SAMPLER
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool SignalSampler::start(const uint32_t frequency_hz)
+{
+#ifdef RUNSCOPE_SIGNAL_SAMPLER
+    if (frequency_hz == 0 || !install_handler())
+    {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        frequency_hz_.store(frequency_hz, std::memory_order_relaxed);
+        running_.store(true, std::memory_order_release);
+        sampling_enabled.store(true, std::memory_order_relaxed);
+        for (const auto& slot : slots_)
+        {
+            if (!slot->retired && !slot->armed)
+            {
+                arm(*slot);
+            }
+        }
+    }
+
+    register_current_thread();
+    return true;
+#else
+    (void)frequency_hz;
+    return false;
+#endif
+}
+
+void SignalSampler::stop()
+{
+#ifdef RUNSCOPE_SIGNAL_SAMPLER
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_.store(false, std::memory_order_release);
+    sampling_enabled.store(false, std::memory_order_relaxed);
+    for (const auto& slot : slots_)
+    {
+        disarm(*slot);
+    }
+#endif
+}
+
+bool SignalSampler::arm(ThreadSlot& slot) const
+{
+#ifdef RUNSCOPE_SIGNAL_SAMPLER
+    clockid_t cpu_clock;
+    if (pthread_getcpuclockid(slot.handle, &cpu_clock) != 0)
+    {
+        return false;
+    }
+
+    sigevent event{};
+    event.sigev_notify = SIGEV_THREAD_ID;
+    event.sigev_signo = SIGPROF;
+#ifdef sigev_notify_thread_id
+    event.sigev_notify_thread_id = slot.tid;
+#else
+    event._sigev_un._tid = slot.tid;
+#endif
+
+    if (timer_create(cpu_clock, &event, &slot.timer) != 0)
+    {
+        return false;
+    }
+
+    const long period_ns = 1000000000L / static_cast<long>(frequency_hz_.load(std::memory_order_relaxed));
+    itimerspec spec{};
+    spec.it_interval.tv_sec = period_ns / 1000000000L;
+    spec.it_interval.tv_nsec = period_ns % 1000000000L;
+    spec.it_value = spec.it_interval;
+    if (timer_settime(slot.timer, 0, &spec, nullptr) != 0)
+    {
+        timer_delete(slot.timer);
+        return false;
+    }
+
+    slot.armed = true;
+    return true;
+#else
+    (void)slot;
+    return false;
+#endif
+}
+
+bool SignalSampler::register_current_thread()
+{
+#ifdef RUNSCOPE_SIGNAL_SAMPLER
+    if (current_slot)
+    {
+        return true;
+    }
+
+    auto slot = std::make_shared<ThreadSlot>();
+    slot->thread = std::this_thread::get_id();
+    slot->tid = static_cast<pid_t>(syscall(SYS_gettid));
+    slot->handle = pthread_self();
+
+    pthread_attr_t attributes;
+    if (pthread_getattr_np(slot->handle, &attributes) != 0)
+    {
+        return false;
+    }
+    void* stack_address = nullptr;
+    size_t stack_size = 0;
+    pthread_attr_getstack(&attributes, &stack_address, &stack_size);
+    pthread_attr_destroy(&attributes);
+    slot->stack_low = reinterpret_cast<uintptr_t>(stack_address);
+    slot->stack_high = slot->stack_low + stack_size;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    slots_.push_back(slot);
+    current_slot = slot.get();
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    registration_guard.active = true;
+
+    return !running_.load(std::memory_order_acquire) || arm(*slot);
+#else
+    return false;
+#endif
+}
+
+void SignalSampler::unregister_current_thread()
+{
+    ThreadSlot* slot = current_slot;
+    if (!slot)
+    {
+        return;
+    }
+    current_slot = nullptr;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+#ifdef RUNSCOPE_SIGNAL_SAMPLER
+    disarm(*slot);
+#endif
+    // Kept until drain() has collected whatever the ring still holds.
+    slot->retired = true;
+}
+
+size_t SignalSampler::drain(std::vector<StackSample>& out)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const size_t before = out.size();
+
+    for (const auto& slot : slots_)
+    {
+        const uint64_t tail = slot->tail.load(std::memory_order_relaxed);
+        const uint64_t head = slot->head.load(std::memory_order_acquire);
+        for (uint64_t i = tail; i < head; ++i)
+        {
+            const auto& raw = slot->ring[i % ThreadSlot::ring_capacity];
+            StackSample sample;
+            sample.thread = slot->thread;
+            sample.timestamp = raw.timestamp;
+            sample.frames.assign(raw.frames.begin(), raw.frames.begin() + raw.depth);
+            out.push_back(std::move(sample));
+        }
+        slot->tail.store(head, std::memory_order_release);
+    }
+
+    const auto retired = std::ranges::remove_if(slots_, [](const auto& slot) { return slot->retired; });
+    for (auto it = retired.begin(); it != retired.end(); ++it)
+    {
+        retired_dropped_.fetch_add((*it)->dropped.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    slots_.erase(retired.begin(), retired.end());
+
+    return out.size() - before;
+}
+
+SymbolInfo SignalSampler::symbolize(const uintptr_t address)
+{
+    std::lock_guard<std::mutex> lock(symbol_mutex_);
+    if (const auto it = symbols_.find(address); it != symbols_.end())
+    {
+        return it->second;
+    }
+
+    SymbolInfo symbol;
+#ifdef RUNSCOPE_SIGNAL_SAMPLER
+    Dl_info info{};
+    if (dladdr(reinterpret_cast<void*>(address), &info) != 0)
+    {
+        if (info.dli_fname)
+        {
+            symbol.module = info.dli_fname;
+        }
+        if (info.dli_sname)
+        {
+            int status = 0;
+            char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+            symbol.name = (status == 0 && demangled) ? demangled : info.dli_sname;
+            std::free(demangled);
+        }
+        else if (info.dli_fbase)
+        {
+            const std::string module = symbol.module.substr(symbol.module.find_last_of('/') + 1);
+            char offset[32];
+            std::snprintf(offset, sizeof(offset), "+0x%zx", static_cast<size_t>(address - reinterpret_cast<uintptr_t>(info.dli_fbase)));
+            symbol.name = module + offset;
+        }
+    }
+#endif
+    if (symbol.name.empty())
+    {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "0x%zx", static_cast<size_t>(address));
+        symbol.name = buffer;
+    }
+
+    symbols_.emplace(address, symbol);
+    return symbol;
+}
+
+uint64_t SignalSampler::dropped() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t total = retired_dropped_.load(std::memory_order_relaxed);
+    for (const auto& slot : slots_)
+    {
+        total += slot->dropped.load(std::memory_order_relaxed);
+    }
+    return total;
+}
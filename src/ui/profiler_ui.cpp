@@ -1,5 +1,7 @@
 #include "runscope/ui/profiler_ui.hpp"
 #include "runscope/analysis/statistics.hpp"
+#include "runscope/analysis/frame_analyzer.hpp"
+#include "runscope/analysis/call_tree.hpp"
 #include "runscope/platform/process_info.hpp"
 #include "runscope/runscope_v2.hpp"
 #include "imgui.h"
@@ -9,7 +11,9 @@
 #include <map>
 #include <set>
 #include <cstring>
+#include <cfloat>
 #include <iostream>
+#include <iterator>
 
 using namespace runscope::ui;
 
@@ -45,11 +49,88 @@ struct ProfilerUI::Impl
     core::ProcessId selected_pid_{0};
     std::vector<core::ProfileEntry> cached_entries_;
     runscope::export_format::Exporter exporter_;
-    runscope::core::ProfilerSession current_session_;
-    
-    Impl() : attacher(std::make_unique<platform::ProcessAttacher>()), current_session_("UI Session")
+
+    // Frame marks and counter samples are read through cursors, so each UI
+    // frame only fetches what the session recorded since the last one.
+    core::EntryCursor frame_cursor_;
+    std::vector<core::FrameMark> frame_marks_;
+    analysis::FrameAnalyzer frame_analyzer_;
+    core::EntryCursor counter_cursor_;
+    std::map<std::string, std::vector<std::pair<int64_t, double>>> counter_series_;
+
+    // Memory and CPU totals per scope name, folded from the entries passed
+    // to render() as they grow.
+    size_t usage_entries_{0};
+    int64_t usage_first_start_{0};
+    std::map<std::string, uint64_t> memory_usage_;
+    std::map<std::string, std::pair<int64_t, int64_t>> cpu_totals_;
+
+    Impl() : attacher(std::make_unique<platform::ProcessAttacher>())
     {
     }
+
+    void update_frame_marks()
+    {
+        auto batch = core::ProfilerEngine::getInstance().get_frame_marks(frame_cursor_);
+        if (frame_cursor_.entries_read == batch.size())
+        {
+            frame_marks_.clear();
+        }
+        else if (batch.empty())
+        {
+            return;
+        }
+        // Batches are sorted on their own; a mark published late can
+        // precede the end of the previous one.
+        const auto middle = static_cast<std::ptrdiff_t>(frame_marks_.size());
+        std::ranges::move(batch, std::back_inserter(frame_marks_));
+        std::inplace_merge(frame_marks_.begin(), frame_marks_.begin() + middle, frame_marks_.end(),
+                           [](const core::FrameMark& a, const core::FrameMark& b) { return a.time_ns < b.time_ns; });
+        frame_analyzer_.analyze(frame_marks_, {});
+    }
+
+    void update_counter_series()
+    {
+        const auto batch = core::ProfilerEngine::getInstance().get_counter_samples(counter_cursor_);
+        if (counter_cursor_.entries_read == batch.size())
+        {
+            counter_series_.clear();
+        }
+        for (const auto& sample : batch)
+        {
+            auto& points = counter_series_[sample.name];
+            const auto position = std::ranges::upper_bound(points, sample.time_ns, {}, &std::pair<int64_t, double>::first);
+            points.emplace(position, sample.time_ns, sample.value);
+        }
+    }
+
+    void update_usage(const std::vector<core::ProfileEntry>& entries)
+    {
+        // The caller appends to one vector until the session is cleared or
+        // another source is shown; anything else starts over.
+        if (entries.size() < usage_entries_ || (!entries.empty() && entries.front().start_ns != usage_first_start_))
+        {
+            usage_entries_ = 0;
+            memory_usage_.clear();
+            cpu_totals_.clear();
+        }
+        if (!entries.empty())
+        {
+            usage_first_start_ = entries.front().start_ns;
+        }
+        for (size_t i = usage_entries_; i < entries.size(); ++i)
+        {
+            const auto& entry = entries[i];
+            memory_usage_[entry.name] += entry.memory_used;
+            if (entry.cpu_time_ns > 0)
+            {
+                auto& [cpu_ns, wall_ns] = cpu_totals_[entry.name];
+                cpu_ns += entry.cpu_time_ns;
+                wall_ns += entry.duration_ns();
+            }
+        }
+        usage_entries_ = entries.size();
+    }
 };
 
 ProfilerUI::ProfilerUI() : impl_(std::make_unique<Impl>()) {}
@@ -59,6 +140,9 @@ void ProfilerUI::render(const std::vector<core::ProfileEntry>& entries) const
 {
     // Cache entries for details panel
     impl_->cached_entries_ = entries;
+    impl_->update_frame_marks();
+    impl_->update_counter_series();
+    impl_->update_usage(entries);
     
     show_menu_bar();
     
@@ -304,15 +388,30 @@ void ProfilerUI::show_live_dashboard() const
     }
     
     const int64_t session_duration = max_end - min_start;
-    const double fps = session_duration > 0 ? (1000000000.0 / session_duration) : 0.0;
     
     ImGui::Text("Session Duration: %.2f ms", session_duration / 1000000.0);
     ImGui::Text("Total Entries: %zu", entries.size());
     ImGui::Text("Cumulative Time: %.2f ms", total_duration / 1000000.0);
     ImGui::Text("Active Threads: %zu", unique_threads.size());
-    if (session_duration > 0)
+
+    // Frame timing comes from RUNSCOPE_FRAME_MARK boundaries, if the program sets any.
+    const auto& frame_analyzer = impl_->frame_analyzer_;
+    if (frame_analyzer.frame_count() > 0)
     {
-        ImGui::Text("Estimated FPS: %.1f", fps);
+        const auto frame_stats = frame_analyzer.get_stats();
+        ImGui::Separator();
+        ImGui::Text("Frames (%s): %zu", frame_analyzer.frame_name().c_str(), frame_stats.frame_count);
+        ImGui::Text("FPS: %.1f", frame_stats.frames_per_second());
+        ImGui::Text("Frame Time avg %.2f ms, p50 %.2f ms, p99 %.2f ms, max %.2f ms",
+                    frame_stats.avg_time_ns / 1000000.0,
+                    frame_stats.p50_time_ns / 1000000.0,
+                    frame_stats.p99_time_ns / 1000000.0,
+                    frame_stats.max_time_ns / 1000000.0);
+
+        const auto histogram = frame_analyzer.get_histogram(32);
+        std::vector<float> counts(histogram.counts.begin(), histogram.counts.end());
+        ImGui::PlotHistogram("Frame Times", counts.data(), static_cast<int>(counts.size()),
+                             0, nullptr, 0.0f, FLT_MAX, ImVec2(0, 60));
     }
     
     ImGui::Separator();
@@ -390,8 +489,18 @@ void ProfilerUI::show_timeline_view(const std::vector<core::ProfileEntry>& entri
     ImGui::Begin("Timeline View", &impl_->show_timeline_);
     
     ImGui::SliderFloat("Zoom", &impl_->timeline_zoom_, 0.1f, 10.0f);
-    
-    if (entries.empty())
+
+    // Scopes still running have no entry yet; they are drawn as bars up to now.
+    std::vector<core::OpenScope> open_scopes;
+    for (auto& scope : core::ProfilerEngine::getInstance().get_open_scopes())
+    {
+        if (impl_->filter_text_.empty() || scope.name.find(impl_->filter_text_) != std::string::npos)
+        {
+            open_scopes.push_back(std::move(scope));
+        }
+    }
+
+    if (entries.empty() && open_scopes.empty())
     {
         ImGui::TextColored(ImVec4(0.7f, 0.7f, 0.7f, 1.0f), "No profiling data available");
         ImGui::End();
@@ -414,20 +523,25 @@ void ProfilerUI::show_timeline_view(const std::vector<core::ProfileEntry>& entri
         filtered_entries = entries;
     }
     
-    if (filtered_entries.empty())
+    if (filtered_entries.empty() && open_scopes.empty())
     {
         ImGui::TextColored(ImVec4(0.7f, 0.7f, 0.7f, 1.0f), "No matching entries");
         ImGui::End();
         return;
     }
     
-    int64_t min_time = filtered_entries.front().start_ns;
-    int64_t max_time = filtered_entries.front().end_ns;
+    int64_t min_time = filtered_entries.empty() ? open_scopes.front().start_ns : filtered_entries.front().start_ns;
+    int64_t max_time = filtered_entries.empty() ? open_scopes.front().now_ns() : filtered_entries.front().end_ns;
     for (const auto& entry : filtered_entries)
     {
         min_time = std::min(min_time, entry.start_ns);
         max_time = std::max(max_time, entry.end_ns);
     }
+    for (const auto& scope : open_scopes)
+    {
+        min_time = std::min(min_time, scope.start_ns);
+        max_time = std::max(max_time, scope.now_ns());
+    }
     int64_t time_range = max_time - min_time;
     if (time_range == 0) time_range = 1;
     
@@ -445,6 +559,12 @@ void ProfilerUI::show_timeline_view(const std::vector<core::ProfileEntry>& entri
     {
         thread_entries[filtered_entries[i].thread_id].push_back(i);
     }
+    std::map<core::ThreadId, std::vector<const core::OpenScope*>> thread_open_scopes;
+    for (const auto& scope : open_scopes)
+    {
+        thread_open_scopes[scope.thread_id].push_back(&scope);
+        thread_entries[scope.thread_id];
+    }
 
     float y_offset = canvas_pos.y;
     
@@ -466,13 +586,85 @@ void ProfilerUI::show_timeline_view(const std::vector<core::ProfileEntry>& entri
         {
             render_timeline_entry(filtered_entries[idx], row_height, time_range, min_time, canvas_pos, canvas_size, y_offset, idx);
         }
+
+        for (const core::OpenScope* scope : thread_open_scopes[thread_id])
+        {
+            max_depth = std::max(max_depth, scope->depth);
+            const float x_start = ((scope->start_ns - min_time) / static_cast<float>(time_range)) * canvas_size.x * impl_->timeline_zoom_;
+            const float x_end = ((scope->now_ns() - min_time) / static_cast<float>(time_range)) * canvas_size.x * impl_->timeline_zoom_;
+            const float y_pos = y_offset + scope->depth * row_height;
+            const ImVec2 bar_min(canvas_pos.x + x_start, y_pos);
+            const ImVec2 bar_max(canvas_pos.x + x_start + std::max(x_end - x_start, 2.0f), y_pos + row_height - 2.0f);
+
+            // Open on the right: no closing edge, since the scope has not ended.
+            draw_list->AddRectFilled(bar_min, bar_max, IM_COL32(230, 80, 80, 140));
+            draw_list->AddLine(bar_min, ImVec2(bar_max.x, bar_min.y), IM_COL32(255, 120, 120, 255));
+            draw_list->AddLine(ImVec2(bar_min.x, bar_max.y), bar_max, IM_COL32(255, 120, 120, 255));
+            draw_list->AddLine(bar_min, ImVec2(bar_min.x, bar_max.y), IM_COL32(255, 120, 120, 255));
+
+            std::ostringstream label;
+            label << scope->name << " (open, " << scope->elapsed_ns / 1000000.0 << " ms)";
+            draw_list->PushClipRect(bar_min, bar_max, true);
+            draw_list->AddText(ImVec2(bar_min.x + 2.0f, bar_min.y + 2.0f), IM_COL32(255, 255, 255, 255), label.str().c_str());
+            draw_list->PopClipRect();
+        }
         
         y_offset += (max_depth + 1) * row_height + 10.0f;
     }
+
+    render_counter_tracks(time_range, min_time, canvas_pos, canvas_size, y_offset);
     
     ImGui::End();
 }
 
+float ProfilerUI::render_counter_tracks(const int64_t time_range_ns,
+                                        const int64_t min_time_ns,
+                                        const ImVec2 canvas_pos,
+                                        const ImVec2 canvas_size,
+                                        float base_y_offset) const
+{
+    const auto& series = impl_->counter_series_;
+
+    ImDrawList* draw_list = ImGui::GetWindowDrawList();
+    constexpr float track_height = 40.0f;
+    constexpr ImU32 line_color = IM_COL32(120, 220, 255, 255);
+
+    for (const auto& [name, points] : series)
+    {
+        double min_value = points.front().second;
+        double max_value = points.front().second;
+        for (const auto& point : points)
+        {
+            min_value = std::min(min_value, point.second);
+            max_value = std::max(max_value, point.second);
+        }
+        const double value_range = max_value > min_value ? max_value - min_value : 1.0;
+
+        std::ostringstream label;
+        label << name << " [" << min_value << " - " << max_value << "] last " << points.back().second;
+        draw_list->AddText(ImVec2(canvas_pos.x, base_y_offset), IM_COL32(200, 200, 200, 255), label.str().c_str());
+        base_y_offset += 20.0f;
+
+        // Step plot: a counter keeps its value until the next sample.
+        ImVec2 previous;
+        for (size_t i = 0; i < points.size(); ++i)
+        {
+            const float x = canvas_pos.x + ((points[i].first - min_time_ns) / static_cast<float>(time_range_ns)) * canvas_size.x * impl_->timeline_zoom_;
+            const float y = base_y_offset + track_height - static_cast<float>((points[i].second - min_value) / value_range) * track_height;
+            if (i > 0)
+            {
+                draw_list->AddLine(previous, ImVec2(x, previous.y), line_color, 1.5f);
+                draw_list->AddLine(ImVec2(x, previous.y), ImVec2(x, y), line_color, 1.5f);
+            }
+            previous = ImVec2(x, y);
+        }
+
+        base_y_offset += track_height + 10.0f;
+    }
+
+    return base_y_offset;
+}
+
 void ProfilerUI::show_flamegraph_view(const std::vector<core::ProfileEntry>& entries) const
 {
     ImGui::Begin("Flame Graph", &impl_->show_flamegraph_);
@@ -492,40 +684,63 @@ void ProfilerUI::show_flamegraph_view(const std::vector<core::ProfileEntry>& ent
     
     ImGui::InvisibleButton("flamegraph_canvas", canvas_size);
 
-    std::map<int, std::vector<size_t>> depth_map;
+    analysis::CallTree tree;
+    tree.build(entries);
+
     int64_t total_time = 0;
-    
-    for (size_t i = 0; i < entries.size(); ++i)
+    for (const size_t root : tree.roots())
     {
-        depth_map[entries[i].depth].push_back(i);
-        if (entries[i].depth == 0)
-        {
-            total_time += entries[i].duration_ns();
-        }
+        total_time += entries[root].duration_ns();
     }
     
     if (total_time == 0) total_time = 1;
-    
-    const int max_depth = depth_map.empty() ? 0 : depth_map.rbegin()->first;
-    const float row_height = std::min(30.0f, canvas_size.y / (max_depth + 1));
 
-    for (int depth = max_depth; depth >= 0; --depth)
+    // Children are laid out from their parent's left edge, one row up.
+    struct FlameNode
     {
-        const float y_pos = canvas_pos.y + canvas_size.y - (depth + 1) * row_height;
-        float x_offset = 0.0f;
-        
-        for (const size_t idx : depth_map[depth])
+        size_t index;
+        float x;
+        float width;
+        int level;
+    };
+    auto width_of = [&entries, total_time, &canvas_size](const size_t idx)
+    {
+        return (entries[idx].duration_ns() / static_cast<float>(total_time)) * canvas_size.x;
+    };
+
+    std::vector<FlameNode> nodes;
+    std::vector<FlameNode> pending;
+    float root_x = 0.0f;
+    for (const size_t root : tree.roots())
+    {
+        pending.push_back({root, root_x, width_of(root), 0});
+        root_x += pending.back().width;
+    }
+
+    int max_level = 0;
+    while (!pending.empty())
+    {
+        const FlameNode node = pending.back();
+        pending.pop_back();
+        nodes.push_back(node);
+        max_level = std::max(max_level, node.level);
+
+        float child_x = node.x;
+        for (const size_t child : tree.children(node.index))
         {
-            const auto& entry = entries[idx];
-            
-            float width = (entry.duration_ns() / static_cast<float>(total_time)) * canvas_size.x;
-            width = std::max(width, 2.0f);
-            
-            render_flamegraph_node(entry, canvas_pos.x + x_offset, y_pos, width, row_height - 1.0f, idx);
-            
-            x_offset += width;
+            pending.push_back({child, child_x, width_of(child), node.level + 1});
+            child_x += pending.back().width;
         }
     }
+
+    const float row_height = std::min(30.0f, canvas_size.y / (max_level + 1));
+
+    for (const auto& node : nodes)
+    {
+        const float y_pos = canvas_pos.y + canvas_size.y - (node.level + 1) * row_height;
+        render_flamegraph_node(entries[node.index], canvas_pos.x + node.x, y_pos, std::max(node.width, 2.0f),
+                               row_height - 1.0f, node.index);
+    }
     
     ImGui::End();
 }
@@ -541,12 +756,11 @@ void ProfilerUI::show_call_tree_view(const std::vector<core::ProfileEntry>& entr
         return;
     }
     
-    for (const auto& entry : entries)
+    analysis::CallTree tree;
+    tree.build(entries);
+    for (const size_t root : tree.roots())
     {
-        if (entry.depth == 0)
-        {
-            render_call_tree_node(entry, 0);
-        }
+        render_call_tree_node(entries, tree, root);
     }
     
     ImGui::End();
@@ -659,6 +873,76 @@ void ProfilerUI::show_statistics_view(const std::vector<core::ProfileEntry>& ent
         
         ImGui::EndTable();
     }
+
+    // Scopes under the session's entry threshold have no entries above. Only
+    // the accumulators are read here; recorded calls come from the entries.
+    const auto site_stats = core::ProfilerEngine::getInstance().get_accumulated_stats();
+    if (std::ranges::any_of(site_stats, [](const core::CallSiteStats& stats) { return stats.folded_count > 0; }))
+    {
+        ImGui::Separator();
+        ImGui::Text("Folded Scopes");
+        if (ImGui::BeginTable("FoldedStats", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+        {
+            ImGui::TableSetupColumn("Scope");
+            ImGui::TableSetupColumn("Folded Calls");
+            ImGui::TableSetupColumn("Folded Total (ms)");
+            ImGui::TableSetupColumn("Recorded Calls");
+            ImGui::TableHeadersRow();
+
+            for (const auto& stats : site_stats)
+            {
+                if (stats.folded_count == 0)
+                {
+                    continue;
+                }
+                ImGui::TableNextRow();
+                ImGui::TableSetColumnIndex(0);
+                ImGui::Text("%s", stats.name.c_str());
+                ImGui::TableSetColumnIndex(1);
+                ImGui::Text("%llu", static_cast<unsigned long long>(stats.folded_count));
+                ImGui::TableSetColumnIndex(2);
+                ImGui::Text("%.3f", stats.folded_total_ns / 1000000.0);
+                ImGui::TableSetColumnIndex(3);
+                const auto recorded = all_stats.find(stats.name);
+                ImGui::Text("%zu", recorded != all_stats.end() ? recorded->second.call_count : size_t{0});
+            }
+
+            ImGui::EndTable();
+        }
+    }
+
+    // Scopes that ran over their RUNSCOPE_PROFILE_SCOPE_BUDGET, with the
+    // children of the slowest ones.
+    const auto budget_stats = core::ProfilerEngine::getInstance().get_budget_stats();
+    if (!budget_stats.empty())
+    {
+        ImGui::Separator();
+        ImGui::Text("Budget Violations");
+        for (const auto& site : budget_stats)
+        {
+            ImGui::PushID(site.name.c_str());
+            if (ImGui::TreeNode("site", "%s: %llu over %.3f ms", site.name.c_str(),
+                                static_cast<unsigned long long>(site.violations), site.budget_ns / 1000000.0))
+            {
+                for (size_t i = 0; i < site.worst.size(); ++i)
+                {
+                    const auto& violation = site.worst[i];
+                    if (ImGui::TreeNode(reinterpret_cast<void*>(i), "%.3f ms (self %.3f ms)",
+                                        violation.duration_ns / 1000000.0, violation.self_ns() / 1000000.0))
+                    {
+                        for (const auto& child : violation.children)
+                        {
+                            ImGui::BulletText("%s x%llu: %.3f ms", child.name.c_str(),
+                                              static_cast<unsigned long long>(child.count), child.total_ns / 1000000.0);
+                        }
+                        ImGui::TreePop();
+                    }
+                }
+                ImGui::TreePop();
+            }
+            ImGui::PopID();
+        }
+    }
     
     ImGui::End();
 }
@@ -804,7 +1088,8 @@ void ProfilerUI::show_process_attachment() const
 
 void ProfilerUI::show_memory_profiler() const
 {
-    auto memory = impl_->current_session_.get_memory_usage();
+    // Filled by scopes when the application links runscope_alloc_hook.
+    const auto& memory = impl_->memory_usage_;
     ImGui::Begin("Memory Profiler", &impl_->show_memory_profiler_);
     if (ImGui::BeginTable("MemoryUsageTable", 2, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
     {
@@ -828,16 +1113,18 @@ void ProfilerUI::show_memory_profiler() const
 
 void ProfilerUI::show_cpu_monitor() const
 {
-    auto cpu_usage = impl_->current_session_.get_cpu_usage();
+    // Filled for sessions started with SessionOptions::cpu_time.
     ImGui::Begin("CPU Monitor", &impl_->show_cpu_monitor_);
     if (ImGui::BeginTable("CPUUsageTable", 2, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
     {
-        ImGui::TableSetupColumn("Process");
+        ImGui::TableSetupColumn("Scope");
         ImGui::TableSetupColumn("CPU Usage (%)");
         ImGui::TableHeadersRow();
 
-        for (const auto& [proc, cpu] : cpu_usage)
+        // Weighted by duration: total CPU time over total wall time per name.
+        for (const auto& [proc, total] : impl_->cpu_totals_)
         {
+            const double cpu = total.second > 0 ? 100.0 * static_cast<double>(total.first) / static_cast<double>(total.second) : 0.0;
             ImGui::TableNextRow();
             ImGui::TableSetColumnIndex(0);
             ImGui::Text("%s", proc.c_str());
@@ -1022,17 +1309,24 @@ void ProfilerUI::render_flamegraph_node(const core::ProfileEntry& entry,
     }
 }
 
-void ProfilerUI::render_call_tree_node(const core::ProfileEntry& entry, const int depth)
+void ProfilerUI::render_call_tree_node(const std::vector<core::ProfileEntry>& entries,
+                                       const analysis::CallTree& tree,
+                                       const size_t index)
 {
-    const std::string label = entry.name + " (" + std::to_string(entry.duration_ms()) + " ms)";
-    if (ImGui::TreeNode(label.c_str()))
+    const auto& entry = entries[index];
+    const std::string label = entry.name + " (" + std::to_string(entry.duration_ms()) + " ms, self " +
+                              std::to_string(tree.self_time_ns(index) / 1000000.0) + " ms)";
+    ImGui::PushID(static_cast<int>(index));
+    const ImGuiTreeNodeFlags flags = tree.children(index).empty() ? ImGuiTreeNodeFlags_Leaf : 0;
+    if (ImGui::TreeNodeEx(label.c_str(), flags))
     {
-        for (const auto& child : entry.children)
+        for (const size_t child : tree.children(index))
         {
-            render_call_tree_node(*child, depth + 1);
+            render_call_tree_node(entries, tree, child);
         }
         ImGui::TreePop();
     }
+    ImGui::PopID();
 }
 
 void ProfilerUI::set_selected_entry(size_t index) const
@@ -0,0 +1,160 @@
+// Compiled with -finstrument-functions; see tests/CMakeLists.txt.
+
+#include <gtest/gtest.h>
+#include "runscope/runscope_v2.hpp"
+#include <algorithm>
+#include <thread>
+
+using namespace runscope::core;
+
+// Global so dladdr can name them in the exported symbol table.
+[[gnu::noinline]] int runscope_test_traced_leaf(const int x)
+{
+    asm volatile("");
+    return x * 2;
+}
+
+[[gnu::noinline]] int runscope_test_traced_parent(const int n)
+{
+    int sum = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        sum += runscope_test_traced_leaf(i);
+    }
+    return sum;
+}
+
+[[gnu::noinline]] int runscope_test_traced_hot(const int x)
+{
+    asm volatile("");
+    return x + 1;
+}
+
+[[gnu::noinline]] void runscope_test_traced_with_scope()
+{
+    RUNSCOPE_PROFILE_SCOPE("inside_function");
+    asm volatile("");
+}
+
+class AutoInstrumentTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        ProfilerEngine::getInstance().begin_session("autoinstrument_test");
+    }
+
+    void TearDown() override
+    {
+        ProfilerEngine::getInstance().end_session();
+        ProfilerEngine::getInstance().set_categories(category::All);
+        FunctionTracer::set_hit_limit(0);
+    }
+
+    template<typename Fn>
+    static std::string name_of(Fn* function)
+    {
+        return runscope::platform::SignalSampler::getInstance().symbolize(reinterpret_cast<uintptr_t>(function)).name;
+    }
+
+    static std::vector<ProfileEntry> named(const std::vector<ProfileEntry>& entries, const std::string& name)
+    {
+        std::vector<ProfileEntry> result;
+        std::ranges::copy_if(entries, std::back_inserter(result), [&name](const ProfileEntry& e) { return e.name == name; });
+        return result;
+    }
+};
+
+TEST_F(AutoInstrumentTest, RecordsNestedFunctions)
+{
+    auto& engine = ProfilerEngine::getInstance();
+    EXPECT_EQ(runscope_test_traced_parent(3), 6);
+
+    const auto entries = engine.get_entries();
+    const std::string parent_name = name_of(&runscope_test_traced_parent);
+    const auto parent = std::ranges::find(entries, parent_name, &ProfileEntry::name);
+    ASSERT_NE(parent, entries.end());
+    const auto parent_index = static_cast<int64_t>(parent - entries.begin());
+
+    const auto leaves = named(entries, name_of(&runscope_test_traced_leaf));
+    ASSERT_EQ(leaves.size(), 3);
+    for (const auto& leaf : leaves)
+    {
+        EXPECT_EQ(leaf.parent, parent_index);
+        EXPECT_EQ(leaf.depth, parent->depth + 1);
+        EXPECT_GE(leaf.start_ns, parent->start_ns);
+        EXPECT_LE(leaf.end_ns, parent->end_ns);
+        EXPECT_EQ(leaf.thread_id, std::this_thread::get_id());
+    }
+}
+
+TEST_F(AutoInstrumentTest, FunctionsNestWithScopes)
+{
+    auto& engine = ProfilerEngine::getInstance();
+    runscope_test_traced_with_scope();
+
+    const auto entries = engine.get_entries();
+    const auto function = std::ranges::find(entries, name_of(&runscope_test_traced_with_scope), &ProfileEntry::name);
+    const auto scope = std::ranges::find(entries, "inside_function", &ProfileEntry::name);
+    ASSERT_NE(function, entries.end());
+    ASSERT_NE(scope, entries.end());
+    EXPECT_EQ(scope->parent, function - entries.begin());
+    EXPECT_EQ(scope->depth, function->depth + 1);
+}
+
+TEST_F(AutoInstrumentTest, ExcludedFunctionsAreSkipped)
+{
+    auto& engine = ProfilerEngine::getInstance();
+    FunctionTracer::exclude(reinterpret_cast<const void*>(&runscope_test_traced_leaf));
+    runscope_test_traced_parent(3);
+    FunctionTracer::include(reinterpret_cast<const void*>(&runscope_test_traced_leaf));
+
+    const auto entries = engine.get_entries();
+    EXPECT_EQ(named(entries, name_of(&runscope_test_traced_parent)).size(), 1);
+    EXPECT_TRUE(named(entries, name_of(&runscope_test_traced_leaf)).empty());
+}
+
+TEST_F(AutoInstrumentTest, HitLimitDropsHotFunctions)
+{
+    auto& engine = ProfilerEngine::getInstance();
+    const auto* hot = reinterpret_cast<const void*>(&runscope_test_traced_hot);
+    const uint64_t before = FunctionTracer::hits(hot);
+    FunctionTracer::set_hit_limit(before + 5);
+
+    int value = 0;
+    for (int i = 0; i < 10; ++i)
+    {
+        value = runscope_test_traced_hot(value);
+    }
+    EXPECT_EQ(value, 10);
+    EXPECT_EQ(FunctionTracer::hits(hot), before + 10);
+    EXPECT_EQ(named(engine.get_entries(), name_of(&runscope_test_traced_hot)).size(), 5);
+}
+
+TEST_F(AutoInstrumentTest, HitsAreSummedAcrossThreads)
+{
+    const auto* leaf = reinterpret_cast<const void*>(&runscope_test_traced_leaf);
+    const uint64_t before = FunctionTracer::hits(leaf);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([] { runscope_test_traced_parent(25); });
+    }
+    runscope_test_traced_parent(25);
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    EXPECT_EQ(FunctionTracer::hits(leaf), before + 125);
+}
+
+TEST_F(AutoInstrumentTest, FunctionsCategoryFilter)
+{
+    auto& engine = ProfilerEngine::getInstance();
+    engine.set_categories(category::All & ~category::Functions);
+    runscope_test_traced_parent(3);
+
+    EXPECT_TRUE(named(engine.get_entries(), name_of(&runscope_test_traced_parent)).empty());
+}
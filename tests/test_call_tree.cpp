@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+#include "runscope/analysis/call_tree.hpp"
+#include "runscope/analysis/statistics.hpp"
+
+using namespace runscope::analysis;
+using namespace runscope::core;
+
+namespace
+{
+    ProfileEntry entry(const std::string& name, const int64_t start_ns, const int64_t end_ns, const int64_t parent)
+    {
+        ProfileEntry e;
+        e.name = name;
+        e.start_ns = start_ns;
+        e.end_ns = end_ns;
+        e.parent = parent;
+        return e;
+    }
+
+    // In end order, as a session returns them: leaf, child, leaf, root, root.
+    std::vector<ProfileEntry> sample_entries()
+    {
+        std::vector<ProfileEntry> entries;
+        entries.push_back(entry("parse", 10, 30, 1));
+        entries.push_back(entry("load", 5, 50, 3));
+        entries.push_back(entry("draw", 60, 90, 3));
+        entries.push_back(entry("frame", 0, 100, -1));
+        entries.push_back(entry("idle", 100, 120, -1));
+        return entries;
+    }
+}
+
+TEST(CallTreeTest, BuildsChildListsFromParentLinks)
+{
+    const auto entries = sample_entries();
+    CallTree tree;
+    tree.build(entries);
+
+    ASSERT_EQ(tree.size(), entries.size());
+    EXPECT_EQ(tree.roots(), (std::vector<size_t>{3, 4}));
+    EXPECT_EQ(tree.children(3), (std::vector<size_t>{1, 2}));
+    EXPECT_EQ(tree.children(1), (std::vector<size_t>{0}));
+    EXPECT_TRUE(tree.children(0).empty());
+
+    EXPECT_EQ(tree.self_time_ns(3), 100 - 45 - 30);
+    EXPECT_EQ(tree.self_time_ns(1), 45 - 20);
+    EXPECT_EQ(tree.self_time_ns(0), 20);
+}
+
+TEST(CallTreeTest, InvalidParentsBecomeRoots)
+{
+    std::vector<ProfileEntry> entries;
+    entries.push_back(entry("self", 0, 10, 0));
+    entries.push_back(entry("missing", 0, 10, 7));
+
+    CallTree tree;
+    tree.build(entries);
+    EXPECT_EQ(tree.roots(), (std::vector<size_t>{0, 1}));
+}
+
+TEST(CallTreeTest, StatisticsUseSelfTime)
+{
+    StatisticsAnalyzer analyzer;
+    analyzer.analyze(sample_entries());
+
+    const auto stats = analyzer.get_function_stats();
+    EXPECT_DOUBLE_EQ(stats.at("frame").self_time_ns, 25.0);
+    EXPECT_DOUBLE_EQ(stats.at("load").self_time_ns, 25.0);
+    EXPECT_DOUBLE_EQ(stats.at("draw").self_time_ns, 30.0);
+    EXPECT_EQ(stats.at("frame").total_time_ns, 100);
+}
@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+#include "runscope/core/clock.hpp"
+#include <thread>
+#include <chrono>
+
+using namespace runscope::core;
+
+class ClockTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        previous_source_ = Clock::source();
+    }
+
+    void TearDown() override
+    {
+        Clock::set_source(previous_source_);
+        Clock::calibrate();
+    }
+
+    ClockSource previous_source_{ClockSource::System};
+};
+
+TEST_F(ClockTest, SystemSourceIsIdentity)
+{
+    Clock::set_source(ClockSource::System);
+    const auto calibration = Clock::calibrate();
+
+    EXPECT_EQ(calibration.source, ClockSource::System);
+    EXPECT_EQ(Clock::to_nanoseconds(123456789, calibration), 123456789);
+
+    const int64_t before = Clock::now_nanoseconds();
+    const int64_t ticks = Clock::ticks();
+    const int64_t after = Clock::now_nanoseconds();
+    EXPECT_GE(ticks, before);
+    EXPECT_LE(ticks, after);
+}
+
+TEST_F(ClockTest, TscMatchesSystemClock)
+{
+    if (!Clock::set_source(ClockSource::Tsc))
+    {
+        GTEST_SKIP() << "No invariant TSC on this machine";
+    }
+
+    const auto calibration = Clock::calibrate();
+    EXPECT_EQ(calibration.source, ClockSource::Tsc);
+    EXPECT_GT(calibration.ns_per_tick, 0.0);
+
+    const int64_t start_ticks = Clock::ticks();
+    const int64_t start_ns = Clock::now_nanoseconds();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    const int64_t end_ticks = Clock::ticks();
+    const int64_t end_ns = Clock::now_nanoseconds();
+
+    const int64_t measured = Clock::ticks_to_duration_ns(end_ticks - start_ticks, calibration);
+    EXPECT_NEAR(static_cast<double>(measured), static_cast<double>(end_ns - start_ns), 1'000'000.0);
+    EXPECT_NEAR(static_cast<double>(Clock::to_nanoseconds(start_ticks, calibration)), static_cast<double>(start_ns), 1'000'000.0);
+}
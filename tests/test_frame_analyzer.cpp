@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include "runscope/analysis/frame_analyzer.hpp"
+#include <thread>
+
+using namespace runscope::analysis;
+using namespace runscope::core;
+
+class FrameAnalyzerTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        // 100 frames of 10 ms each, except frame 42 which takes 50 ms.
+        int64_t time = 0;
+        for (int i = 0; i <= 100; ++i)
+        {
+            marks.push_back(mark("tick", time));
+            if (i < 100)
+            {
+                entries.push_back(entry("update", time + 1000, time + 2000));
+                entries.push_back(entry("render", time + 3000, time + 9000));
+            }
+            time += i == 42 ? 50000000 : 10000000;
+        }
+        marks.push_back(mark("other", 5));
+    }
+
+    static FrameMark mark(const std::string& name, const int64_t time_ns)
+    {
+        FrameMark m;
+        m.name = name;
+        m.thread_id = std::this_thread::get_id();
+        m.time_ns = time_ns;
+        return m;
+    }
+
+    static ProfileEntry entry(const std::string& name, const int64_t start_ns, const int64_t end_ns)
+    {
+        ProfileEntry e;
+        e.name = name;
+        e.start_ns = start_ns;
+        e.end_ns = end_ns;
+        return e;
+    }
+
+    std::vector<FrameMark> marks;
+    std::vector<ProfileEntry> entries;
+};
+
+TEST_F(FrameAnalyzerTest, FrameTimes)
+{
+    FrameAnalyzer analyzer;
+    analyzer.analyze(marks, entries, "tick");
+
+    ASSERT_EQ(analyzer.frame_count(), 100);
+    EXPECT_EQ(analyzer.get_frame(42).duration_ns(), 50000000);
+
+    const auto stats = analyzer.get_stats();
+    EXPECT_EQ(stats.frame_count, 100);
+    EXPECT_EQ(stats.min_time_ns, 10000000);
+    EXPECT_EQ(stats.max_time_ns, 50000000);
+    EXPECT_EQ(stats.p50_time_ns, 10000000);
+    EXPECT_EQ(stats.p99_time_ns, 10000000);
+    EXPECT_EQ(stats.p999_time_ns, 50000000);
+
+    const auto slowest = analyzer.get_slowest_frames(1);
+    ASSERT_EQ(slowest.size(), 1);
+    EXPECT_EQ(slowest[0].index, 42);
+}
+
+TEST_F(FrameAnalyzerTest, Histogram)
+{
+    FrameAnalyzer analyzer;
+    analyzer.analyze(marks, entries, "tick");
+
+    const auto histogram = analyzer.get_histogram(4);
+    ASSERT_EQ(histogram.counts.size(), 4);
+    EXPECT_EQ(histogram.counts.front(), 99);
+    EXPECT_EQ(histogram.counts.back(), 1);
+}
+
+TEST_F(FrameAnalyzerTest, EntriesInFrame)
+{
+    FrameAnalyzer analyzer;
+    analyzer.analyze(marks, entries);
+
+    EXPECT_EQ(analyzer.frame_name(), "tick");
+    const auto in_frame = analyzer.get_entries_in_frame(43);
+    ASSERT_EQ(in_frame.size(), 2);
+    EXPECT_EQ(in_frame[0].name, "update");
+    EXPECT_EQ(in_frame[1].name, "render");
+    EXPECT_EQ(in_frame[0].start_ns, analyzer.get_frame(43).start_ns + 1000);
+
+    EXPECT_EQ(analyzer.frame_at(analyzer.get_frame(10).start_ns + 5), 10);
+    EXPECT_EQ(analyzer.frame_at(-1), analyzer.frame_count());
+    EXPECT_TRUE(analyzer.get_entries_in_frame(1000).empty());
+}
@@ -0,0 +1,144 @@
+#include <gtest/gtest.h>
+#include "runscope/analysis/lock_analyzer.hpp"
+#include <thread>
+
+using namespace runscope::analysis;
+using namespace runscope::core;
+
+class LockAnalyzerTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        const ThreadId worker = std::this_thread::get_id();
+
+        // "update" contains "flush"; two waits on "queue" happen inside flush,
+        // one inside update after flush ended.
+        entries.push_back(entry("update", worker, 0, 10000, 0));
+        entries.push_back(entry("flush", worker, 1000, 5000, 1));
+        events.push_back(event(LockEvent::Kind::Wait, "queue", worker, 1500, 2500));
+        events.push_back(event(LockEvent::Kind::Wait, "queue", worker, 3000, 4500));
+        events.push_back(event(LockEvent::Kind::Wait, "queue", worker, 6000, 6200));
+        events.push_back(event(LockEvent::Kind::Hold, "queue", worker, 7000, 9000));
+        events.push_back(event(LockEvent::Kind::Wait, "cache", worker, 8000, 8100));
+        events.push_back(event(LockEvent::Kind::Wait, "cache", ThreadId(), 20000, 20300));
+    }
+
+    static ProfileEntry entry(const std::string& name, const ThreadId thread, const int64_t start_ns,
+                              const int64_t end_ns, const int depth)
+    {
+        ProfileEntry e;
+        e.name = name;
+        e.thread_id = thread;
+        e.start_ns = start_ns;
+        e.end_ns = end_ns;
+        e.depth = depth;
+        return e;
+    }
+
+    static LockEvent event(const LockEvent::Kind kind, const std::string& name, const ThreadId thread,
+                           const int64_t start_ns, const int64_t end_ns)
+    {
+        LockEvent e;
+        e.kind = kind;
+        e.name = name;
+        e.thread_id = thread;
+        e.start_ns = start_ns;
+        e.end_ns = end_ns;
+        return e;
+    }
+
+    std::vector<ProfileEntry> entries;
+    std::vector<LockEvent> events;
+};
+
+TEST_F(LockAnalyzerTest, RanksLocksByTotalWait)
+{
+    LockAnalyzer analyzer;
+    analyzer.analyze(events, entries);
+
+    const auto& locks = analyzer.get_lock_stats();
+    ASSERT_EQ(locks.size(), 2);
+    EXPECT_EQ(locks[0].name, "queue");
+    EXPECT_EQ(locks[0].wait_count, 3);
+    EXPECT_EQ(locks[0].total_wait_ns, 2700);
+    EXPECT_EQ(locks[0].max_wait_ns, 1500);
+    EXPECT_EQ(locks[0].hold_count, 1);
+    EXPECT_EQ(locks[0].total_hold_ns, 2000);
+    EXPECT_EQ(locks[1].name, "cache");
+    EXPECT_EQ(locks[1].total_wait_ns, 400);
+    EXPECT_EQ(analyzer.total_wait_ns(), 3100);
+
+    EXPECT_EQ(analyzer.get_top_locks(1).size(), 1);
+    EXPECT_EQ(analyzer.get_stats_for_lock("cache").wait_count, 2);
+    EXPECT_EQ(analyzer.get_stats_for_lock("missing").wait_count, 0);
+}
+
+TEST_F(LockAnalyzerTest, AttributesWaitsToInnermostScope)
+{
+    LockAnalyzer analyzer;
+    analyzer.analyze(events, entries);
+
+    const auto queue = analyzer.get_stats_for_lock("queue");
+    ASSERT_EQ(queue.blocked_scopes.size(), 2);
+    EXPECT_EQ(queue.blocked_scopes[0].name, "flush");
+    EXPECT_EQ(queue.blocked_scopes[0].wait_count, 2);
+    EXPECT_EQ(queue.blocked_scopes[0].total_wait_ns, 2500);
+    EXPECT_EQ(queue.blocked_scopes[1].name, "update");
+    EXPECT_EQ(queue.blocked_scopes[1].total_wait_ns, 200);
+
+    // The wait on a thread without entries counts for the lock but no scope.
+    const auto cache = analyzer.get_stats_for_lock("cache");
+    ASSERT_EQ(cache.blocked_scopes.size(), 1);
+    EXPECT_EQ(cache.blocked_scopes[0].name, "update");
+}
+
+TEST_F(LockAnalyzerTest, SeparatesSitesSharingAName)
+{
+    const ThreadId worker = std::this_thread::get_id();
+    events.clear();
+    for (const int line : {10, 20, 20})
+    {
+        auto wait = event(LockEvent::Kind::Wait, "mutex", worker, 1500 + line * 100, 1600 + line * 100);
+        wait.file = "pool.cpp";
+        wait.line = line;
+        events.push_back(wait);
+    }
+
+    LockAnalyzer analyzer;
+    analyzer.analyze(events, entries);
+
+    const auto& locks = analyzer.get_lock_stats();
+    ASSERT_EQ(locks.size(), 2);
+    EXPECT_EQ(locks[0].line, 20);
+    EXPECT_EQ(locks[0].wait_count, 2);
+    EXPECT_EQ(locks[1].line, 10);
+    EXPECT_EQ(locks[1].wait_count, 1);
+    EXPECT_EQ(analyzer.get_stats_for_lock("mutex").line, 20);
+}
+
+TEST_F(LockAnalyzerTest, InnermostScopeAmongSiblingsAndSharedStarts)
+{
+    const ThreadId worker = std::this_thread::get_id();
+    // Inside update: "flush" (1000-5000), then "step" and its child "solve"
+    // starting together at 5500, then sibling scopes without waits.
+    entries.push_back(entry("step", worker, 5500, 9500, 1));
+    entries.push_back(entry("solve", worker, 5500, 7000, 2));
+    for (int i = 0; i < 5; ++i)
+    {
+        entries.push_back(entry("tick", worker, 9600 + i * 50, 9640 + i * 50, 1));
+    }
+    events.clear();
+    events.push_back(event(LockEvent::Kind::Wait, "queue", worker, 5500, 6000));
+    events.push_back(event(LockEvent::Kind::Wait, "queue", worker, 7500, 8000));
+    events.push_back(event(LockEvent::Kind::Wait, "queue", worker, 9900, 9950));
+
+    LockAnalyzer analyzer;
+    analyzer.analyze(events, entries);
+
+    const auto queue = analyzer.get_stats_for_lock("queue");
+    ASSERT_EQ(queue.blocked_scopes.size(), 3);
+    EXPECT_EQ(queue.blocked_scopes[0].name, "solve");
+    EXPECT_EQ(queue.blocked_scopes[1].name, "step");
+    EXPECT_EQ(queue.blocked_scopes[2].name, "update");
+}
@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+#include "runscope/analysis/overhead.hpp"
+#include <thread>
+
+using namespace runscope::analysis;
+using namespace runscope::core;
+
+namespace
+{
+    ProfileEntry entry(const std::string& name, const ThreadId thread, const int64_t start_ns,
+                       const int64_t end_ns, const int depth)
+    {
+        ProfileEntry e;
+        e.name = name;
+        e.thread_id = thread;
+        e.start_ns = start_ns;
+        e.end_ns = end_ns;
+        e.depth = depth;
+        return e;
+    }
+
+    ProfilerOverhead overhead()
+    {
+        ProfilerOverhead o;
+        o.self_ns = 10;
+        o.total_ns = 50;
+        o.perf_self_ns = 100;
+        o.perf_total_ns = 400;
+        return o;
+    }
+}
+
+TEST(OverheadTest, SubtractsSelfAndChildCosts)
+{
+    const ThreadId thread = std::this_thread::get_id();
+    std::vector<ProfileEntry> entries;
+    entries.push_back(entry("first", thread, 100, 300, 1));
+    entries.push_back(entry("parent", thread, 0, 1000, 0));
+    entries.push_back(entry("second", thread, 400, 600, 1));
+    entries.push_back(entry("next", thread, 1200, 1300, 0));
+
+    const auto result = compensate_overhead(entries, overhead());
+    ASSERT_EQ(result.size(), 4);
+
+    // Returned in the order given.
+    EXPECT_EQ(result[0].name, "first");
+    EXPECT_EQ(result[0].start_ns, 100);
+    EXPECT_EQ(result[0].duration_ns(), 190);
+
+    EXPECT_EQ(result[2].start_ns, 350);
+    EXPECT_EQ(result[2].duration_ns(), 190);
+
+    // Own cost plus the full cost of both children.
+    EXPECT_EQ(result[1].start_ns, 0);
+    EXPECT_EQ(result[1].duration_ns(), 1000 - 10 - 2 * 50);
+    EXPECT_GE(result[1].end_ns, result[2].end_ns);
+
+    // Shifted by the three scopes closed before it.
+    EXPECT_EQ(result[3].start_ns, 1200 - 3 * 50);
+    EXPECT_EQ(result[3].duration_ns(), 90);
+}
+
+TEST(OverheadTest, PerfScopesUseTheirOwnCost)
+{
+    const ThreadId thread = std::this_thread::get_id();
+    std::vector<ProfileEntry> entries;
+    entries.push_back(entry("parent", thread, 0, 10000, 0));
+    entries.push_back(entry("counted", thread, 1000, 2000, 1));
+    entries[1].perf.software = true;
+
+    const auto result = compensate_overhead(entries, overhead());
+    EXPECT_EQ(result[1].duration_ns(), 900);
+    EXPECT_EQ(result[0].duration_ns(), 10000 - 10 - 400);
+}
+
+TEST(OverheadTest, ThreadsAreIndependentAndDurationsClamp)
+{
+    const ThreadId thread = std::this_thread::get_id();
+    std::vector<ProfileEntry> entries;
+    entries.push_back(entry("a", thread, 0, 100, 0));
+    entries.push_back(entry("tiny", ThreadId(), 50, 55, 0));
+    entries.push_back(entry("b", thread, 200, 300, 0));
+
+    const auto result = compensate_overhead(entries, overhead());
+    EXPECT_EQ(result[1].start_ns, 50);
+    EXPECT_EQ(result[1].duration_ns(), 0);
+    EXPECT_EQ(result[2].start_ns, 150);
+}
+
+TEST(OverheadTest, OnlyScopesLoseCostOthersMoveWithThread)
+{
+    const ThreadId thread = std::this_thread::get_id();
+    std::vector<ProfileEntry> entries;
+    entries.push_back(entry("a", thread, 0, 100, 0));
+    entries.push_back(entry("sampled", thread, 150, 180, 0));
+    entries[1].source = EntrySource::Sample;
+    entries.push_back(entry("traced", thread, 200, 300, 0));
+    entries[2].source = EntrySource::Function;
+    entries.push_back(entry("b", thread, 400, 500, 0));
+
+    OverheadShift shift;
+    const auto result = compensate_overhead(entries, overhead(), &shift);
+
+    // Non-scope entries add no cost and keep their durations.
+    EXPECT_EQ(result[1].start_ns, 100);
+    EXPECT_EQ(result[1].duration_ns(), 30);
+    EXPECT_EQ(result[2].start_ns, 150);
+    EXPECT_EQ(result[2].duration_ns(), 100);
+    EXPECT_EQ(result[3].start_ns, 350);
+
+    // Other events of the thread move the same way; other threads do not.
+    EXPECT_EQ(shift.shifted(thread, 50), 50);
+    EXPECT_EQ(shift.shifted(thread, 450), 400);
+    EXPECT_EQ(shift.shifted(thread, 600), 500);
+    EXPECT_EQ(shift.shifted(ThreadId(), 600), 600);
+}
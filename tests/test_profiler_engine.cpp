@@ -0,0 +1,1480 @@
+#include <gtest/gtest.h>
+#include "runscope/runscope_v2.hpp"
+#include "runscope/exporter.hpp"
+#include "runscope/platform/signal_sampler.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <shared_mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace runscope::core;
+
+class ProfilerEngineTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        ProfilerEngine::getInstance().begin_session("engine_test");
+    }
+
+    void TearDown() override
+    {
+        ProfilerEngine::getInstance().end_session();
+    }
+};
+
+TEST_F(ProfilerEngineTest, PerThreadRecording)
+{
+    auto& engine = ProfilerEngine::getInstance();
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; ++i)
+    {
+        threads.emplace_back([]()
+        {
+            for (int j = 0; j < 1000; ++j)
+            {
+                RUNSCOPE_PROFILE_SCOPE("worker");
+            }
+        });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    const auto entries = engine.get_entries();
+    EXPECT_EQ(entries.size(), 8000);
+    EXPECT_EQ(engine.current_session()->get_thread_info().size(), 8);
+}
+
+TEST_F(ProfilerEngineTest, ExportDoesNotRegisterThreads)
+{
+    auto& registry = ThreadRegistry::getInstance();
+    ASSERT_TRUE(registry.find(std::this_thread::get_id()).has_value());
+    EXPECT_EQ(registry.find(std::this_thread::get_id())->index, ThreadRegistry::current_index());
+
+    // Threads that never record anything, kept alive so their ids are not
+    // reused, until one has an id no exited thread registered before it.
+    std::atomic<bool> done{false};
+    std::vector<std::thread> silent;
+    std::thread::id silent_id;
+    while (silent.size() < 64 && silent_id == std::thread::id())
+    {
+        silent.emplace_back([&done]()
+        {
+            while (!done.load())
+            {
+                std::this_thread::yield();
+            }
+        });
+        if (!registry.find(silent.back().get_id()))
+        {
+            silent_id = silent.back().get_id();
+        }
+    }
+
+    std::vector<ProfileEntry> entries(1);
+    entries[0].name = "foreign";
+    entries[0].thread_id = silent_id;
+    std::vector<runscope::ProfileEntry> legacy_entries(1);
+    legacy_entries[0] = {"foreign", 0, 1000, silent_id, 0};
+    const size_t before = registry.size();
+    const std::string filename = "test_export_unregistered.json";
+    EXPECT_TRUE(runscope::Exporter::export_to_json(legacy_entries, filename));
+    EXPECT_TRUE(runscope::export_format::Exporter::export_to_chrome_trace(entries, filename));
+    std::remove(filename.c_str());
+
+    EXPECT_EQ(registry.size(), before);
+    EXPECT_FALSE(registry.find(silent_id).has_value());
+
+    done = true;
+    for (auto& thread : silent)
+    {
+        thread.join();
+    }
+    EXPECT_NE(silent_id, std::thread::id());
+}
+
+TEST_F(ProfilerEngineTest, ThreadNamesAndIndices)
+{
+    auto& engine = ProfilerEngine::getInstance();
+    auto& registry = ThreadRegistry::getInstance();
+
+    const uint16_t main_index = ThreadRegistry::current_index();
+    EXPECT_EQ(ThreadRegistry::current_index(), main_index);
+    EXPECT_EQ(registry.index_of(std::this_thread::get_id()), main_index);
+
+    uint16_t worker_index = main_index;
+    std::thread::id worker_id;
+    std::thread([&worker_index, &worker_id]()
+    {
+        RUNSCOPE_SET_THREAD_NAME("render worker");
+        RUNSCOPE_PROFILE_SCOPE("render");
+        worker_index = ThreadRegistry::current_index();
+        worker_id = std::this_thread::get_id();
+    }).join();
+    {
+        RUNSCOPE_PROFILE_SCOPE("main");
+    }
+
+    EXPECT_NE(worker_index, main_index);
+    const auto worker = registry.snapshot().at(worker_index);
+    EXPECT_EQ(worker.index, worker_index);
+    EXPECT_EQ(worker.name, "render worker");
+#if defined(__linux__) || defined(__APPLE__)
+    EXPECT_NE(worker.os_id, 0u);
+    EXPECT_EQ(worker.trace_id(), worker.os_id);
+#endif
+
+    const auto threads = engine.current_session()->get_thread_info();
+    ASSERT_EQ(threads.count(worker_id), 1);
+    EXPECT_EQ(threads.at(worker_id).name, "render worker");
+    EXPECT_EQ(threads.at(worker_id).entry_count, 1);
+
+    const std::string filename = "test_thread_names.json";
+    EXPECT_TRUE(runscope::export_format::Exporter::export_to_chrome_trace(engine.get_entries(), filename));
+    std::ifstream file(filename);
+    const std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    EXPECT_NE(content.find("\"name\": \"thread_name\""), std::string::npos);
+    EXPECT_NE(content.find("\"name\": \"render worker\""), std::string::npos);
+    EXPECT_NE(content.find("\"tid\": " + std::to_string(worker.trace_id()) + ","), std::string::npos);
+    file.close();
+    std::remove(filename.c_str());
+
+    // JSON keeps thread_id as a string and carries the trace id beside it.
+    const std::string json_filename = "test_thread_names_entries.json";
+    EXPECT_TRUE(runscope::export_format::Exporter::export_to_json(engine.get_entries(), json_filename));
+    std::ifstream json_file(json_filename);
+    const std::string json((std::istreambuf_iterator<char>(json_file)), std::istreambuf_iterator<char>());
+    std::ostringstream worker_string;
+    worker_string << worker_id;
+    EXPECT_NE(json.find("\"thread_id\": \"" + worker_string.str() + "\","), std::string::npos);
+    EXPECT_NE(json.find("\"trace_tid\": " + std::to_string(worker.trace_id()) + ","), std::string::npos);
+    EXPECT_NE(json.find("\"thread_name\": \"render worker\""), std::string::npos);
+    json_file.close();
+    std::remove(json_filename.c_str());
+}
+
+// Runs in a child process: the registry is process-wide and never hands
+// indices back, so every thread of the rest of the suite would otherwise
+// land in "other threads".
+TEST_F(ProfilerEngineTest, ThreadsPastIndexLimitShareOverflowIndex)
+{
+    GTEST_FLAG_SET(death_test_style, "threadsafe");
+    EXPECT_EXIT(
+    {
+        auto& engine = ProfilerEngine::getInstance();
+        auto& registry = ThreadRegistry::getInstance();
+        while (registry.size() < ThreadRegistry::overflow_index)
+        {
+            std::vector<std::thread> threads;
+            const size_t batch = std::min<size_t>(64, ThreadRegistry::overflow_index - registry.size());
+            for (size_t i = 0; i < batch; ++i)
+            {
+                threads.emplace_back([] { (void)ThreadRegistry::current_index(); });
+            }
+            for (auto& thread : threads)
+            {
+                thread.join();
+            }
+        }
+
+        uint16_t index = 0;
+        std::thread::id id;
+        std::thread([&index, &id]
+        {
+            RUNSCOPE_SET_THREAD_NAME("late worker");
+            RUNSCOPE_PROFILE_SCOPE("past_limit");
+            index = ThreadRegistry::current_index();
+            id = std::this_thread::get_id();
+        }).join();
+
+        const auto overflow = registry.find(id);
+        const auto entries = engine.get_entries();
+        const bool ok = index == ThreadRegistry::overflow_index && registry.size() == ThreadRegistry::overflow_index + 1u &&
+                        overflow && overflow->name == "other threads" &&
+                        entries.size() == 1 && entries[0].name == "past_limit" && entries[0].thread_id == ThreadId();
+        std::fprintf(stderr, ok ? "overflow ok\n" : "overflow failed\n");
+        // Skips static destruction, which would run with the session active.
+        std::_Exit(ok ? 0 : 1);
+    }, ::testing::ExitedWithCode(0), "overflow ok");
+}
+
+TEST_F(ProfilerEngineTest, ClearAndRecordAgain)
+{
+    auto& engine = ProfilerEngine::getInstance();
+
+    {
+        RUNSCOPE_PROFILE_SCOPE("before_clear");
+    }
+    EXPECT_EQ(engine.get_entries().size(), 1);
+
+    engine.clear();
+    EXPECT_EQ(engine.get_entries().size(), 0);
+
+    {
+        RUNSCOPE_PROFILE_SCOPE("after_clear");
+    }
+
+    const auto entries = engine.get_entries();
+    ASSERT_EQ(entries.size(), 1);
+    EXPECT_EQ(entries[0].name, "after_clear");
+}
+
+TEST_F(ProfilerEngineTest, EntriesSurviveEndSession)
+{
+    auto& engine = ProfilerEngine::getInstance();
+
+    {
+        RUNSCOPE_PROFILE_SCOPE("outer");
+        RUNSCOPE_PROFILE_SCOPE("inner");
+    }
+    engine.end_session();
+
+    {
+        RUNSCOPE_PROFILE_SCOPE("ignored");
+    }
+
+    EXPECT_FALSE(engine.is_active());
+    EXPECT_EQ(engine.get_entries().size(), 2);
+}
+
+TEST_F(ProfilerEngineTest, CallSiteDescriptors)
+{
+    auto& engine = ProfilerEngine::getInstance();
+
+    for (int i = 0; i < 3; ++i)
+    {
+        RUNSCOPE_PROFILE_SCOPE("static_site");
+    }
+
+    const std::string dynamic_name = "dynamic_" + std::to_string(42);
+    {
+        RUNSCOPE_PROFILE_SCOPE_DYNAMIC(dynamic_name);
+    }
+
+    const auto entries = engine.get_entries();
+    ASSERT_EQ(entries.size(), 4);
+    for (int i = 0; i < 3; ++i)
+    {
+        EXPECT_EQ(entries[i].name, "static_site");
+        EXPECT_EQ(entries[i].line, entries[0].line);
+        EXPECT_NE(entries[i].file.find("test_profiler_engine.cpp"), std::string::npos);
+    }
+    EXPECT_EQ(entries[3].name, "dynamic_42");
+    EXPECT_EQ(CallSiteRegistry::getInstance().intern("dynamic_42", entries[3].file, entries[3].line),
+              CallSiteRegistry::getInstance().intern(dynamic_name, entries[3].file, entries[3].line));
+}
+
+TEST_F(ProfilerEngineTest, DynamicScopesReuseIdsWithoutAllocating)
+{
+    auto& engine = ProfilerEngine::getInstance();
+
+    // One buffer holding a different name each time.
+    std::string name;
+    name.reserve(32);
+    {
+        RUNSCOPE_PROFILE_SCOPE("dynamic_outer");
+        for (int i = 0; i < 20; ++i)
+        {
+            name.assign("dynamic_item_");
+            name.push_back(static_cast<char>('a' + i % 4));
+            RUNSCOPE_PROFILE_SCOPE_DYNAMIC(name);
+        }
+    }
+
+    const auto entries = engine.get_entries();
+    ASSERT_EQ(entries.size(), 21);
+    for (const char suffix : {'a', 'b', 'c', 'd'})
+    {
+        EXPECT_EQ(std::ranges::count(entries, std::string("dynamic_item_") + suffix, &ProfileEntry::name), 5);
+    }
+    const auto outer = std::ranges::find(entries, std::string("dynamic_outer"), &ProfileEntry::name);
+    ASSERT_NE(outer, entries.end());
+    EXPECT_EQ(outer->memory_used, 0u);
+}
+
+TEST_F(ProfilerEngineTest, CalibrationLeavesOtherThreadsRecording)
+{
+    auto& engine = ProfilerEngine::getInstance();
+    const auto previous = engine.current_session();
+
+    std::atomic<bool> stop{false};
+    std::atomic<bool> started{false};
+    std::atomic<bool> categories_changed{false};
+    int recorded = 0;
+    std::thread bystander([&]
+    {
+        while (!stop.load())
+        {
+            {
+                RUNSCOPE_PROFILE_SCOPE_CAT(IO, "calibration_bystander");
+            }
+            ++recorded;
+            started = true;
+            if (!ProfilerEngine::category_enabled(category::IO))
+            {
+                categories_changed = true;
+            }
+        }
+    });
+    while (!started.load())
+    {
+        std::this_thread::yield();
+    }
+
+    // Calibrates by default; CPU time makes calibration scopes slow enough
+    // for the bystander to run alongside them.
+    SessionOptions options;
+    options.cpu_time = true;
+    engine.begin_session("calibration_test", options);
+    stop = true;
+    bystander.join();
+
+    auto bystander_entries = [](const std::vector<ProfileEntry>& entries)
+    {
+        return std::ranges::count(entries, std::string("calibration_bystander"), &ProfileEntry::name);
+    };
+    EXPECT_FALSE(categories_changed.load());
+    EXPECT_EQ(bystander_entries(previous->get_entries()) + bystander_entries(engine.get_entries()), recorded);
+    EXPECT_GT(engine.current_session()->overhead().total_ns, 0);
+}
+
+TEST_F(ProfilerEngineTest, ScopesLinkToParents)
+{
+    auto& engine = ProfilerEngine::getInstance();
+    {
+        RUNSCOPE_PROFILE_SCOPE("frame");
+        {
+            RUNSCOPE_PROFILE_SCOPE("update");
+            for (int i = 0; i < 3; ++i)
+            {
+                RUNSCOPE_PROFILE_SCOPE("step");
+            }
+        }
+        {
+            RUNSCOPE_PROFILE_SCOPE("render");
+        }
+    }
+    {
+        RUNSCOPE_PROFILE_SCOPE("idle");
+    }
+
+    const auto entries = engine.get_entries();
+    ASSERT_EQ(entries.size(), 7);
+    auto index_of = [&entries](const std::string& name)
+    {
+        const auto it = std::ranges::find(entries, name, &ProfileEntry::name);
+        return it == entries.end() ? int64_t{-2} : static_cast<int64_t>(it - entries.begin());
+    };
+
+    for (const auto& entry : entries)
+    {
+        if (entry.name == "step")
+        {
+            EXPECT_EQ(entry.parent, index_of("update"));
+        }
+    }
+    EXPECT_EQ(entries[index_of("update")].parent, index_of("frame"));
+    EXPECT_EQ(entries[index_of("render")].parent, index_of("frame"));
+    EXPECT_EQ(entries[index_of("frame")].parent, -1);
+    EXPECT_EQ(entries[index_of("idle")].parent, -1);
+
+    runscope::analysis::CallTree tree;
+    tree.build(entries);
+    EXPECT_EQ(tree.roots().size(), 2);
+    EXPECT_EQ(tree.children(index_of("update")).size(), 3);
+    EXPECT_EQ(tree.children(index_of("frame")).size(), 2);
+}
+
+TEST_F(ProfilerEngineTest, RecordEntryKeepsThreadId)
+{
+    auto& engine = ProfilerEngine::getInstance();
+
+    ThreadId other_thread;
+    std::thread([&other_thread]() { other_thread = std::this_thread::get_id(); }).join();
+
+    ProfileEntry entry;
+    entry.name = "external";
+    entry.file = "remote.cpp";
+    entry.line = 7;
+    entry.start_ns = 1000;
+    entry.end_ns = 3000;
+    entry.thread_id = other_thread;
+    entry.depth = 2;
+    engine.record_entry(entry);
+
+    const auto entries = engine.get_entries();
+    ASSERT_EQ(entries.size(), 1);
+    EXPECT_EQ(entries[0].name, "external");
+    EXPECT_EQ(entries[0].file, "remote.cpp");
+    EXPECT_EQ(entries[0].line, 7);
+    EXPECT_EQ(entries[0].duration_ns(), 2000);
+    EXPECT_EQ(entries[0].depth, 2);
+    EXPECT_EQ(entries[0].thread_id, other_thread);
+}
+
+TEST_F(ProfilerEngineTest, RuntimeCategoryFilter)
+{
+    auto& engine = ProfilerEngine::getInstance();
+    engine.set_categories(category::All & ~category::IO);
+
+    {
+        RUNSCOPE_PROFILE_SCOPE_CAT(IO, "read");
+    }
+    {
+        RUNSCOPE_PROFILE_SCOPE_CAT(Render, "draw");
+    }
+
+    engine.set_categories(category::All);
+    {
+        RUNSCOPE_PROFILE_SCOPE_CAT(IO, "write");
+    }
+
+    const auto entries = engine.get_entries();
+    ASSERT_EQ(entries.size(), 2);
+    EXPECT_EQ(entries[0].name, "draw");
+    EXPECT_EQ(entries[1].name, "write");
+}
+
+TEST_F(ProfilerEngineTest, DisabledEngineSkipsScopes)
+{
+    auto& engine = ProfilerEngine::getInstance();
+    engine.set_enabled(false);
+    EXPECT_FALSE(ProfilerEngine::category_enabled(category::All));
+    {
+        RUNSCOPE_PROFILE_SCOPE("disabled");
+    }
+    engine.set_enabled(true);
+
+    EXPECT_TRUE(ProfilerEngine::category_enabled(category::General));
+    EXPECT_EQ(engine.get_entries().size(), 0);
+}
+
+TEST_F(ProfilerEngineTest, AggregateModeKeepsSiteStats)
+{
+    auto& engine = ProfilerEngine::getInstance();
+    SessionOptions options;
+    options.recording = RecordingMode::Aggregate;
+    engine.begin_session("aggregate_test", options);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 3; ++t)
+    {
+        threads.emplace_back([]
+        {
+            for (int i = 0; i < 100; ++i)
+            {
+                RUNSCOPE_PROFILE_SCOPE("aggregated_site");
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    ProfileEntry entry;
+    entry.name = "aggregated_entry";
+    entry.file = "external.cpp";
+    entry.line = 7;
+    entry.start_ns = 1000;
+    entry.end_ns = 251000;
+    entry.thread_id = std::this_thread::get_id();
+    engine.record_entry(entry);
+
+    EXPECT_TRUE(engine.get_entries().empty());
+
+    const auto stats = engine.get_site_stats();
+    ASSERT_EQ(stats.size(), 2);
+
+    const auto site = std::find_if(stats.begin(), stats.end(),
+                                   [](const CallSiteStats& s) { return s.name == "aggregated_site"; });
+    ASSERT_NE(site, stats.end());
+    EXPECT_EQ(site->count, 300);
+    EXPECT_LE(site->min_ns, site->max_ns);
+    EXPECT_LE(site->percentile_ns(50.0), site->max_ns);
+
+    const auto external = std::find_if(stats.begin(), stats.end(),
+                                       [](const CallSiteStats& s) { return s.name == "aggregated_entry"; });
+    ASSERT_NE(external, stats.end());
+    EXPECT_EQ(external->count, 1);
+    EXPECT_NEAR(static_cast<double>(external->total_ns), 250000.0, 1000.0);
+
+    // Nothing that would grow with time is kept.
+    RUNSCOPE_FRAME_MARK("aggregate_frame");
+    RUNSCOPE_COUNTER("aggregate_counter", 1.0);
+    RUNSCOPE_ASYNC_BEGIN("aggregate_span", 1);
+    RUNSCOPE_ASYNC_END("aggregate_span", 1);
+    const auto session = engine.current_session();
+    EXPECT_TRUE(session->get_frame_marks().empty());
+    EXPECT_TRUE(session->get_counter_samples().empty());
+    EXPECT_TRUE(session->get_async_spans().empty());
+}
+
+TEST_F(ProfilerEngineTest, FullModeSiteStatsFromRecords)
+{
+    auto& engine = ProfilerEngine::getInstance();
+
+    for (int i = 0; i < 5; ++i)
+    {
+        RUNSCOPE_PROFILE_SCOPE("full_stats_site");
+    }
+
+    const auto stats = engine.get_site_stats();
+    ASSERT_EQ(stats.size(), 1);
+    EXPECT_EQ(stats[0].name, "full_stats_site");
+    EXPECT_EQ(stats[0].count, 5);
+}
+
+TEST_F(ProfilerEngineTest, CursorReturnsOnlyNewEntries)
+{
+    auto& engine = ProfilerEngine::getInstance();
+    EntryCursor cursor;
+
+    for (int i = 0; i < 1500; ++i)
+    {
+        RUNSCOPE_PROFILE_SCOPE("cursor_first");
+    }
+    EXPECT_EQ(engine.get_entries_since(cursor).size(), 1500);
+    EXPECT_TRUE(engine.get_entries_since(cursor).empty());
+
+    std::thread([]
+    {
+        RUNSCOPE_PROFILE_SCOPE("cursor_other_thread");
+    }).join();
+    for (int i = 0; i < 600; ++i)
+    {
+        RUNSCOPE_PROFILE_SCOPE("cursor_second");
+    }
+
+    const auto added = engine.get_entries_since(cursor);
+    ASSERT_EQ(added.size(), 601);
+    EXPECT_EQ(std::ranges::count_if(added, [](const ProfileEntry& e) { return e.name == "cursor_second"; }), 600);
+
+    engine.clear();
+    {
+        RUNSCOPE_PROFILE_SCOPE("cursor_after_clear");
+    }
+    const auto after_clear = engine.get_entries_since(cursor);
+    ASSERT_EQ(after_clear.size(), 1);
+    EXPECT_EQ(after_clear[0].name, "cursor_after_clear");
+}
+
+TEST_F(ProfilerEngineTest, CursorBatchesConcatenateWithValidParents)
+{
+    auto& engine = ProfilerEngine::getInstance();
+    EntryCursor cursor;
+
+    for (int batch = 0; batch < 2; ++batch)
+    {
+        RUNSCOPE_PROFILE_SCOPE("cursor_parent");
+        for (int i = 0; i < 3; ++i)
+        {
+            RUNSCOPE_PROFILE_SCOPE("cursor_child");
+        }
+    }
+    std::vector<ProfileEntry> entries = engine.get_entries_since(cursor);
+    {
+        RUNSCOPE_PROFILE_SCOPE("cursor_parent");
+        RUNSCOPE_PROFILE_SCOPE("cursor_child");
+    }
+    for (auto& entry : engine.get_entries_since(cursor))
+    {
+        entries.push_back(std::move(entry));
+    }
+
+    ASSERT_EQ(entries.size(), 10);
+    EXPECT_EQ(cursor.entries_read, 10);
+    for (const auto& entry : entries)
+    {
+        if (entry.name == "cursor_child")
+        {
+            ASSERT_GE(entry.parent, 0);
+            ASSERT_LT(entry.parent, static_cast<int64_t>(entries.size()));
+            const auto& parent = entries[static_cast<size_t>(entry.parent)];
+            EXPECT_EQ(parent.name, "cursor_parent");
+            EXPECT_LE(parent.start_ns, entry.start_ns);
+            EXPECT_GE(parent.end_ns, entry.end_ns);
+        }
+        else
+        {
+            EXPECT_EQ(entry.parent, -1);
+        }
+    }
+}
+
+TEST_F(ProfilerEngineTest, FlightRecorderKeepsRecentEvents)
+{
+    auto& engine = ProfilerEngine::getInstance();
+    SessionOptions options;
+    options.recording = RecordingMode::FlightRecorder;
+    options.ring_bytes_per_thread = 64 * sizeof(EventRecord);
+    engine.begin_session("flight_recorder_test", options);
+
+    for (int i = 0; i < 200; ++i)
+    {
+        RUNSCOPE_PROFILE_SCOPE("flight_site");
+    }
+
+    const auto entries = engine.get_entries();
+    ASSERT_EQ(entries.size(), 64);
+    EXPECT_EQ(entries[0].name, "flight_site");
+    EXPECT_EQ(engine.dropped_events(), 136);
+}
+
+TEST_F(ProfilerEngineTest, SnapshotWhileRecording)
+{
+    auto& engine = ProfilerEngine::getInstance();
+    SessionOptions options;
+    options.recording = RecordingMode::FlightRecorder;
+    options.ring_bytes_per_thread = 256 * sizeof(EventRecord);
+    engine.begin_session("snapshot_test", options);
+
+    std::atomic<bool> stop{false};
+    std::thread worker([&stop]
+    {
+        while (!stop.load())
+        {
+            RUNSCOPE_PROFILE_SCOPE("snapshot_site");
+        }
+    });
+
+    while (engine.dropped_events() == 0)
+    {
+        std::this_thread::yield();
+    }
+
+    const std::string filename = "test_flight_snapshot.json";
+    EXPECT_TRUE(runscope::export_format::Exporter::export_snapshot(*engine.current_session(), filename));
+    stop.store(true);
+    worker.join();
+
+    std::ifstream file(filename);
+    const std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    EXPECT_NE(content.find("\"traceEvents\""), std::string::npos);
+    EXPECT_NE(content.find("snapshot_site"), std::string::npos);
+    EXPECT_NE(content.find("\"dropped_events\""), std::string::npos);
+    file.close();
+    std::remove(filename.c_str());
+}
+
+TEST_F(ProfilerEngineTest, AllocationsAttributedToScopes)
+{
+    ASSERT_TRUE(AllocTracker::installed());
+    auto& engine = ProfilerEngine::getInstance();
+
+    // Kept outside the scopes so the allocations cannot be elided.
+    std::vector<std::unique_ptr<char[]>> kept;
+    kept.reserve(2);
+    {
+        RUNSCOPE_PROFILE_SCOPE("alloc_outer");
+        kept.push_back(std::make_unique<char[]>(4096));
+        {
+            RUNSCOPE_PROFILE_SCOPE("alloc_inner");
+            kept.push_back(std::make_unique<char[]>(65536));
+        }
+    }
+
+    EntryCursor cursor;
+    for (const auto& entries : {engine.get_entries(), engine.get_entries_since(cursor)})
+    {
+        ASSERT_EQ(entries.size(), 2);
+        const auto inner = std::ranges::find(entries, std::string("alloc_inner"), &ProfileEntry::name);
+        const auto outer = std::ranges::find(entries, std::string("alloc_outer"), &ProfileEntry::name);
+        ASSERT_NE(inner, entries.end());
+        ASSERT_NE(outer, entries.end());
+
+        EXPECT_GE(inner->memory_used, 65536u);
+        EXPECT_EQ(inner->self_memory_used, inner->memory_used);
+        EXPECT_EQ(inner->allocation_count, 1u);
+
+        EXPECT_GE(outer->memory_used, inner->memory_used + 4096);
+        EXPECT_EQ(outer->self_memory_used, outer->memory_used - inner->memory_used);
+        EXPECT_GE(outer->allocation_count, 2u);
+    }
+    EXPECT_GE(engine.current_session()->get_memory_usage().at("alloc_outer"), 65536u + 4096u);
+}
+
+TEST_F(ProfilerEngineTest, ProfilerAllocationsAreNotCounted)
+{
+    ASSERT_TRUE(AllocTracker::installed());
+    auto& engine = ProfilerEngine::getInstance();
+
+    // A fresh thread registers its stream inside the outer scope, and the
+    // inner scopes fill several event chunks.
+    std::thread worker([]
+    {
+        RUNSCOPE_PROFILE_SCOPE("alloc_free_outer");
+        for (int i = 0; i < 3000; ++i)
+        {
+            RUNSCOPE_PROFILE_SCOPE("alloc_free_inner");
+        }
+    });
+    worker.join();
+
+    const auto entries = engine.get_entries();
+    const auto outer = std::ranges::find(entries, std::string("alloc_free_outer"), &ProfileEntry::name);
+    ASSERT_NE(outer, entries.end());
+    EXPECT_EQ(outer->memory_used, 0u);
+    EXPECT_EQ(outer->allocation_count, 0u);
+}
+
+TEST_F(ProfilerEngineTest, CpuTimeSeparatesBlockedFromBusy)
+{
+    auto& engine = ProfilerEngine::getInstance();
+    SessionOptions options;
+    options.cpu_time = true;
+    engine.begin_session("cpu_time_test", options);
+
+    {
+        RUNSCOPE_PROFILE_SCOPE("cpu_blocked");
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    {
+        RUNSCOPE_PROFILE_SCOPE("cpu_busy");
+        const auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(20);
+        while (std::chrono::steady_clock::now() < until)
+        {
+        }
+    }
+
+    const auto entries = engine.get_entries();
+    ASSERT_EQ(entries.size(), 2);
+    for (const auto& entry : entries)
+    {
+        EXPECT_GT(entry.cpu_time_ns, 0);
+    }
+
+    const auto usage = engine.current_session()->get_cpu_usage();
+    EXPECT_LT(usage.at("cpu_blocked"), 25.0);
+    EXPECT_GT(usage.at("cpu_busy"), 50.0);
+}
+
+TEST_F(ProfilerEngineTest, PerfCountersForSelectedCategories)
+{
+    auto& engine = ProfilerEngine::getInstance();
+    SessionOptions options;
+    options.perf_categories = category::Memory;
+    engine.begin_session("perf_counters_test", options);
+
+    std::vector<char> pages;
+    {
+        RUNSCOPE_PROFILE_SCOPE_CAT(Memory, "perf_touch_pages");
+        // Above glibc's largest mmap threshold, so the pages are always fresh.
+        pages.assign(64 << 20, 1);
+    }
+    {
+        RUNSCOPE_PROFILE_SCOPE("perf_not_selected");
+    }
+
+    const auto entries = engine.get_entries();
+    ASSERT_EQ(entries.size(), 2);
+    const auto touched = std::ranges::find(entries, std::string("perf_touch_pages"), &ProfileEntry::name);
+    const auto skipped = std::ranges::find(entries, std::string("perf_not_selected"), &ProfileEntry::name);
+    ASSERT_NE(touched, entries.end());
+    ASSERT_NE(skipped, entries.end());
+    EXPECT_FALSE(skipped->perf.software);
+    EXPECT_FALSE(skipped->perf.hardware);
+
+    if (!touched->perf.software)
+    {
+        GTEST_SKIP() << "perf_event_open is not permitted here";
+    }
+    EXPECT_GT(touched->perf.task_clock_ns, 0u);
+    EXPECT_GT(touched->perf.page_faults, 0u);
+
+    runscope::analysis::StatisticsAnalyzer analyzer;
+    analyzer.analyze(entries);
+    const auto stats = analyzer.get_stats_for_function("perf_touch_pages");
+    EXPECT_EQ(stats.software_call_count, 1u);
+    EXPECT_DOUBLE_EQ(stats.faults_per_call(), static_cast<double>(touched->perf.page_faults));
+    if (touched->perf.hardware)
+    {
+        EXPECT_GT(stats.ipc(), 0.0);
+    }
+}
+
+TEST_F(ProfilerEngineTest, OverheadCalibratedAtSessionStart)
+{
+    auto& engine = ProfilerEngine::getInstance();
+    const ProfilerOverhead overhead = engine.current_session()->overhead();
+    EXPECT_GT(overhead.total_ns, 0);
+    EXPECT_GE(overhead.total_ns, overhead.self_ns);
+    EXPECT_GE(overhead.self_ns, 0);
+
+    // Calibration scopes are not part of the session.
+    EXPECT_EQ(engine.current_session()->entry_count(), 0);
+
+    for (int i = 0; i < 100; ++i)
+    {
+        RUNSCOPE_PROFILE_SCOPE("short");
+    }
+    const auto threads = engine.current_session()->get_thread_info();
+    ASSERT_EQ(threads.size(), 1);
+    EXPECT_EQ(threads.begin()->second.overhead_ns, static_cast<uint64_t>(100 * overhead.total_ns));
+
+    engine.end_session();
+    SessionOptions options;
+    options.calibrate_overhead = false;
+    engine.begin_session("uncalibrated", options);
+    EXPECT_EQ(engine.current_session()->overhead().total_ns, 0);
+    EXPECT_EQ(engine.current_session()->overhead().self_ns, 0);
+}
+
+TEST_F(ProfilerEngineTest, OverheadSubtractedOnExport)
+{
+    auto& engine = ProfilerEngine::getInstance();
+    {
+        RUNSCOPE_PROFILE_SCOPE("outer");
+        for (int i = 0; i < 100; ++i)
+        {
+            RUNSCOPE_PROFILE_SCOPE("inner");
+        }
+    }
+
+    const auto session = engine.current_session();
+    const auto entries = session->get_entries();
+    const auto compensated = runscope::analysis::compensate_overhead(entries, session->overhead());
+    ASSERT_EQ(compensated.size(), entries.size());
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        EXPECT_LE(compensated[i].duration_ns(), entries[i].duration_ns());
+        if (entries[i].name == "outer" && entries[i].duration_ns() > 100 * session->overhead().total_ns)
+        {
+            EXPECT_LE(compensated[i].duration_ns(),
+                      entries[i].duration_ns() - 100 * session->overhead().total_ns);
+        }
+    }
+
+    const std::string filename = "test_overhead_snapshot.json";
+    EXPECT_TRUE(runscope::export_format::Exporter::export_snapshot(*session, filename, true));
+    std::ifstream file(filename);
+    const std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    EXPECT_NE(content.find("\"overhead_subtracted\": true"), std::string::npos);
+    file.close();
+    std::remove(filename.c_str());
+}
+
+TEST_F(ProfilerEngineTest, HotSitesThrottledToBudget)
+{
+    auto& engine = ProfilerEngine::getInstance();
+    SessionOptions options;
+    options.overhead_budget = 0.02;
+    engine.begin_session("throttle_test", options);
+
+    for (int i = 0; i < 5; ++i)
+    {
+        RUNSCOPE_PROFILE_SCOPE("throttle_cold");
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    constexpr int hot_calls = 1 << 20;
+    for (int i = 0; i < hot_calls; ++i)
+    {
+        RUNSCOPE_PROFILE_SCOPE("throttle_hot");
+    }
+
+    const auto throttled = engine.get_throttled_sites();
+    ASSERT_EQ(throttled.size(), 1);
+    EXPECT_STREQ(throttled[0].name.c_str(), "throttle_hot");
+    EXPECT_GT(throttled[0].max_sample_every, 1);
+
+    const auto entries = engine.get_entries();
+    const auto hot = std::ranges::count_if(entries, [](const ProfileEntry& e) { return e.name == "throttle_hot"; });
+    EXPECT_LT(hot, hot_calls);
+    EXPECT_EQ(std::ranges::count_if(entries, [](const ProfileEntry& e)
+    {
+        return e.name == "throttle_cold" && e.sample_weight == 1;
+    }), 5);
+
+    // Each timed scope stands for the calls it was sampled from.
+    for (const auto& stats : engine.get_site_stats())
+    {
+        if (stats.name == "throttle_hot")
+        {
+            EXPECT_NEAR(static_cast<double>(stats.count), hot_calls, hot_calls * 0.2);
+        }
+    }
+    runscope::analysis::StatisticsAnalyzer analyzer;
+    analyzer.analyze(entries);
+    EXPECT_NEAR(static_cast<double>(analyzer.get_function_stats().at("throttle_hot").call_count), hot_calls, hot_calls * 0.2);
+
+    // A new session times every call again.
+    engine.begin_session("after_throttle");
+    EXPECT_TRUE(engine.get_throttled_sites().empty());
+}
+
+TEST_F(ProfilerEngineTest, AggregateModeWeighsThrottledScopes)
+{
+    auto& engine = ProfilerEngine::getInstance();
+    SessionOptions options;
+    options.recording = RecordingMode::Aggregate;
+    options.overhead_budget = 0.02;
+    engine.begin_session("throttle_aggregate_test", options);
+
+    constexpr int hot_calls = 1 << 20;
+    for (int i = 0; i < hot_calls; ++i)
+    {
+        RUNSCOPE_PROFILE_SCOPE("throttle_aggregate");
+    }
+
+    ASSERT_EQ(engine.get_throttled_sites().size(), 1);
+    const auto stats = engine.get_site_stats();
+    const auto it = std::ranges::find(stats, std::string("throttle_aggregate"), &CallSiteStats::name);
+    ASSERT_NE(it, stats.end());
+    EXPECT_NEAR(static_cast<double>(it->count), hot_calls, hot_calls * 0.2);
+    EXPECT_GT(it->total_ns, 0);
+}
+
+TEST_F(ProfilerEngineTest, ShortScopesFoldedIntoSiteStats)
+{
+    auto& engine = ProfilerEngine::getInstance();
+    SessionOptions options;
+    options.entry_threshold_ns = 1000000;
+    engine.begin_session("threshold_test", options);
+
+    {
+        RUNSCOPE_PROFILE_SCOPE("threshold_outer");
+        for (int i = 0; i < 100; ++i)
+        {
+            RUNSCOPE_PROFILE_SCOPE("threshold_short");
+        }
+        {
+            RUNSCOPE_PROFILE_SCOPE("threshold_slow");
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+    }
+
+    const auto entries = engine.get_entries();
+    ASSERT_EQ(entries.size(), 2);
+    EXPECT_EQ(entries[0].name, "threshold_slow");
+    EXPECT_EQ(entries[1].name, "threshold_outer");
+    EXPECT_EQ(entries[0].parent, 1);
+    EXPECT_GE(entries[1].duration_ns(), entries[0].duration_ns());
+
+    const auto stats = engine.get_site_stats();
+    const auto folded = std::ranges::find(stats, std::string("threshold_short"), &CallSiteStats::name);
+    ASSERT_NE(folded, stats.end());
+    EXPECT_EQ(folded->count, 100);
+    EXPECT_EQ(folded->folded_count, 100);
+    EXPECT_EQ(folded->folded_total_ns, folded->total_ns);
+    EXPECT_LT(folded->total_ns, entries[1].duration_ns());
+
+    const auto slow = std::ranges::find(stats, std::string("threshold_slow"), &CallSiteStats::name);
+    ASSERT_NE(slow, stats.end());
+    EXPECT_EQ(slow->count, 1);
+    EXPECT_EQ(slow->folded_count, 0);
+
+    // Only the folded site lives in the accumulators.
+    const auto accumulated = engine.get_accumulated_stats();
+    ASSERT_EQ(accumulated.size(), 1);
+    EXPECT_EQ(accumulated[0].name, "threshold_short");
+    EXPECT_EQ(accumulated[0].folded_count, 100);
+    EXPECT_EQ(accumulated[0].total_ns, folded->total_ns);
+}
+
+TEST_F(ProfilerEngineTest, OpenScopesVisibleWhileRunning)
+{
+    auto& engine = ProfilerEngine::getInstance();
+    SessionOptions options;
+    options.track_open_scopes = true;
+    engine.begin_session("open_scope_test", options);
+
+    std::atomic<bool> entered{false};
+    std::atomic<bool> release{false};
+    std::thread worker([&entered, &release]()
+    {
+        RUNSCOPE_SET_THREAD_NAME("open_worker");
+        RUNSCOPE_PROFILE_SCOPE("open_outer");
+        {
+            RUNSCOPE_PROFILE_SCOPE("open_inner");
+            entered.store(true);
+            while (!release.load())
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+    });
+    while (!entered.load())
+    {
+        std::this_thread::yield();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+    const auto open = engine.get_open_scopes();
+    ASSERT_EQ(open.size(), 2);
+    EXPECT_EQ(open[0].name, "open_outer");
+    EXPECT_EQ(open[0].depth, 0);
+    EXPECT_EQ(open[1].name, "open_inner");
+    EXPECT_EQ(open[1].depth, 1);
+    EXPECT_EQ(open[1].thread_id, open[0].thread_id);
+    EXPECT_EQ(open[1].thread_name, "open_worker");
+    EXPECT_GE(open[1].start_ns, open[0].start_ns);
+    EXPECT_GE(open[1].elapsed_ns, 5000000);
+    EXPECT_TRUE(engine.get_entries().empty());
+
+    release.store(true);
+    worker.join();
+    EXPECT_TRUE(engine.get_open_scopes().empty());
+
+    const auto entries = engine.get_entries();
+    ASSERT_EQ(entries.size(), 2);
+    EXPECT_EQ(entries[0].start_ns, open[1].start_ns);
+    EXPECT_EQ(entries[1].start_ns, open[0].start_ns);
+}
+
+TEST_F(ProfilerEngineTest, WatchdogReportsOverrunOnce)
+{
+    auto& engine = ProfilerEngine::getInstance();
+    SessionOptions options;
+    options.open_scope_budget_ns = 5000000;
+    std::atomic<int> reports{0};
+    options.on_scope_overrun = [&reports](const OpenScope& overrun, const std::vector<OpenScope>& open)
+    {
+        if (overrun.name == "watchdog_slow" && open.size() == 2)
+        {
+            reports.fetch_add(1);
+        }
+    };
+    engine.begin_session("watchdog_test", options);
+
+    {
+        RUNSCOPE_PROFILE_SCOPE("watchdog_outer");
+        for (int i = 0; i < 100; ++i)
+        {
+            RUNSCOPE_PROFILE_SCOPE("watchdog_fast");
+        }
+        {
+            RUNSCOPE_PROFILE_SCOPE("watchdog_slow");
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+    }
+    engine.end_session();
+
+    // The outer scope overran too, by the time the slow one had.
+    const auto overruns = engine.get_scope_overruns();
+    ASSERT_EQ(overruns.size(), 2);
+    EXPECT_EQ(reports.load(), 1);
+    EXPECT_EQ(std::ranges::count(overruns, std::string("watchdog_slow"), &OpenScope::name), 1);
+    EXPECT_EQ(std::ranges::count(overruns, std::string("watchdog_outer"), &OpenScope::name), 1);
+    for (const auto& overrun : overruns)
+    {
+        EXPECT_GT(overrun.elapsed_ns, options.open_scope_budget_ns);
+    }
+}
+
+TEST_F(ProfilerEngineTest, ClearDropsDerivedState)
+{
+    using namespace std::chrono_literals;
+    auto& engine = ProfilerEngine::getInstance();
+    const auto session = engine.current_session();
+
+    auto run_over_budget = []
+    {
+        RUNSCOPE_PROFILE_SCOPE_BUDGET("clear_budgeted", 1us);
+        std::this_thread::sleep_for(1ms);
+    };
+    run_over_budget();
+    run_over_budget();
+    OpenScope overrun;
+    overrun.name = "clear_overrun";
+    session->add_scope_overrun(overrun);
+    session->add_throttle(1, 3);
+
+    ASSERT_EQ(session->get_budget_stats().size(), 1);
+    ASSERT_EQ(session->get_budget_stats()[0].violations, 2);
+    ASSERT_FALSE(session->get_scope_overruns().empty());
+    ASSERT_FALSE(session->get_throttled_sites().empty());
+
+    session->clear();
+    EXPECT_TRUE(session->get_entries().empty());
+    EXPECT_TRUE(session->get_budget_stats().empty());
+    EXPECT_TRUE(session->get_scope_overruns().empty());
+    EXPECT_TRUE(session->get_throttled_sites().empty());
+
+    // Counting starts over after a clear.
+    run_over_budget();
+    const auto stats = session->get_budget_stats();
+    ASSERT_EQ(stats.size(), 1);
+    EXPECT_EQ(stats[0].violations, 1);
+}
+
+TEST_F(ProfilerEngineTest, ScopeBudgetViolationsKeepWorstWithChildren)
+{
+    using namespace std::chrono_literals;
+    auto& engine = ProfilerEngine::getInstance();
+    SessionOptions options;
+    options.recording = RecordingMode::Aggregate;
+    options.budget_worst_count = 2;
+    std::atomic<int> reports{0};
+    std::atomic<bool> reported_on_scope_thread{false};
+    const ThreadId scope_thread = std::this_thread::get_id();
+    options.on_budget_violation = [&reports, &reported_on_scope_thread, scope_thread](const BudgetViolation& violation)
+    {
+        if (violation.name == "budget_serialize")
+        {
+            reports.fetch_add(1);
+        }
+        if (std::this_thread::get_id() == scope_thread)
+        {
+            reported_on_scope_thread.store(true);
+        }
+    };
+    engine.begin_session("budget_test", options);
+
+    for (int i = 0; i < 5; ++i)
+    {
+        RUNSCOPE_PROFILE_SCOPE_BUDGET("budget_serialize", 2ms);
+        {
+            RUNSCOPE_PROFILE_SCOPE("budget_encode");
+            RUNSCOPE_PROFILE_SCOPE("budget_nested");
+            if (i < 3)
+            {
+                std::this_thread::sleep_for((i + 1) * 3ms);
+            }
+        }
+        for (int j = 0; j < 4; ++j)
+        {
+            RUNSCOPE_PROFILE_SCOPE("budget_write");
+        }
+    }
+    engine.end_session();
+
+    EXPECT_TRUE(engine.get_entries().empty());
+    EXPECT_EQ(reports.load(), 3);
+    EXPECT_FALSE(reported_on_scope_thread.load());
+
+    const auto stats = engine.get_budget_stats();
+    ASSERT_EQ(stats.size(), 1);
+    EXPECT_EQ(stats[0].name, "budget_serialize");
+    EXPECT_EQ(stats[0].budget_ns, 2000000);
+    EXPECT_EQ(stats[0].violations, 3);
+    ASSERT_EQ(stats[0].worst.size(), 2);
+    EXPECT_GE(stats[0].worst[0].duration_ns, 9000000);
+    EXPECT_GE(stats[0].worst[1].duration_ns, 6000000);
+    EXPECT_GE(stats[0].worst[0].duration_ns, stats[0].worst[1].duration_ns);
+
+    // Direct children only, slowest first; nested scopes count in their parent.
+    const auto& children = stats[0].worst[0].children;
+    ASSERT_EQ(children.size(), 2);
+    EXPECT_EQ(children[0].name, "budget_encode");
+    EXPECT_EQ(children[0].count, 1);
+    EXPECT_GE(children[0].total_ns, 9000000);
+    EXPECT_EQ(children[1].name, "budget_write");
+    EXPECT_EQ(children[1].count, 4);
+    EXPECT_GE(stats[0].worst[0].self_ns(), 0);
+}
+
+TEST_F(ProfilerEngineTest, ProfiledMutexRecordsContention)
+{
+    auto& engine = ProfilerEngine::getInstance();
+    SessionOptions options;
+    options.lock_threshold_ns = 1000000;
+    engine.begin_session("lock_test", options);
+
+    ProfiledMutex mutex{RUNSCOPE_LOCK_SITE("test_lock")};
+    std::atomic<bool> held{false};
+
+    std::thread holder([&]
+    {
+        std::lock_guard<ProfiledMutex> lock(mutex);
+        held.store(true);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    });
+    while (!held.load())
+    {
+        std::this_thread::yield();
+    }
+    {
+        RUNSCOPE_PROFILE_SCOPE("lock_waiter");
+        std::lock_guard<ProfiledMutex> lock(mutex);
+    }
+    holder.join();
+
+    // Short, uncontended acquisitions stay below the threshold.
+    for (int i = 0; i < 100; ++i)
+    {
+        std::lock_guard<ProfiledMutex> lock(mutex);
+    }
+
+    const auto events = engine.get_lock_events();
+    ASSERT_EQ(events.size(), 2);
+    const auto wait = std::ranges::find(events, LockEvent::Kind::Wait, &LockEvent::kind);
+    const auto hold = std::ranges::find(events, LockEvent::Kind::Hold, &LockEvent::kind);
+    ASSERT_NE(wait, events.end());
+    ASSERT_NE(hold, events.end());
+    EXPECT_EQ(wait->name, "test_lock");
+    EXPECT_EQ(wait->thread_id, std::this_thread::get_id());
+    EXPECT_GE(wait->duration_ns(), 5000000);
+    EXPECT_GE(hold->duration_ns(), 15000000);
+    EXPECT_NE(hold->thread_id, std::this_thread::get_id());
+
+    runscope::analysis::LockAnalyzer analyzer;
+    analyzer.analyze(events, engine.get_entries());
+    const auto stats = analyzer.get_stats_for_lock("test_lock");
+    ASSERT_EQ(stats.blocked_scopes.size(), 1);
+    EXPECT_EQ(stats.blocked_scopes[0].name, "lock_waiter");
+}
+
+TEST_F(ProfilerEngineTest, ProfiledSharedMutexRecordsReaderWaits)
+{
+    auto& engine = ProfilerEngine::getInstance();
+    SessionOptions options;
+    options.lock_threshold_ns = 1000000;
+    engine.begin_session("shared_lock_test", options);
+
+    ProfiledSharedMutex mutex{"test_shared_lock"};
+    std::atomic<bool> held{false};
+
+    std::thread writer([&]
+    {
+        std::unique_lock<ProfiledSharedMutex> lock(mutex);
+        held.store(true);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    });
+    while (!held.load())
+    {
+        std::this_thread::yield();
+    }
+    {
+        std::shared_lock<ProfiledSharedMutex> lock(mutex);
+    }
+    writer.join();
+
+    const auto events = engine.get_lock_events();
+    ASSERT_EQ(events.size(), 2);
+    const auto wait = std::ranges::find(events, LockEvent::Kind::Wait, &LockEvent::kind);
+    ASSERT_NE(wait, events.end());
+    EXPECT_TRUE(wait->shared);
+    EXPECT_EQ(wait->name, "test_shared_lock");
+}
+
+TEST_F(ProfilerEngineTest, FrameMarksAreNotEntries)
+{
+    auto& engine = ProfilerEngine::getInstance();
+
+    for (int frame = 0; frame < 4; ++frame)
+    {
+        {
+            RUNSCOPE_PROFILE_SCOPE("frame_work");
+        }
+        RUNSCOPE_FRAME_MARK("tick");
+    }
+
+    EXPECT_EQ(engine.get_entries().size(), 4);
+
+    const auto marks = engine.get_frame_marks();
+    ASSERT_EQ(marks.size(), 4);
+    for (size_t i = 0; i < marks.size(); ++i)
+    {
+        EXPECT_EQ(marks[i].name, "tick");
+        EXPECT_EQ(marks[i].thread_id, std::this_thread::get_id());
+        if (i > 0)
+        {
+            EXPECT_GE(marks[i].time_ns, marks[i - 1].time_ns);
+        }
+    }
+
+    runscope::analysis::FrameAnalyzer analyzer;
+    analyzer.analyze(marks, engine.get_entries());
+    ASSERT_EQ(analyzer.frame_count(), 3);
+    for (size_t i = 0; i < analyzer.frame_count(); ++i)
+    {
+        const auto in_frame = analyzer.get_entries_in_frame(i);
+        ASSERT_EQ(in_frame.size(), 1);
+        EXPECT_EQ(in_frame[0].name, "frame_work");
+    }
+}
+
+TEST_F(ProfilerEngineTest, CountersRecordValues)
+{
+    auto& engine = ProfilerEngine::getInstance();
+
+    for (int depth = 0; depth < 5; ++depth)
+    {
+        RUNSCOPE_COUNTER("queue_depth", depth * 1.5);
+    }
+    std::thread([]
+    {
+        RUNSCOPE_COUNTER("in_flight", 1234567890123LL);
+    }).join();
+
+    EXPECT_TRUE(engine.get_entries().empty());
+
+    const auto counters = engine.get_counter_samples();
+    ASSERT_EQ(counters.size(), 6);
+    std::vector<double> queue_depths;
+    for (const auto& sample : counters)
+    {
+        if (sample.name == "queue_depth")
+        {
+            queue_depths.push_back(sample.value);
+        }
+        else
+        {
+            EXPECT_EQ(sample.name, "in_flight");
+            EXPECT_EQ(sample.value, 1234567890123.0);
+            EXPECT_NE(sample.thread_id, std::this_thread::get_id());
+        }
+    }
+    EXPECT_EQ(queue_depths, (std::vector<double>{0.0, 1.5, 3.0, 4.5, 6.0}));
+
+    const std::string filename = "test_counters_trace.json";
+    EXPECT_TRUE(runscope::export_format::Exporter::export_to_chrome_trace(engine.get_entries(), counters, filename));
+    std::ifstream file(filename);
+    const std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    EXPECT_NE(content.find("\"ph\": \"C\""), std::string::npos);
+    EXPECT_NE(content.find("1234567890123"), std::string::npos);
+    file.close();
+    std::remove(filename.c_str());
+}
+
+TEST_F(ProfilerEngineTest, MarkAndCounterCursorsReturnOnlyNewRecords)
+{
+    auto& engine = ProfilerEngine::getInstance();
+    EntryCursor frame_cursor;
+    EntryCursor counter_cursor;
+
+    for (int frame = 0; frame < 3; ++frame)
+    {
+        RUNSCOPE_FRAME_MARK("cursor_tick");
+        RUNSCOPE_COUNTER("cursor_value", frame);
+    }
+    EXPECT_EQ(engine.get_frame_marks(frame_cursor).size(), 3);
+    EXPECT_EQ(engine.get_counter_samples(counter_cursor).size(), 3);
+    EXPECT_TRUE(engine.get_frame_marks(frame_cursor).empty());
+    EXPECT_TRUE(engine.get_counter_samples(counter_cursor).empty());
+
+    std::thread([]
+    {
+        RUNSCOPE_FRAME_MARK("cursor_tick");
+        RUNSCOPE_COUNTER("cursor_value", 10);
+    }).join();
+    const auto marks = engine.get_frame_marks(frame_cursor);
+    ASSERT_EQ(marks.size(), 1);
+    EXPECT_NE(marks[0].thread_id, std::this_thread::get_id());
+    const auto samples = engine.get_counter_samples(counter_cursor);
+    ASSERT_EQ(samples.size(), 1);
+    EXPECT_EQ(samples[0].value, 10.0);
+    EXPECT_EQ(frame_cursor.entries_read, 4);
+    EXPECT_EQ(engine.get_frame_marks().size(), 4);
+
+    engine.clear();
+    RUNSCOPE_COUNTER("cursor_value", 20);
+    EXPECT_TRUE(engine.get_frame_marks(frame_cursor).empty());
+    EXPECT_EQ(frame_cursor.entries_read, 0);
+    const auto after_clear = engine.get_counter_samples(counter_cursor);
+    ASSERT_EQ(after_clear.size(), 1);
+    EXPECT_EQ(after_clear[0].value, 20.0);
+    EXPECT_EQ(counter_cursor.entries_read, 1);
+}
+
+TEST_F(ProfilerEngineTest, AsyncSpansCrossThreads)
+{
+    auto& engine = ProfilerEngine::getInstance();
+
+    RUNSCOPE_ASYNC_BEGIN("request", 7);
+    RUNSCOPE_ASYNC_BEGIN("request", 8);
+    RUNSCOPE_ASYNC_BEGIN("request", 9);
+    std::thread([]
+    {
+        for (uint64_t id = 7; id <= 8; ++id)
+        {
+            RUNSCOPE_ASYNC_STEP("execute", id);
+            RUNSCOPE_ASYNC_END("request", id);
+        }
+    }).join();
+    RUNSCOPE_ASYNC_END("request", 1234);
+
+    const auto spans = engine.get_async_spans();
+    ASSERT_EQ(spans.size(), 3);
+    for (size_t i = 0; i < 2; ++i)
+    {
+        const auto& span = spans[i];
+        EXPECT_EQ(span.id, 7 + i);
+        EXPECT_EQ(span.name, "request");
+        EXPECT_TRUE(span.complete);
+        EXPECT_EQ(span.begin_thread, std::this_thread::get_id());
+        EXPECT_NE(span.end_thread, span.begin_thread);
+        ASSERT_EQ(span.steps.size(), 1);
+        EXPECT_EQ(span.steps[0].name, "execute");
+        EXPECT_GE(span.queued_ns(), 0);
+        EXPECT_GE(span.active_ns(), 0);
+        EXPECT_EQ(span.queued_ns() + span.active_ns(), span.duration_ns());
+    }
+    EXPECT_FALSE(spans[2].complete);
+
+    const std::string filename = "test_async_trace.json";
+    EXPECT_TRUE(runscope::export_format::Exporter::export_to_chrome_trace(*engine.current_session(), filename));
+    std::ifstream file(filename);
+    const std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    EXPECT_NE(content.find("\"ph\": \"b\""), std::string::npos);
+    EXPECT_NE(content.find("\"ph\": \"t\""), std::string::npos);
+    EXPECT_NE(content.find("\"ph\": \"f\""), std::string::npos);
+    EXPECT_NE(content.find("\"id\": \"0x7\""), std::string::npos);
+    file.close();
+    std::remove(filename.c_str());
+}
+
+TEST_F(ProfilerEngineTest, SamplingModeCapturesStacks)
+{
+    if (!runscope::platform::SignalSampler::supported())
+    {
+        GTEST_SKIP() << "signal sampler not available on this platform";
+    }
+
+    auto& engine = ProfilerEngine::getInstance();
+    SessionOptions options;
+    options.mode = ProfilerMode::Sampling;
+    options.sampling_hz = 1000;
+    engine.begin_session("sampling_test", options);
+
+    {
+        // Instrumented scopes are skipped in sampling-only sessions.
+        RUNSCOPE_PROFILE_SCOPE("not_recorded");
+    }
+
+    volatile double sink = 0.0;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(200);
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        for (int i = 0; i < 1000; ++i)
+        {
+            sink = sink + std::sqrt(static_cast<double>(i));
+        }
+    }
+    engine.end_session();
+
+    const auto entries = engine.get_entries();
+    ASSERT_FALSE(entries.empty());
+    for (const auto& entry : entries)
+    {
+        EXPECT_NE(entry.name, "not_recorded");
+        EXPECT_FALSE(entry.name.empty());
+        EXPECT_EQ(entry.thread_id, std::this_thread::get_id());
+        if (entry.depth > 0)
+        {
+            ASSERT_GE(entry.parent, 0);
+            EXPECT_EQ(entries[static_cast<size_t>(entry.parent)].depth, entry.depth - 1);
+        }
+    }
+    EXPECT_TRUE(std::ranges::any_of(entries, [](const ProfileEntry& e) { return e.depth == 0; }));
+}
+
+TEST(ScopeCategoryTest, CompiledOutCategories)
+{
+    static_assert(std::is_same_v<CategoryScopeProfiler<category::IO, category::General>, DisabledScopeProfiler>);
+    static_assert(std::is_same_v<CategoryScopeProfiler<category::IO, category::IO | category::General>, ScopeProfiler>);
+    static_assert(std::is_empty_v<DisabledScopeProfiler>);
+    EXPECT_FALSE(ProfilerEngine::category_enabled(0));
+}
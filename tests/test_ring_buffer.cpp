@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+#include "runscope/core/ring_buffer.hpp"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace runscope::core;
+
+namespace
+{
+    struct Item
+    {
+        uint64_t a;
+        uint64_t b;
+    };
+}
+
+TEST(RingBufferTest, KeepsMostRecentItems)
+{
+    RingBuffer<Item> ring(100);
+    EXPECT_EQ(ring.capacity(), 64);
+
+    for (uint64_t i = 0; i < 200; ++i)
+    {
+        ring.push({i, i});
+    }
+
+    std::vector<uint64_t> seen;
+    ring.for_each([&seen](const Item& item) { seen.push_back(item.a); });
+
+    ASSERT_EQ(seen.size(), 64);
+    EXPECT_EQ(seen.front(), 136);
+    EXPECT_EQ(seen.back(), 199);
+    EXPECT_EQ(ring.size(), 64);
+    EXPECT_EQ(ring.overwritten(), 136);
+}
+
+TEST(RingBufferTest, ReadersNeverSeeTornItems)
+{
+    RingBuffer<Item> ring(256);
+    std::atomic<bool> done{false};
+
+    std::thread writer([&ring, &done]
+    {
+        for (uint64_t i = 0; i < 200000; ++i)
+        {
+            ring.push({i, ~i});
+        }
+        done.store(true);
+    });
+
+    bool consistent = true;
+    while (!done.load())
+    {
+        uint64_t previous = 0;
+        bool first = true;
+        ring.for_each([&](const Item& item)
+        {
+            consistent &= item.b == ~item.a;
+            consistent &= first || item.a == previous + 1;
+            previous = item.a;
+            first = false;
+        });
+    }
+    writer.join();
+
+    EXPECT_TRUE(consistent);
+}
+
+TEST(RingBufferTest, ResumesFromPosition)
+{
+    RingBuffer<Item> ring(16);
+    for (uint64_t i = 0; i < 10; ++i)
+    {
+        ring.push({i, i});
+    }
+
+    std::vector<uint64_t> seen;
+    uint64_t position = ring.for_each_since(0, [&seen](const Item& item) { seen.push_back(item.a); });
+    EXPECT_EQ(position, 10);
+    EXPECT_EQ(seen.size(), 10);
+
+    for (uint64_t i = 10; i < 40; ++i)
+    {
+        ring.push({i, i});
+    }
+
+    seen.clear();
+    position = ring.for_each_since(position, [&seen](const Item& item) { seen.push_back(item.a); });
+    EXPECT_EQ(position, 40);
+    ASSERT_EQ(seen.size(), 16);
+    EXPECT_EQ(seen.front(), 24);
+}
@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+#include "runscope/core/thread_buffer.hpp"
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+using namespace runscope::core;
+
+namespace
+{
+    using SmallBuffer = ThreadBuffer<uint64_t, 16>;
+}
+
+TEST(ThreadBufferTest, ResumesAcrossChunks)
+{
+    SmallBuffer buffer;
+    for (uint64_t i = 0; i < 40; ++i)
+    {
+        buffer.push(i);
+    }
+
+    std::vector<uint64_t> seen;
+    const size_t position = buffer.for_each_since(20, [&seen](const uint64_t value) { seen.push_back(value); });
+
+    EXPECT_EQ(position, 40);
+    ASSERT_EQ(seen.size(), 20);
+    EXPECT_EQ(seen.front(), 20);
+    EXPECT_EQ(seen.back(), 39);
+    EXPECT_EQ(buffer.for_each_since(position, [](uint64_t) { FAIL(); }), 40);
+}
+
+TEST(ThreadBufferTest, PoolRecyclesBlocks)
+{
+    using Pool = ChunkPool<96, 32>;
+    auto& pool = Pool::getInstance();
+
+    void* first = pool.acquire();
+    const size_t retained = pool.retained();
+    pool.release(first);
+    EXPECT_EQ(pool.retained(), retained + 1);
+
+    void* second = pool.acquire();
+    EXPECT_EQ(second, first);
+    EXPECT_EQ(pool.retained(), retained);
+    pool.release(second);
+}
+
+TEST(ThreadBufferTest, PoolTakesBackThreadCacheOnExit)
+{
+    // Not used elsewhere, so both lists start empty.
+    using Pool = ChunkPool<128, 32>;
+    auto& pool = Pool::getInstance();
+
+    std::thread([&pool]
+    {
+        void* first = pool.acquire();
+        void* second = pool.acquire();
+        pool.release(first);
+        pool.release(second);
+        EXPECT_EQ(pool.retained(), 2);
+    }).join();
+
+    // Main thread's cache is empty: both blocks are now in the shared list.
+    EXPECT_EQ(pool.retained(), 2);
+    void* block = pool.acquire();
+    EXPECT_EQ(pool.retained(), 1);
+    pool.release(block);
+}